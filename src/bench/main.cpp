@@ -0,0 +1,319 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+#include "automaton.h"
+#include "configfile.h"
+
+/*
+A benchmark for the simulation code, which prints the results as JSON.
+It sweeps board sizes, soup densities, rules (the preset rules from cells.cfg by default),
+    toroidal and bounded edges, and full and partial simulations.
+Each case runs for about the same amount of time, so small boards get many more generations than large ones.
+Then each size is run again on more threads, where each thread simulates its own copy of the board,
+    which shows how the total throughput scales with the number of cores.
+*/
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Settings
+    {
+        std::vector<unsigned> sizes{32, 256, 1024, 4096};
+        std::vector<float> densities{0.125f, 0.5f};
+        std::vector<std::string> rules;
+        std::vector<unsigned> threads;
+        double seconds = 0.25; // Minimum time to run each case for
+        std::string configFilename = "cells.cfg";
+        std::string outputFilename;
+    };
+
+    struct Result
+    {
+        std::string rules;
+        unsigned size;
+        float density;
+        bool toroidal;
+        bool partial;
+        unsigned threads;
+        unsigned long long generations; // Total generations, from all of the threads
+        double seconds;
+        double cells; // Total cells simulated
+    };
+
+    double cellsPerGeneration(const Automaton& automaton, const sf::Rect<unsigned>& rect)
+    {
+        // One-dimensional rules only compute a single row for each generation
+        if (automaton.getEngine() == Automaton::SpaceTime)
+            return rect.width;
+        return static_cast<double>(rect.width) * rect.height;
+    }
+
+    void printUsage(const char* name)
+    {
+        std::cout << "Usage: " << name << " [options]\n"
+                  << "Options:\n"
+                  << "  -s, --sizes <list>             Board sizes to run, like 32,256,1024,4096 (use 46341 or more for multi-GB boards)\n"
+                  << "  -d, --densities <list>         Chances of each cell starting out live, like 0.125,0.5\n"
+                  << "  -r, --rules <list>             Rule strings to run, separated by spaces (default is presetRules from the config file)\n"
+                  << "  -j, --threads <list>           Thread counts to measure scaling with (default is powers of 2 up to the number of cores)\n"
+                  << "  -t, --time <seconds>           Minimum time to run each case for (default is 0.25)\n"
+                  << "  -c, --config <file>            Config file to read presetRules from (default is cells.cfg)\n"
+                  << "  -o, --output <file>            Writes the JSON to a file instead of the standard output\n"
+                  << "  -h, --help                     Shows this message\n";
+    }
+
+    template <typename T>
+    std::vector<T> parseList(const std::string& str)
+    {
+        std::vector<T> values;
+        std::istringstream stream(str);
+        std::string token;
+        while (std::getline(stream, token, ','))
+        {
+            std::istringstream tokenStream(token);
+            T value;
+            if (tokenStream >> value)
+                values.push_back(value);
+        }
+        return values;
+    }
+
+    std::vector<std::string> parseRules(const std::string& str)
+    {
+        // Rule strings can have commas in them, so they are separated with spaces
+        std::vector<std::string> rules;
+        std::istringstream stream(str);
+        std::string rule;
+        while (stream >> rule)
+            rules.push_back(rule);
+        return rules;
+    }
+
+    std::string escapeJson(const std::string& str)
+    {
+        std::string escaped;
+        for (char c: str)
+        {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    // Makes a board with random cells, and sets the rules
+    bool setupAutomaton(Automaton& automaton, const std::string& rules, unsigned size, float density)
+    {
+        automaton.setMaxState(1);
+        if (!automaton.setRules(rules))
+            return false;
+        automaton.resize(size, size, false);
+        automaton.addRandom(density);
+        return true;
+    }
+
+    sf::Rect<unsigned> getRect(unsigned size, bool partial)
+    {
+        // Partial simulations use the middle of the board
+        if (partial)
+            return sf::Rect<unsigned>(size / 4, size / 4, size / 2, size / 2);
+        return sf::Rect<unsigned>(0, 0, size, size);
+    }
+
+    // Runs steps until the minimum time has passed, and returns the number of steps
+    unsigned long long runTimed(Automaton& automaton, const sf::Rect<unsigned>& rect, bool toroidal, bool partial, double seconds, double& elapsed)
+    {
+        unsigned long long steps = 0;
+        auto startTime = Clock::now();
+        do
+        {
+            automaton.simulate(rect, toroidal, partial);
+            ++steps;
+            elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
+        }
+        while (elapsed < seconds);
+        return steps;
+    }
+
+    Result runCase(const Settings& settings, const std::string& rules, unsigned size, float density, bool toroidal, bool partial)
+    {
+        Result result{rules, size, density, toroidal, partial, 1, 0, 0.0, 0.0};
+        Automaton automaton;
+        if (setupAutomaton(automaton, rules, size, density))
+        {
+            auto rect = getRect(size, partial);
+            automaton.simulate(rect, toroidal, partial); // Warm up the caches
+            result.rules = automaton.getRules();
+            auto startGeneration = automaton.getGeneration();
+            runTimed(automaton, rect, toroidal, partial, settings.seconds, result.seconds);
+            result.generations = automaton.getGeneration() - startGeneration;
+            result.cells = cellsPerGeneration(automaton, rect) * result.generations;
+        }
+        return result;
+    }
+
+    Result runThreads(const Settings& settings, const std::string& rules, unsigned size, float density, unsigned threadCount)
+    {
+        Result result{rules, size, density, true, false, threadCount, 0, 0.0, 0.0};
+        std::vector<Automaton> automatons(threadCount);
+        for (auto& automaton: automatons)
+            if (!setupAutomaton(automaton, rules, size, density))
+                return result;
+        result.rules = automatons.front().getRules();
+
+        // Every thread runs the same number of steps as one thread does in the minimum time
+        auto rect = getRect(size, false);
+        double calibrationTime = 0.0;
+        auto startGeneration = automatons.front().getGeneration();
+        unsigned long long steps = runTimed(automatons.front(), rect, true, false, settings.seconds, calibrationTime);
+        unsigned long long generations = automatons.front().getGeneration() - startGeneration;
+
+        std::vector<std::thread> threads;
+        auto startTime = Clock::now();
+        for (auto& automaton: automatons)
+        {
+            threads.emplace_back([&automaton, &rect, steps]
+            {
+                for (unsigned long long i = 0; i < steps; ++i)
+                    automaton.simulate(rect, true, false);
+            });
+        }
+        for (auto& thread: threads)
+            thread.join();
+        result.seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+        result.generations = generations * threadCount;
+        result.cells = cellsPerGeneration(automatons.front(), rect) * result.generations;
+        return result;
+    }
+
+    void writeResult(std::ostream& out, const Result& result, bool last)
+    {
+        out << "    {\"rules\": \"" << escapeJson(result.rules) << "\""
+            << ", \"width\": " << result.size
+            << ", \"height\": " << result.size
+            << ", \"density\": " << result.density
+            << ", \"toroidal\": " << (result.toroidal ? "true" : "false")
+            << ", \"partial\": " << (result.partial ? "true" : "false")
+            << ", \"threads\": " << result.threads
+            << ", \"generations\": " << result.generations
+            << ", \"seconds\": " << result.seconds
+            << ", \"generationsPerSecond\": " << (result.seconds > 0.0 ? result.generations / result.seconds : 0.0)
+            << ", \"cellsPerSecond\": " << (result.seconds > 0.0 ? result.cells / result.seconds : 0.0)
+            << "}" << (last ? "" : ",") << "\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    std::string rulesArgument;
+
+    // Read the arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if ((arg == "-s" || arg == "--sizes") && hasValue)
+            settings.sizes = parseList<unsigned>(argv[++i]);
+        else if ((arg == "-d" || arg == "--densities") && hasValue)
+            settings.densities = parseList<float>(argv[++i]);
+        else if ((arg == "-r" || arg == "--rules") && hasValue)
+            rulesArgument = argv[++i];
+        else if ((arg == "-j" || arg == "--threads") && hasValue)
+            settings.threads = parseList<unsigned>(argv[++i]);
+        else if ((arg == "-t" || arg == "--time") && hasValue)
+            settings.seconds = std::atof(argv[++i]);
+        else if ((arg == "-c" || arg == "--config") && hasValue)
+            settings.configFilename = argv[++i];
+        else if ((arg == "-o" || arg == "--output") && hasValue)
+            settings.outputFilename = argv[++i];
+        else if (arg == "-h" || arg == "--help")
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Use the preset rules if no rules were specified
+    if (!rulesArgument.empty())
+        settings.rules = parseRules(rulesArgument);
+    else
+    {
+        cfg::File config;
+        if (config.loadFromFile(settings.configFilename))
+            for (auto& opt: config("presetRules", "Board"))
+                settings.rules.push_back(opt.toString());
+    }
+
+    // Skip rules that can't be loaded (like rule tables when not running from the build folder)
+    Automaton test;
+    settings.rules.erase(std::remove_if(settings.rules.begin(), settings.rules.end(),
+        [&](const std::string& rules){ return !test.setRules(rules); }), settings.rules.end());
+    if (settings.rules.empty())
+        settings.rules.push_back(Automaton::defaultRuleString);
+
+    // Double the number of threads up to the number of cores
+    unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+    if (settings.threads.empty())
+    {
+        for (unsigned count = 1; count < cores; count *= 2)
+            settings.threads.push_back(count);
+        settings.threads.push_back(cores);
+    }
+
+    // Run all of the cases
+    std::vector<Result> results;
+    for (unsigned size: settings.sizes)
+    {
+        if (size < 3)
+            continue;
+        for (float density: settings.densities)
+            for (const auto& rules: settings.rules)
+                for (bool toroidal: {true, false})
+                    for (bool partial: {false, true})
+                        results.push_back(runCase(settings, rules, size, density, toroidal, partial));
+    }
+    std::vector<Result> scaling;
+    for (unsigned size: settings.sizes)
+        if (size >= 3)
+            for (unsigned threadCount: settings.threads)
+                if (threadCount > 0)
+                    scaling.push_back(runThreads(settings, settings.rules.front(), size, settings.densities.front(), threadCount));
+
+    // Write everything as JSON
+    std::ofstream outFile;
+    if (!settings.outputFilename.empty())
+    {
+        outFile.open(settings.outputFilename);
+        if (!outFile.is_open())
+        {
+            std::cerr << "Error: Could not write to \"" << settings.outputFilename << "\".\n";
+            return 1;
+        }
+    }
+    std::ostream& out = (outFile.is_open() ? outFile : std::cout);
+    out << "{\n  \"cores\": " << cores << ",\n  \"results\": [\n";
+    for (unsigned i = 0; i < results.size(); ++i)
+        writeResult(out, results[i], i + 1 == results.size());
+    out << "  ],\n  \"scaling\": [\n";
+    for (unsigned i = 0; i < scaling.size(); ++i)
+        writeResult(out, scaling[i], i + 1 == scaling.size());
+    out << "  ]\n}\n";
+    return 0;
+}
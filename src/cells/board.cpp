@@ -3,30 +3,45 @@
 
 #include "board.h"
 #include <algorithm>
+#include <limits>
+#include <memory>
+#include <iostream>
+#include "trace.h"
 
-const char* Board::defaultRuleString = "B3/S23";
-const float Board::unlimitedSpeed = 60.0f;
+const float Board::unlimitedSpeed = 0.0f;
+const float Board::maxCatchUpTime = 0.25f;
 const sf::Color Board::borderColors[] = {
     sf::Color(128, 128, 128),
     sf::Color::Green
 };
 
 Board::Board():
-    readBoard(0),
-    writeBoard(0),
+    simulation(automaton),
     playing(false),
     borderState(true),
     needToUpdateTexture(true),
+    counters(),
     grid(sf::Lines),
     gridShown(false),
+    pendingGenerations(0.0f),
+    frameBudget(sf::milliseconds(10)),
     autosaveImages(false),
     autosavePartialImages(false),
+    recordingFps(30),
+    editing(false),
+    cellsEdited(false),
+    cycleFound(false),
+    pauseOnCycle(false),
     paintingLine(false)
 {
+    simulation.setGenerationCallback([this](Automaton&){
+        recordGeneration();
+        logStatistics();
+        checkCycle();
+    });
     resetColors();
     boardSprite.setPosition(0, 0);
     setMaxSpeed(unlimitedSpeed);
-    setRules();
 
     // Setup border
     border.setPosition(0, 0);
@@ -42,6 +57,12 @@ Board::Board(unsigned width, unsigned height):
     resize(width, height, false);
 }
 
+Board::~Board()
+{
+    // The thread's commands and callback use the histories, so stop it before they are destroyed
+    simulation.stop();
+}
+
 void Board::setupScreenshots(const std::string& format, bool save, bool savePartial)
 {
     filenameGen.setFormat(format);
@@ -49,21 +70,70 @@ void Board::setupScreenshots(const std::string& format, bool save, bool savePart
     autosavePartialImages = savePartial;
 }
 
+void Board::setupScreenshotQueue(unsigned size, unsigned workers, bool dropWhenFull)
+{
+    screenshotWriter.setup(size, workers, dropWhenFull);
+}
+
+void Board::setupRecording(const std::string& format, unsigned fps)
+{
+    recordingFilenameGen.setFormat(format);
+    recordingFps = fps;
+}
+
+void Board::setupCheckpoints(const std::string& filename, unsigned generations, float seconds)
+{
+    checkpointer.setup(filename, generations, seconds);
+}
+
+void Board::setUndoMemory(unsigned megabytes)
+{
+    auto lock = simulation.lock();
+    history.setMemoryLimit(static_cast<std::size_t>(megabytes) * 1024 * 1024);
+}
+
+void Board::setRewindMemory(unsigned megabytes, unsigned keyframeInterval)
+{
+    auto lock = simulation.lock();
+    rewindHistory.setLimits(static_cast<std::size_t>(megabytes) * 1024 * 1024, keyframeInterval);
+    recordGeneration();
+}
+
+void Board::setupCycleDetection(unsigned generations, bool pause)
+{
+    auto lock = simulation.lock();
+    cycleDetector.setHistorySize(generations);
+    pauseOnCycle = pause;
+}
+
+bool Board::setupStatsLog(const std::string& filename)
+{
+    auto lock = simulation.lock();
+    statsLog.close();
+    automaton.setStatistics(!filename.empty());
+    if (filename.empty())
+        return true;
+    if (!statsLog.open(filename))
+    {
+        std::cerr << "Error: Could not write the statistics to \"" << filename << "\".\n";
+        automaton.setStatistics(false);
+        return false;
+    }
+    return true;
+}
+
 void Board::resize(unsigned width, unsigned height, bool preserve)
 {
+    auto lock = simulation.lock();
     // Only resize if the new size is different
-    if (width != board[readBoard].width() || height != board[readBoard].height())
+    if (width != automaton.width() || height != automaton.height())
     {
-        // Clear the logical arrays if specified
-        if (!preserve)
-        {
-            board[0].clear();
-            board[1].clear();
-        }
-
-        // Resize the logical arrays
-        board[0].resize(width, height);
-        board[1].resize(width, height);
+        history.clear();
+        // Resize the logical arrays, and clear them if specified
+        automaton.resize(width, height, preserve);
+        rewindHistory.clear();
+        recordGeneration();
+        cycleDetector.reset();
 
         // Create a new image with this size
         boardImage.create(width, height, cellColors.front().toColor());
@@ -77,12 +147,12 @@ void Board::resize(unsigned width, unsigned height, bool preserve)
 
 unsigned Board::width() const
 {
-    return board[readBoard].width();
+    return automaton.width();
 }
 
 unsigned Board::height() const
 {
-    return board[readBoard].height();
+    return automaton.height();
 }
 
 void Board::setColors(const std::vector<sf::Color>& colors)
@@ -150,90 +220,183 @@ void Board::reverseColors()
 
 void Board::setRules(const std::string& ruleString)
 {
-    rules.setFromString(ruleString.empty() ? defaultRuleString : ruleString);
+    auto lock = simulation.lock();
+    cycleDetector.reset();
+    // Use the colors from a rule table that was just loaded
+    if (automaton.setRules(ruleString) && automaton.getEngine() == Automaton::Table && !automaton.getTableColors().empty())
+    {
+        setColors(automaton.getTableColors());
+        updateImage();
+    }
 }
 
 void Board::setRules(const RuleSet& newRules)
 {
-    rules = newRules;
+    auto lock = simulation.lock();
+    cycleDetector.reset();
+    automaton.setRules(newRules);
 }
 
 const std::string& Board::getRules() const
 {
-    return rules.toString();
+    return automaton.getRules();
 }
 
 RuleSet& Board::accessRules()
 {
-    return rules;
+    return automaton.accessRules();
+}
+
+int Board::getEngine() const
+{
+    return automaton.getEngine();
 }
 
 void Board::simulate(bool toroidal)
 {
+    // Play the rewound generations again, unless the cells were edited since
+    if (fastForward())
+        return;
     simulate(sf::IntRect(0, 0, width(), height()), toroidal, false);
 }
 
 void Board::simulate(const sf::IntRect& rect, bool toroidal, bool partial)
 {
+    TRACE_SCOPE("Board::simulate");
+    finishEdit();
+    auto lock = simulation.lock();
     auto fixedRect = fixRectangle(rect);
     // Make sure the simulation area is at least 3x3
     if (fixedRect.width >= 3 && fixedRect.height >= 3 &&
-        (maxSpeed >= (unlimitedSpeed - 2.0f) || simTimer.getElapsedTime().asSeconds() >= maxTime))
-    {
-        /*
-        The order in which the cells are simulated:
-        2 2 2 2 2
-        3 1 1 1 3
-        3 1 1 1 3
-        3 1 1 1 3
-        2 2 2 2 2
-        This is so we can skip bounds checking and toroidal wrap-around algorithms for most of the cells.
-        */
-
+        (maxSpeed == unlimitedSpeed || simTimer.getElapsedTime().asSeconds() >= maxTime))
+    {
         simTimer.restart();
-        toggle(writeBoard);
-        sf::Vector2u cellPos;
-        unsigned bottom = fixedRect.top + fixedRect.height;
-        unsigned right = fixedRect.left + fixedRect.width;
-        unsigned totalCells = 0;
-
-        // This fixes a bug where partial simulations cause not all cells to be copied
-        if (partial || fixedRect.width < width() || fixedRect.height < height()) // If this is a partial simulation
-            board[writeBoard] = board[readBoard]; // Copy the latest board to the board being written to
-
-        // 1) Go through the main part of the cells except for the edges
-        for (cellPos.y = fixedRect.top + 1; cellPos.y < bottom - 1; ++cellPos.y)
-            for (cellPos.x = fixedRect.left + 1; cellPos.x < right - 1; ++cellPos.x, ++totalCells)
-                determineState(cellPos, countCellsFast(cellPos));
-        // 2) Top and bottom rows
-        for (cellPos.y = fixedRect.top; cellPos.y < bottom; cellPos.y += fixedRect.height - 1)
-            for (cellPos.x = fixedRect.left; cellPos.x < right; ++cellPos.x, ++totalCells)
-                determineState(cellPos, (toroidal ? countCellsToroidal(cellPos, fixedRect) : countCellsNormal(cellPos)));
-        // 3) Left and right columns
-        for (cellPos.x = fixedRect.left; cellPos.x < right; cellPos.x += fixedRect.width - 1)
-            for (cellPos.y = fixedRect.top + 1; cellPos.y < bottom - 1; ++cellPos.y, ++totalCells)
-                determineState(cellPos, (toroidal ? countCellsToroidal(cellPos, fixedRect) : countCellsNormal(cellPos)));
-        readBoard = writeBoard;
+        auto changed = runGeneration(fixedRect, toroidal, partial);
+        sf::Clock timer;
+        updatePixels(changed);
+        counters.colorize += timer.getElapsedTime();
 
         // Save a screenshot
         if (partial && autosavePartialImages)
             saveToImageFile(rect);
         else if (!partial && autosaveImages)
             saveToImageFile();
+        if (!partial)
+        {
+            recordFrame();
+            checkpointer.update(automaton.getCells(), automaton.getGeneration());
+        }
     }
 }
 
+void Board::simulateFrame(bool toroidal)
+{
+    TRACE_SCOPE("Board::simulateFrame");
+    auto lock = simulation.lock();
+    sf::Rect<unsigned> rect(0, 0, width(), height());
+    if (rect.width < 3 || rect.height < 3)
+        return;
+
+    // Work out how many generations are due
+    float elapsed = frameTimer.restart().asSeconds();
+    if (maxSpeed == unlimitedSpeed)
+        pendingGenerations = std::numeric_limits<float>::max();
+    else if (elapsed > maxCatchUpTime)
+        pendingGenerations = 1.0f; // Starting again after a pause, so don't try to catch up
+    else
+        pendingGenerations += elapsed * maxSpeed;
+
+    // Run as many of them as fit in the budget (at least one), and only draw the last one
+    sf::Clock budgetTimer;
+    bool simulated = false;
+    while (pendingGenerations >= 1.0f && (!simulated || budgetTimer.getElapsedTime() < frameBudget))
+    {
+        runGeneration(rect, toroidal, false);
+        pendingGenerations -= 1.0f;
+        simulated = true;
+        recordFrame();
+
+        // Every generation needs to be drawn when saving screenshots
+        if (autosaveImages)
+        {
+            updatePixels(rect);
+            saveToImageFile();
+        }
+    }
+
+    // Drop the generations that didn't fit, so the speed doesn't keep building up
+    pendingGenerations = std::min(pendingGenerations, 1.0f);
+    if (simulated && !autosaveImages)
+    {
+        sf::Clock timer;
+        updatePixels(rect);
+        counters.colorize += timer.getElapsedTime();
+    }
+    if (simulated)
+        checkpointer.update(automaton.getCells(), automaton.getGeneration());
+}
+
+bool Board::stepBack(bool toroidal)
+{
+    if (rewind())
+        return true;
+    auto lock = simulation.lock();
+    bool status = automaton.stepBack(toroidal);
+    if (status)
+    {
+        // Going back past the oldest kept generation starts the rewind history over
+        rewindHistory.clear();
+        recordGeneration();
+        cycleDetector.reset();
+        updatePixels(sf::Rect<unsigned>(0, 0, width(), height()));
+        recordFrame();
+    }
+    return status;
+}
+
 void Board::setMaxSpeed(float speed)
 {
-    maxSpeed = speed;
-    if (maxSpeed == 0)
-        maxSpeed = unlimitedSpeed;
-    maxTime = 1.0f / maxSpeed;
+    maxSpeed = std::max(speed, unlimitedSpeed);
+    maxTime = (maxSpeed == unlimitedSpeed ? 0.0f : 1.0f / maxSpeed);
+    simulation.setMaxSpeed(maxSpeed);
+}
+
+void Board::setFrameBudget(float milliseconds)
+{
+    frameBudget = sf::seconds(std::max(milliseconds, 0.0f) / 1000.0f);
+}
+
+void Board::setThreaded(bool state)
+{
+    if (state)
+        simulation.start();
+    else
+        simulation.stop();
+}
+
+void Board::setRowsPerStep(unsigned rows)
+{
+    auto lock = simulation.lock();
+    automaton.setRowsPerStep(rows);
+}
+
+void Board::setSeed(unsigned seed)
+{
+    auto lock = simulation.lock();
+    automaton.setSeed(seed);
+}
+
+std::uint64_t Board::getGeneration() const
+{
+    auto lock = simulation.lock();
+    return automaton.getGeneration();
 }
 
 bool Board::play()
 {
     playing = !playing;
+    frameTimer.restart();
+    pendingGenerations = 0.0f;
     return playing;
 }
 
@@ -244,14 +407,37 @@ bool Board::isPlaying() const
 
 void Board::update()
 {
-    if (playing)
-        simulate();
+    if (isThreaded())
+    {
+        simulation.setPlaying(playing);
+
+        // Draw the newest generation, unless the board was changed after it was finished
+        auto snapshot = simulation.getSnapshot();
+        if (snapshot && snapshot->version == simulation.getVersion())
+        {
+            updatePixels(*snapshot);
+            // Checkpoints are copied from the snapshot, so the simulation thread doesn't have to stop for them
+            checkpointer.update(snapshot->cells, snapshot->generation);
+        }
+    }
+    else
+    {
+        // Every generation needs to be drawn when saving screenshots or recording, so the thread isn't used
+        simulation.setPlaying(false);
+        if (playing && !editing)
+            simulateFrame();
+    }
+    reportCycle();
 }
 
 void Board::paintCell(const sf::Vector2i& pos, bool state)
 {
     if (inBounds(pos))
-        setCell(sf::Vector2u(pos.x, pos.y), state);
+    {
+        beginEdit();
+        touchCells(sf::Rect<unsigned>(pos.x, pos.y, 1, 1));
+        setCell(sf::Vector2u(pos.x, pos.y), (state ? automaton.liveState() : 0));
+    }
 }
 
 void Board::paintLine(const sf::Vector2i& startPos, const sf::Vector2i& endPos, bool state)
@@ -303,6 +489,7 @@ void Board::paintLine(const sf::Vector2i& pos, bool state)
 void Board::finishLine()
 {
     paintingLine = false;
+    finishEdit();
 }
 
 void Board::paintBlock(const sf::IntRect& rect, bool state)
@@ -311,15 +498,16 @@ void Board::paintBlock(const sf::IntRect& rect, bool state)
     auto fixedRect = fixRectangle(rect);
     if (fixedRect.width > 0 && fixedRect.height > 0)
     {
-        // Paint the cells
-        for (unsigned y = 0; y < fixedRect.height; ++y)
-            for (unsigned x = 0; x < fixedRect.width; ++x)
-                setCell(sf::Vector2u(fixedRect.left + x, fixedRect.top + y), state);
+        beginEdit();
+        touchCells(fixedRect);
+
+        fillBlock(fixedRect, (state ? automaton.liveState() : 0));
     }
 }
 
 void Board::copyBlock(const sf::IntRect& rect)
 {
+    auto lock = simulation.lock();
     // Calculate the proper block of cells to copy
     auto fixedRect = fixRectangle(rect);
     if (fixedRect.width > 0 && fixedRect.height > 0)
@@ -330,7 +518,7 @@ void Board::copyBlock(const sf::IntRect& rect)
         // Copy the cells into the buffer
         for (unsigned y = 0; y < fixedRect.height; ++y)
             for (unsigned x = 0; x < fixedRect.width; ++x)
-                copiedCells(x, y) = board[readBoard](fixedRect.left + x, fixedRect.top + y);
+                copiedCells(x, y) = automaton(fixedRect.left + x, fixedRect.top + y);
     }
 }
 
@@ -340,52 +528,170 @@ void Board::pasteBlock(const sf::Vector2i& pos)
     auto fixedRect = fixRectangle(sf::IntRect(pos.x, pos.y, copiedCells.width(), copiedCells.height()));
     if (fixedRect.width > 0 && fixedRect.height > 0)
     {
-        // Paste the cells exactly as they were copied
+        beginEdit();
+        touchCells(fixedRect);
+
+        // Paste the cells exactly as they were copied (only the part that fits on the board)
+        Matrix<char> pasted(fixedRect.width, fixedRect.height);
         for (unsigned y = 0; y < fixedRect.height; ++y)
         {
             for (unsigned x = 0; x < fixedRect.width; ++x)
             {
-                sf::Vector2u absolutePos(fixedRect.left + x, fixedRect.top + y);
                 // Make sure the state is valid, since the colors could change
-                char state = std::min(copiedCells(x, y), maxState);
-                setCell(absolutePos, state);
+                pasted(x, y) = std::min(copiedCells(x, y), maxState);
             }
         }
+        setBlock(fixedRect, pasted);
+    }
+}
+
+bool Board::undo()
+{
+    finishEdit();
+    auto lock = simulation.lock();
+    sf::Rect<unsigned> changed;
+    bool status = history.undo(automaton.getCells(),
+        [&](const sf::Vector2u& pos, char state){ automaton.setCell(pos, state); }, changed);
+    if (status)
+    {
+        cellsEdited = true;
+        cycleDetector.reset();
+        updatePixels(changed);
+    }
+    return status;
+}
+
+bool Board::redo()
+{
+    finishEdit();
+    auto lock = simulation.lock();
+    sf::Rect<unsigned> changed;
+    bool status = history.redo(automaton.getCells(),
+        [&](const sf::Vector2u& pos, char state){ automaton.setCell(pos, state); }, changed);
+    if (status)
+    {
+        cellsEdited = true;
+        cycleDetector.reset();
+        updatePixels(changed);
+    }
+    return status;
+}
+
+bool Board::rewind(unsigned generations)
+{
+    finishEdit();
+    auto lock = simulation.lock();
+    if (cellsEdited)
+    {
+        // Keep the edits in the history, so going forward again comes back to them
+        recordGeneration();
+        cellsEdited = false;
     }
+    Automaton::Position position;
+    sf::Rect<unsigned> changed;
+    bool status = (automaton.getEngine() != Automaton::Continuous &&
+        rewindHistory.rewind(generations, automaton.getCells(),
+            [&](const sf::Vector2u& pos, char state){ automaton.setCell(pos, state); }, position, changed));
+    if (status)
+    {
+        cycleDetector.reset();
+        automaton.setPosition(position);
+        updatePixels(changed);
+        recordFrame();
+    }
+    return status;
+}
+
+bool Board::fastForward(unsigned generations)
+{
+    finishEdit();
+    auto lock = simulation.lock();
+    if (cellsEdited)
+    {
+        // Edits after rewinding replace the generations that came after
+        recordGeneration();
+        cellsEdited = false;
+    }
+    Automaton::Position position;
+    sf::Rect<unsigned> changed;
+    bool status = (automaton.getEngine() != Automaton::Continuous &&
+        rewindHistory.forward(generations, automaton.getCells(),
+            [&](const sf::Vector2u& pos, char state){ automaton.setCell(pos, state); }, position, changed));
+    if (status)
+    {
+        cycleDetector.reset();
+        automaton.setPosition(position);
+        updatePixels(changed);
+        recordFrame();
+    }
+    return status;
+}
+
+bool Board::printCensus(unsigned maxPeriod)
+{
+    auto lock = simulation.lock();
+    std::vector<Census::Entry> entries;
+    if (!Census::take(automaton, true, maxPeriod, entries))
+    {
+        std::cerr << "Error: The census only works with rules that don't use random numbers, and have a fixed neighborhood\n";
+        return false;
+    }
+    std::uint64_t objects = 0;
+    for (const auto& entry: entries)
+        objects += entry.count;
+    std::cout << "Generation " << automaton.getGeneration() << ": Found " << objects << " objects of " << entries.size() << " kinds\n";
+    for (const auto& entry: entries)
+        std::cout << "    " << entry.count << " " << entry.code << " (" << Census::getKindName(entry.kind) << ")\n";
+    return true;
 }
 
 void Board::clear()
 {
-    sf::Vector2u cellPos;
-    for (cellPos.y = 0; cellPos.y < board[writeBoard].height(); ++cellPos.y)
-        for (cellPos.x = 0; cellPos.x < board[writeBoard].width(); ++cellPos.x)
-            setCell(cellPos, 0);
+    finishEdit();
+    auto lock = simulation.lock();
+    history.begin();
+    history.touch(automaton.getCells(), sf::Rect<unsigned>(0, 0, width(), height()));
+    automaton.clear();
+    history.end(automaton.getCells());
+    cellsEdited = true;
+    cycleDetector.reset();
+    updateImage();
 }
 
 void Board::addRandom()
 {
-    unsigned w = width();
-    unsigned h = height();
-    unsigned iterations = (w * h) / 8;
-    for (unsigned i = 0; i < iterations; ++i)
-        paintCell(sf::Vector2i(rand() % w, rand() % h), true);
+    finishEdit();
+    auto lock = simulation.lock();
+    history.begin();
+    history.touch(automaton.getCells(), sf::Rect<unsigned>(0, 0, width(), height()));
+    automaton.addRandom();
+    history.end(automaton.getCells());
+    cellsEdited = true;
+    cycleDetector.reset();
+    updateImage();
 }
 
 bool Board::saveToFile(const std::string& filename) const
 {
-    return board[readBoard].saveToFile(filename);
+    auto lock = simulation.lock();
+    return automaton.saveToFile(filename);
 }
 
 bool Board::loadFromFile(const std::string& filename)
 {
-    bool status = board[writeBoard].loadFromFile(filename);
+    auto lock = simulation.lock();
+    std::string oldRules = automaton.getRules();
+    bool status = automaton.loadFromFile(filename);
     if (status)
     {
-        // Needs to copy the newly loaded board to the other board
-        unsigned newWidth = board[writeBoard].width();
-        unsigned newHeight = board[writeBoard].height();
-        board[(writeBoard + 1) % 2] = board[writeBoard];
-        boardImage.create(newWidth, newHeight);
+        history.clear();
+        rewindHistory.clear();
+        recordGeneration();
+        cycleDetector.reset();
+        // Patterns can change the rules, and rule tables can have their own colors
+        if (automaton.getRules() != oldRules && automaton.getEngine() == Automaton::Table && !automaton.getTableColors().empty())
+            setColors(automaton.getTableColors());
+        boardImage.create(width(), height());
         updateImage();
         updateTexture();
         updateBorderSize();
@@ -396,15 +702,49 @@ bool Board::loadFromFile(const std::string& filename)
 
 bool Board::saveToImageFile(const std::string& filename) const
 {
-    return boardImage.saveToFile(filename.empty() ? filenameGen.getNextFilename() : filename);
+    TRACE_SCOPE("Board::saveToImageFile");
+    return screenshotWriter.add(boardImage, filename.empty() ? filenameGen.getNextFilename() : filename);
 }
 
 bool Board::saveToImageFile(const sf::IntRect& rect, const std::string& filename) const
 {
-    sf::Image partialImage;
-    partialImage.create(rect.width, rect.height);
-    partialImage.copy(boardImage, 0, 0, rect);
-    return partialImage.saveToFile(filename.empty() ? filenameGen.getNextFilename() : filename);
+    TRACE_SCOPE("Board::saveToImageFile");
+    return screenshotWriter.add(boardImage, rect, filename.empty() ? filenameGen.getNextFilename() : filename);
+}
+
+bool Board::toggleRecording()
+{
+    auto lock = simulation.lock();
+    if (recorder.isRecording())
+    {
+        std::cout << "Recorded " << recorder.getFrameCount() << " frames\n";
+        recorder.stop();
+        return false;
+    }
+
+    // Continuous rules get a gradient of 256 colors, otherwise each state is a palette index
+    std::vector<sf::Color> palette;
+    if (automaton.getEngine() == Automaton::Continuous)
+    {
+        for (unsigned i = 0; i < 256; ++i)
+            palette.push_back(blendColors(i / 255.0f));
+    }
+    else
+    {
+        for (const auto& color: cellColors)
+            palette.push_back(color.toColor());
+    }
+    std::string filename = recordingFilenameGen.getNextFilename();
+    if (!recorder.start(filename, width(), height(), palette, recordingFps))
+        return false;
+    std::cout << "Recording to \"" << filename << "\"\n";
+    recordFrame(); // Start with the current generation
+    return true;
+}
+
+bool Board::isRecording() const
+{
+    return recorder.isRecording();
 }
 
 bool Board::setBoardState(bool state)
@@ -434,20 +774,21 @@ void Board::showGrid(bool state)
 
 void Board::updateImage()
 {
-    needToUpdateTexture = true;
-    sf::Vector2u cellPos;
-    for (cellPos.y = 0; cellPos.y < board[readBoard].height(); ++cellPos.y)
-        for (cellPos.x = 0; cellPos.x < board[readBoard].width(); ++cellPos.x)
-            setPixel(cellPos.x, cellPos.y, std::min(board[readBoard](cellPos), maxState));
+    TRACE_SCOPE("Board::updateImage");
+    auto lock = simulation.lock();
+    updatePixels(sf::Rect<unsigned>(0, 0, width(), height()));
 }
 
 void Board::updateTexture()
 {
+    TRACE_SCOPE("Board::updateTexture");
     if (needToUpdateTexture)
     {
+        sf::Clock timer;
         boardTexture.loadFromImage(boardImage); // Copy the image into the texture
         boardSprite.setTexture(boardTexture, true);
         needToUpdateTexture = false;
+        counters.upload += timer.getElapsedTime();
     }
 }
 
@@ -459,108 +800,171 @@ void Board::draw(sf::RenderTarget& window, sf::RenderStates states) const
         window.draw(grid);
 }
 
-unsigned Board::countCellsFast(const sf::Vector2u& pos)
+Board::Counters Board::takeCounters()
 {
-    // WARNING: This function assumes the following is true:
-    // if (pos.x > 0 && pos.y > 0 && pos.x < board.width() - 1 && pos.y < board.height() - 1)
-    // Which means that you should not use this function on cells that are on the edge of the board!
-    // This is only done for performance reasons.
-    unsigned count = 0;
-    sf::Vector2u startPos(pos.x - 1, pos.y - 1);
-    sf::Vector2u endPos(pos.x + 1, pos.y + 1);
-    sf::Vector2u tempPos;
-
-    // Iterate through a 3x3 grid around the cell
-    for (tempPos.y = startPos.y; tempPos.y <= endPos.y; ++tempPos.y)
-        for (tempPos.x = startPos.x; tempPos.x <= endPos.x; ++tempPos.x)
-            if (tempPos != pos) // Ignore the center cell
-                count += (board[readBoard](tempPos) != 0); // Increment the count if the cell is live
-
-    return count;
+    Counters taken = counters;
+    counters = Counters();
+
+    // Add the generations from the simulation thread
+    std::uint64_t generations = 0;
+    double cells = 0.0;
+    double seconds = 0.0;
+    simulation.takeCounters(generations, cells, seconds);
+    taken.simulate += sf::seconds(seconds);
+    taken.generations += generations;
+    taken.cells += cells;
+    return taken;
 }
 
-unsigned Board::countCellsNormal(const sf::Vector2u& pos)
+void Board::setCell(const sf::Vector2u& pos, char state)
 {
-    unsigned count = 0;
-    sf::Vector2u startPos(std::max(pos.x - 1, 0U), std::max(pos.y - 1, 0U));
-    sf::Vector2u endPos(std::min(pos.x + 1, width() - 1), std::min(pos.y + 1, height() - 1));
-    sf::Vector2u tempPos;
-
-    // Iterate through a 3x3 grid around the cell
-    for (tempPos.y = startPos.y; tempPos.y <= endPos.y; ++tempPos.y)
-        for (tempPos.x = startPos.x; tempPos.x <= endPos.x; ++tempPos.x)
-            if (tempPos != pos) // Ignore the center cell
-                count += (board[readBoard](tempPos) != 0); // Increment the count if the cell is live
-
-    return count;
+    // The pixel is updated right away, even if the thread is busy with a generation
+    simulation.post([pos, state](Automaton& target){ target.setCell(pos, state); });
+    setPixel(pos.x, pos.y, state);
+    needToUpdateTexture = true;
+    cellsEdited = true;
 }
 
-unsigned Board::countCellsToroidal(const sf::Vector2u& pos, sf::Rect<unsigned>& rect)
+void Board::fillBlock(const sf::Rect<unsigned>& rect, char state)
 {
-    unsigned count = 0;
-    sf::Vector2u tempPos;
-    unsigned bottom = rect.top + rect.height - 1;
-    unsigned right = rect.left + rect.width - 1;
-
-    // Pre-calculate the ranges of cells to count
-    unsigned rangeX[3] = {pos.x - 1, pos.x, pos.x + 1};
-    unsigned rangeY[3] = {pos.y - 1, pos.y, pos.y + 1};
-    if (pos.x == rect.left)
-        rangeX[0] = right;
-    else if (pos.x == right)
-        rangeX[2] = rect.left;
-    if (pos.y == rect.top)
-        rangeY[0] = bottom;
-    else if (pos.y == bottom)
-        rangeY[2] = rect.top;
+    simulation.post([rect, state](Automaton& target){
+        for (unsigned y = rect.top; y < rect.top + rect.height; ++y)
+            for (unsigned x = rect.left; x < rect.left + rect.width; ++x)
+                target.setCell(sf::Vector2u(x, y), state);
+    });
+    for (unsigned y = rect.top; y < rect.top + rect.height; ++y)
+        for (unsigned x = rect.left; x < rect.left + rect.width; ++x)
+            setPixel(x, y, state);
+    needToUpdateTexture = true;
+    cellsEdited = true;
+}
 
-    // Iterate through the ranges as a wrapped-around 3x3 grid
-    for (unsigned y: rangeY)
-        for (unsigned x: rangeX)
-            if (x != pos.x || y != pos.y) // Ignore the center cell
-                count += (board[readBoard](x, y) != 0); // Increment the count if the cell is live
+void Board::setBlock(const sf::Rect<unsigned>& rect, const Matrix<char>& cells)
+{
+    // Commands are copied when they are queued, so the cells are shared instead of copied with them
+    auto shared = std::make_shared<const Matrix<char>>(cells);
+    simulation.post([rect, shared](Automaton& target){
+        for (unsigned y = 0; y < rect.height; ++y)
+            for (unsigned x = 0; x < rect.width; ++x)
+                target.setCell(sf::Vector2u(rect.left + x, rect.top + y), (*shared)(x, y));
+    });
+    for (unsigned y = 0; y < rect.height; ++y)
+        for (unsigned x = 0; x < rect.width; ++x)
+            setPixel(rect.left + x, rect.top + y, cells(x, y));
+    needToUpdateTexture = true;
+    cellsEdited = true;
+}
 
-    return count;
+void Board::setPixel(unsigned x, unsigned y, char state)
+{
+    boardImage.setPixel(x, y, cellColors[state].toColor());
 }
 
-void Board::determineState(const sf::Vector2u& pos, unsigned count)
+sf::Rect<unsigned> Board::runGeneration(const sf::Rect<unsigned>& rect, bool toroidal, bool partial)
 {
-    // Uses the rule set lookup table, and updates the state of the cell to the new state
-    bool currentState = (board[readBoard](pos) != 0);
-    incrementCell(pos, rules.getRule(currentState, count));
+    sf::Clock timer;
+    auto startGeneration = automaton.getGeneration();
+    auto changed = automaton.simulate(rect, toroidal, partial);
+    recordGeneration();
+    logStatistics();
+    // Only simulating the whole board can make it repeat
+    if (partial)
+        cycleDetector.reset();
+    else
+        checkCycle();
+    counters.simulate += timer.getElapsedTime();
+    auto generations = automaton.getGeneration() - startGeneration;
+    counters.generations += generations;
+    // One-dimensional rules only compute a single row for each generation
+    if (automaton.getEngine() == Automaton::SpaceTime)
+        counters.cells += static_cast<double>(rect.width) * generations;
+    else
+        counters.cells += static_cast<double>(changed.width) * changed.height * generations;
+    return changed;
 }
 
-void Board::setCell(const sf::Vector2u& pos, char state)
+void Board::updatePixels(const sf::Rect<unsigned>& rect)
 {
-    board[writeBoard](pos) = state;
-    setPixel(pos.x, pos.y, state);
+    TRACE_SCOPE("Board::updatePixels");
+    bool continuous = (automaton.getEngine() == Automaton::Continuous);
+    for (unsigned y = rect.top; y < rect.top + rect.height; ++y)
+    {
+        for (unsigned x = rect.left; x < rect.left + rect.width; ++x)
+        {
+            if (continuous)
+                boardImage.setPixel(x, y, blendColors(automaton.getValue(x, y)));
+            else
+                setPixel(x, y, std::min(automaton(x, y), maxState));
+        }
+    }
     needToUpdateTexture = true;
 }
 
-void Board::incrementCell(const sf::Vector2u& pos, bool state)
+void Board::updatePixels(const SimulationThread::Snapshot& snapshot)
 {
-    char& cell = board[writeBoard](pos);
-    if (state)
-        cell = std::min(static_cast<char>(board[readBoard](pos) + 1), maxState);
-    else
-        cell = 0;
-    setPixel(pos.x, pos.y, cell);
+    TRACE_SCOPE("Board::updatePixels");
+    const Matrix<char>& cells = snapshot.cells;
+    if (cells.width() != width() || cells.height() != height())
+        return;
+    bool continuous = !snapshot.values.empty();
+    for (unsigned y = 0; y < cells.height(); ++y)
+    {
+        for (unsigned x = 0; x < cells.width(); ++x)
+        {
+            if (continuous)
+                boardImage.setPixel(x, y, blendColors(snapshot.values[y * cells.width() + x]));
+            else
+                setPixel(x, y, std::min(cells(x, y), maxState));
+        }
+    }
     needToUpdateTexture = true;
 }
 
-void Board::setPixel(unsigned x, unsigned y, char state)
+void Board::recordFrame()
 {
-    boardImage.setPixel(x, y, cellColors[state].toColor());
+    if (!recorder.isRecording())
+        return;
+    recordingFrame.resize(width(), height(), false);
+    bool continuous = (automaton.getEngine() == Automaton::Continuous);
+    for (unsigned y = 0; y < height(); ++y)
+    {
+        for (unsigned x = 0; x < width(); ++x)
+        {
+            if (continuous)
+                recordingFrame(x, y) = static_cast<std::uint8_t>(std::min(std::max(automaton.getValue(x, y), 0.0f), 1.0f) * 255 + 0.5f);
+            else
+                recordingFrame(x, y) = static_cast<std::uint8_t>(std::min(automaton(x, y), maxState));
+        }
+    }
+    // The video can't change size, so a resized board ends the recording
+    if (!recorder.addFrame(recordingFrame))
+    {
+        std::cerr << "Error: The board changed size, so the recording was stopped\n";
+        recorder.stop();
+    }
 }
 
-bool Board::inBounds(const sf::Vector2i& pos) const
+bool Board::isThreaded() const
+{
+    return (simulation.isRunning() && !autosaveImages && !recorder.isRecording());
+}
+
+sf::Color Board::blendColors(float value) const
 {
-    return (pos.x >= 0 && pos.y >= 0 && pos.x < static_cast<int>(board[writeBoard].width()) && pos.y < static_cast<int>(board[writeBoard].height()));
+    // Spread the value across the whole gradient of cell colors
+    float position = std::min(std::max(value, 0.0f), 1.0f) * (cellColors.size() - 1);
+    unsigned index = std::min(static_cast<unsigned>(position), static_cast<unsigned>(cellColors.size() - 2));
+    float amount = position - index;
+    const sf::Color& first = cellColors[index].toColor();
+    const sf::Color& second = cellColors[index + 1].toColor();
+    return sf::Color(first.r + (second.r - first.r) * amount,
+                     first.g + (second.g - first.g) * amount,
+                     first.b + (second.b - first.b) * amount);
 }
 
-void Board::toggle(unsigned& val) const
+bool Board::inBounds(const sf::Vector2i& pos) const
 {
-    val = !(static_cast<bool>(val));
+    return (pos.x >= 0 && pos.y >= 0 && pos.x < static_cast<int>(width()) && pos.y < static_cast<int>(height()));
 }
 
 void Board::updateBorderSize()
@@ -575,8 +979,8 @@ sf::Rect<unsigned> Board::fixRectangle(const sf::IntRect& rect) const
 
     // Convert the rectangle into coordinates of 2 corners
     // Also make sure everything is within bounds
-    int boardWidth = board[readBoard].width();
-    int boardHeight = board[readBoard].height();
+    int boardWidth = width();
+    int boardHeight = height();
     sf::Vector2u topLeft(std::min(std::max(rect.left, 0), boardWidth),
                          std::min(std::max(rect.top, 0), boardHeight));
     sf::Vector2u bottomRight(std::min(std::max(rect.left + rect.width, 0), boardWidth),
@@ -590,7 +994,9 @@ sf::Rect<unsigned> Board::fixRectangle(const sf::IntRect& rect) const
 
 void Board::updateMaxState()
 {
+    auto lock = simulation.lock();
     maxState = static_cast<char>(cellColors.size() - 1);
+    automaton.setMaxState(maxState);
 }
 
 void Board::updateGrid()
@@ -614,3 +1020,74 @@ void Board::updateGrid()
     }
     setGridColor();
 }
+
+void Board::beginEdit()
+{
+    // The history is changed on the simulation thread, in order with the cells that are painted
+    // No generations are run until the edit is finished, so it only stores what was painted
+    if (!editing)
+    {
+        editing = true;
+        simulation.setHeld(true);
+        simulation.post([this](Automaton&){ history.begin(); });
+    }
+}
+
+void Board::touchCells(const sf::Rect<unsigned>& rect)
+{
+    simulation.post([this, rect](Automaton& target){
+        history.touch(target.getCells(), rect);
+        cycleDetector.reset();
+    });
+}
+
+void Board::finishEdit()
+{
+    if (editing)
+    {
+        editing = false;
+        // Let the simulation go on only once the edit is stored, since commands are run before the next generation
+        simulation.post([this](Automaton& target){
+            history.end(target.getCells());
+            simulation.setHeld(false);
+        });
+    }
+}
+
+void Board::recordGeneration()
+{
+    // The real values of continuous rules can't be rewound, only their states
+    if (automaton.getEngine() != Automaton::Continuous)
+        rewindHistory.record(automaton.getCells(), automaton.getPosition());
+}
+
+void Board::checkCycle()
+{
+    if (cycleDetector.update(automaton))
+        cycleFound = true;
+}
+
+void Board::reportCycle()
+{
+    if (!cycleFound.exchange(false))
+        return;
+    auto lock = simulation.lock();
+    const auto& cycle = cycleDetector.getCycle();
+    if (cycle.period == 0)
+        return;
+    std::cout << "Generation " << cycle.generation << ": ";
+    if (cycle.dx != 0 || cycle.dy != 0)
+        std::cout << "Found a spaceship with period " << cycle.period << ", moving (" << cycle.dx << ", " << cycle.dy << ") each period\n";
+    else if (cycle.period == 1)
+        std::cout << "The board stopped changing\n";
+    else
+        std::cout << "Found an oscillator with period " << cycle.period << "\n";
+    if (pauseOnCycle)
+        playing = false;
+}
+
+void Board::logStatistics()
+{
+    if (statsLog.isOpen())
+        statsLog.add(automaton.getStatistics());
+}
@@ -5,26 +5,61 @@
 #define BOARD_H
 
 #include <string>
+#include <atomic>
 #include <SFML/Graphics.hpp>
-#include "matrix.h"
-#include "ruleset.h"
+#include "automaton.h"
+#include "simulationthread.h"
 #include "colorcode.h"
 #include "configoption.h"
 #include "filenamegenerator.h"
+#include "screenshotwriter.h"
+#include "recorder.h"
+#include "checkpointer.h"
+#include "cycledetector.h"
+#include "census.h"
+#include "edithistory.h"
+#include "rewindhistory.h"
+#include "statslog.h"
 
 /*
-This class is used for simulating cellular automata.
+This class is used for drawing and editing a cellular automaton (see the Automaton class).
 It handles simulating, drawing, saving, and loading.
 It also supports custom rule sets.
+Continuous rules (see the Lenia class) are shown by blending between the cell colors.
+Multi-state rule tables (see the RuleTable class) use the colors from the table if it has any.
+Recent generations are kept (see the RewindHistory class), so the board can be rewound and played forward again.
+Reversible block rules (see the Margolus class) can also be stepped backwards past the oldest kept generation.
+One-dimensional rules (see the Elementary class) fill the board with a scrolling space-time diagram.
+Still lifes, oscillators, and spaceships are found while simulating (see the CycleDetector class), and can pause the board.
+The population of each generation can be logged to a file (see the StatsLog class).
+The objects on a settled board can be counted and named (see the Census class).
+The simulation can run on its own thread (see the SimulationThread class), in which case the newest
+    finished generation is drawn each frame, and painted cells are sent to the thread as commands.
 */
 class Board: public sf::Drawable
 {
     public:
-        static const char* defaultRuleString;
+        // Times and amounts of work since the counters were last taken, used for performance stats
+        struct Counters
+        {
+            sf::Time simulate;
+            sf::Time colorize;
+            sf::Time upload;
+            std::uint64_t generations;
+            double cells;
+        };
 
         Board();
         Board(unsigned width, unsigned height);
+        ~Board();
         void setupScreenshots(const std::string& format, bool save, bool savePartial);
+        void setupScreenshotQueue(unsigned size, unsigned workers, bool dropWhenFull); // Images are saved on worker threads (0 workers uses every core)
+        void setupRecording(const std::string& format, unsigned fps); // The extension picks the video format (see the Recorder class)
+        void setupCheckpoints(const std::string& filename, unsigned generations, float seconds); // Saves the board in the background every so often (0 turns off either interval)
+        void setUndoMemory(unsigned megabytes); // The most memory the undo history can use
+        void setRewindMemory(unsigned megabytes, unsigned keyframeInterval); // The most memory the rewind history can use (0 turns it off)
+        void setupCycleDetection(unsigned generations, bool pause); // Looks for cycles up to this period (0 turns it off), and can pause when one is found
+        bool setupStatsLog(const std::string& filename); // Logs the statistics of each generation (an empty filename turns it off), returns false if the file couldn't be made
 
         // Board size
         void resize(unsigned width, unsigned height, bool preserve = true); // Resizes the board, can be non-destructive
@@ -41,15 +76,23 @@ class Board: public sf::Drawable
         void reverseColors(); // Reverses the order of the current colors
 
         // Rule settings
-        void setRules(const std::string& ruleString = defaultRuleString); // Sets the rules from a rule string (see the RuleSet class for more information)
+        void setRules(const std::string& ruleString = Automaton::defaultRuleString); // Sets the rules from a rule string (see the Automaton class for more information)
         void setRules(const RuleSet& newRules); // Sets the rules from another rule set object
         const std::string& getRules() const; // Returns the rules in the same string format as above
         RuleSet& accessRules(); // Returns a reference to the rule set
+        int getEngine() const; // Returns which type of rules are being simulated
 
         // Simulation
-        void simulate(bool toroidal = true); // Runs a single generation on the entire board
+        void simulate(bool toroidal = true); // Runs a single generation on the entire board (or goes forward again after rewinding)
         void simulate(const sf::IntRect& rect, bool toroidal = true, bool partial = true); // Runs a single generation on the specified area
-        void setMaxSpeed(float speed);
+        void simulateFrame(bool toroidal = true); // Runs as many generations as the speed allows in this frame (within the frame budget), and only draws the last one
+        bool stepBack(bool toroidal = true); // Rewinds a single generation, or runs one backwards if the rules are reversible, returns false if neither worked
+        void setMaxSpeed(float speed); // In generations per second, 0 is unlimited
+        void setFrameBudget(float milliseconds); // Longest time to spend simulating in each frame, when not using the simulation thread
+        void setThreaded(bool state); // Runs the simulation on its own thread, so slow generations don't hold up drawing
+        void setRowsPerStep(unsigned rows); // Sets how many generations of one-dimensional rules run in a single step
+        void setSeed(unsigned seed); // Sets the seed used for stochastic rules and random cells
+        std::uint64_t getGeneration() const; // Returns the number of generations since the board was cleared (board files keep it when saved and loaded)
         bool play(); // Returns true if playing, false if paused
         bool isPlaying() const;
         void update(); // Simulates the board if playing is true
@@ -58,19 +101,32 @@ class Board: public sf::Drawable
         void paintCell(const sf::Vector2i& pos, bool state); // Sets the state of a cell, does bounds checking
         void paintLine(const sf::Vector2i& startPos, const sf::Vector2i& endPos, bool state); // Paints a line of cells
         void paintLine(const sf::Vector2i& pos, bool state); // Paints a line of cells (good for user input, see implementation for more details)
-        void finishLine(); // Ends the line being painted, so that a new line can be painted
+        void finishLine(); // Ends the line being painted, so that a new line can be painted (and finishes the edit for undoing)
         void paintBlock(const sf::IntRect& rect, bool state); // Paints a rectangular block of any size
         void copyBlock(const sf::IntRect& rect); // Stores the cells into a temporary buffer
         void pasteBlock(const sf::Vector2i& pos); // Pastes the cells from the buffer into this position
 
+        // Undo history (see the EditHistory class)
+        bool undo(); // Undoes the last edit, returns false if there was nothing to undo
+        bool redo(); // Redoes the last undone edit
+
+        // Rewinding (see the RewindHistory class)
+        bool rewind(unsigned generations = 1); // Goes back to an earlier generation, returns false if there are no older ones kept
+        bool fastForward(unsigned generations = 1); // Goes forward again after rewinding, returns false if already at the newest generation
+
+        // Census (see the Census class)
+        bool printCensus(unsigned maxPeriod); // Counts each kind of object on the board and prints them, returns false if the rules aren't supported
+
         // Board loading/saving
         void clear(); // Clears the entire board
         void addRandom(); // Adds some random cells
         bool saveToFile(const std::string& filename) const; // Saves the board to a file
         bool loadFromFile(const std::string& filename); // Loads the board from a file
-        bool saveToImageFile(const std::string& filename = "") const; // Saves the entire graphical board to an image file
-        bool saveToImageFile(const sf::IntRect& rect, const std::string& filename = "") const; // Saves a portion of the graphical board to an image file
+        bool saveToImageFile(const std::string& filename = "") const; // Queues the entire graphical board to be saved to an image file, returns false if it was skipped
+        bool saveToImageFile(const sf::IntRect& rect, const std::string& filename = "") const; // Queues a portion of the graphical board to be saved to an image file
         //bool loadFromImageFile(const std::string& filename) const; // Loads the board from an image (Note: current colors are used)
+        bool toggleRecording(); // Starts or stops recording every generation to a video file, returns true if recording
+        bool isRecording() const;
 
         // Rendering
         bool setBoardState(bool state); // Sets the color of the border (returns true if changed)
@@ -80,33 +136,37 @@ class Board: public sf::Drawable
         void updateTexture(); // Copies the image to the texture if necessary
         void draw(sf::RenderTarget& window, sf::RenderStates states) const; // Draw to the window
 
-    private:
-        // These are used for simulation
-        unsigned countCellsFast(const sf::Vector2u& pos); // Counts neighboring cells at a position, this is not toroidal and does no bounds checking
-        unsigned countCellsNormal(const sf::Vector2u& pos); // Counts neighboring cells at a position, this is not toroidal
-        unsigned countCellsToroidal(const sf::Vector2u& pos, sf::Rect<unsigned>& rect); // Counts neighboring cells at a position, this is toroidal
-        void determineState(const sf::Vector2u& pos, unsigned count); // Determines the next state of the cell based on the number of neighboring cells
+        // Performance
+        Counters takeCounters(); // Returns the counters and resets them
 
+    private:
         // Other functions
         void setCell(const sf::Vector2u& pos, char state); // Sets the state of a cell
-        void incrementCell(const sf::Vector2u& pos, bool state); // Sets the state of a cell (also increments the color)
+        void fillBlock(const sf::Rect<unsigned>& rect, char state); // Sets every cell in a rectangle, with a single command for the simulation thread
+        void setBlock(const sf::Rect<unsigned>& rect, const Matrix<char>& cells); // Sets a rectangle of cells from a copy the same size, with a single command
         void setPixel(unsigned x, unsigned y, char state); // Set the graphical state of a cell
+        sf::Rect<unsigned> runGeneration(const sf::Rect<unsigned>& rect, bool toroidal, bool partial); // Simulates without drawing, and updates the counters
+        void updatePixels(const sf::Rect<unsigned>& rect); // Updates the pixels of part of the image
+        void updatePixels(const SimulationThread::Snapshot& snapshot); // Updates all of the pixels from a snapshot
+        void recordFrame(); // Adds the current generation to the recording, if there is one
+        bool isThreaded() const; // Returns true if the simulation thread is being used for playing
+        sf::Color blendColors(float value) const; // Returns the color of a continuous value from 0 to 1
         bool inBounds(const sf::Vector2i& pos) const; // Returns if the coordinates are in bounds of the board
-        void toggle(unsigned& val) const; // Toggles an unsigned int like a bool
         void updateBorderSize(); // Updates the size of the border
         sf::Rect<unsigned> fixRectangle(const sf::IntRect& rect) const; // Takes any rectangle and returns one within bounds of the board
         void updateMaxState();
+        void beginEdit(); // Starts recording an edit for the undo history, until finishEdit is called
+        void touchCells(const sf::Rect<unsigned>& rect); // Call before changing cells during an edit
+        void finishEdit();
+        void recordGeneration(); // Adds the current generation to the rewind history
+        void checkCycle(); // Looks for a cycle that ends at the current generation
+        void reportCycle(); // Prints the cycle that was found on the simulation thread, and pauses if set to
+        void logStatistics(); // Adds the current generation to the statistics log, if there is one
         void updateGrid();
 
-        // The rule set
-        RuleSet rules;
-
         // Logical board
-        Matrix<char> board[2]; // Holds the logical states of the cells
-        unsigned readBoard; // Which layer should be read from
-        unsigned writeBoard; // Which layer should be written to
-        // Needs to switch between layers to properly simulate everything
-        // Note that both of these variables are the same when a simulation is not in progress
+        Automaton automaton; // Holds and simulates the states of the cells
+        mutable SimulationThread simulation; // Must be locked before using the automaton, mutable so const functions can lock it
         bool playing;
 
         // Graphical board
@@ -118,6 +178,7 @@ class Board: public sf::Drawable
         bool borderState;
         std::vector<ColorCode> cellColors; // The colors used for the cells
         bool needToUpdateTexture;
+        Counters counters;
 
         // Visual grid around cells
         sf::VertexArray grid;
@@ -126,15 +187,45 @@ class Board: public sf::Drawable
 
         // Simulation speed limiter
         sf::Clock simTimer;
-        float maxSpeed;
+        float maxSpeed; // Generations per second
         float maxTime;
         static const float unlimitedSpeed;
+        sf::Clock frameTimer; // Time since the last frame that was simulated
+        float pendingGenerations; // Generations that are due, including fractions left over from earlier frames
+        sf::Time frameBudget;
+        static const float maxCatchUpTime; // Longer times between frames are treated as a pause
 
         // Screenshots
         FilenameGenerator filenameGen;
+        mutable ScreenshotWriter screenshotWriter;
         bool autosaveImages;
         bool autosavePartialImages;
 
+        // Recording
+        Recorder recorder;
+        FilenameGenerator recordingFilenameGen;
+        unsigned recordingFps;
+        Matrix<std::uint8_t> recordingFrame; // Palette indexes of the last recorded generation
+
+        // Checkpoints
+        Checkpointer checkpointer;
+
+        // Undo history, which is only used while the simulation is locked (edits are sent to the thread as commands too)
+        EditHistory history;
+        bool editing; // True while an edit is being recorded
+
+        // Rewind history, which is changed on the simulation thread after each generation
+        RewindHistory rewindHistory;
+        bool cellsEdited; // True when the cells were changed since they were last recorded
+
+        // Cycle detection, which is also updated on the simulation thread
+        CycleDetector cycleDetector;
+        std::atomic<bool> cycleFound;
+        bool pauseOnCycle;
+
+        // Statistics log, which is also written on the simulation thread
+        StatsLog statsLog;
+
         // Other variables
         sf::Vector2i lastLinePos;
         bool paintingLine;
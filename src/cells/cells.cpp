@@ -3,6 +3,8 @@
 
 #include "cells.h"
 #include <functional>
+#include <iostream>
+#include "trace.h"
 
 const char* Cells::title = "Cells v0.5.0 Beta";
 
@@ -17,8 +19,9 @@ const cfg::File::ConfigMap Cells::defaultOptions = {
     {"Board", {
         {"width", cfg::makeOption(800, 3)},
         {"height", cfg::makeOption(600, 3)},
-        {"rules", cfg::makeOption(Board::defaultRuleString)},
+        {"rules", cfg::makeOption(Automaton::defaultRuleString)},
         {"autosave", cfg::makeOption(true)},
+        {"undoMemory", cfg::makeOption(256, 0)},
         {"lastFilename", cfg::makeOption("")},
         {"lastPresetColor", cfg::makeOption("")}
         }
@@ -35,7 +38,11 @@ const cfg::File::ConfigMap Cells::defaultOptions = {
         }
     },
     {"Simulation", {
-        {"speed", cfg::makeOption(60, 0, 60)}
+        {"speed", cfg::makeOption(0, 0)},
+        {"frameBudget", cfg::makeOption(10.0f, 0.0f)},
+        {"rowsPerStep", cfg::makeOption(1, 1)},
+        {"seed", cfg::makeOption(0, 0)},
+        {"thread", cfg::makeOption(true)}
         }
     },
     {"Tool", {
@@ -47,7 +54,44 @@ const cfg::File::ConfigMap Cells::defaultOptions = {
     {"Screenshots", {
         {"filename", cfg::makeOption("screenshots/screenshot %n.png")},
         {"autosave", cfg::makeOption(false)},
-        {"autosavePartial", cfg::makeOption(false)}
+        {"autosavePartial", cfg::makeOption(false)},
+        {"queueSize", cfg::makeOption(8, 1)},
+        {"workers", cfg::makeOption(0, 0)},
+        {"dropWhenFull", cfg::makeOption(false)}
+        }
+    },
+    {"Recording", {
+        {"filename", cfg::makeOption("screenshots/recording %n.gif")},
+        {"fps", cfg::makeOption(30, 1)}
+        }
+    },
+    {"Checkpoints", {
+        {"filename", cfg::makeOption("checkpoint")},
+        {"generations", cfg::makeOption(0, 0)},
+        {"seconds", cfg::makeOption(300.0f, 0.0f)}
+        }
+    },
+    {"Rewind", {
+        {"memory", cfg::makeOption(0, 0)},
+        {"keyframeInterval", cfg::makeOption(64, 1)},
+        {"jump", cfg::makeOption(100, 1)}
+        }
+    },
+    {"Cycles", {
+        {"maxPeriod", cfg::makeOption(0, 0)},
+        {"pause", cfg::makeOption(false)}
+        }
+    },
+    {"Census", {
+        {"maxPeriod", cfg::makeOption(64, 1)}
+        }
+    },
+    {"Stats", {
+        {"filename", cfg::makeOption("")}
+        }
+    },
+    {"Debug", {
+        {"traceFilename", cfg::makeOption("")}
         }
     },
     {"", {
@@ -61,6 +105,9 @@ Cells::Cells():
     gui(board, config, tool, [&](bool state){ showGrid = state; updateShowGrid(); })
 {
     config.loadFromFile("cells.cfg");
+
+    // Start tracing first, so loading everything shows up in the trace
+    startTrace();
     // Set board settings from config file
     config.useSection("Board");
     // Setup some default colors if none exist
@@ -73,6 +120,7 @@ Cells::Cells():
     // Set the colors and rules
     board.setColors(colorOpt);
     board.setRules(config("rules"));
+    board.setUndoMemory(config("undoMemory").toInt());
     currentPresetRule = 0;
 
     // Set grid options
@@ -93,6 +141,26 @@ Cells::Cells():
     // Set screenshot options
     config.useSection("Screenshots");
     board.setupScreenshots(config("filename"), config("autosave").toBool(), config("autosavePartial").toBool());
+    board.setupScreenshotQueue(config("queueSize").toInt(), config("workers").toInt(), config("dropWhenFull").toBool());
+    config.useSection("Recording");
+    board.setupRecording(config("filename"), config("fps").toInt());
+    config.useSection("Checkpoints");
+    board.setupCheckpoints(config("filename"), config("generations").toInt(), config("seconds").toFloat());
+    config.useSection("Rewind");
+    board.setRewindMemory(config("memory").toInt(), config("keyframeInterval").toInt());
+    rewindJump = config("jump").toInt();
+    config.useSection("Cycles");
+    board.setupCycleDetection(config("maxPeriod").toInt(), config("pause").toBool());
+    config.useSection("Stats");
+    board.setupStatsLog(config("filename"));
+    config.useSection("Census");
+    censusPeriod = config("maxPeriod").toInt();
+
+    // Set simulation options
+    config.useSection("Simulation");
+    board.setRowsPerStep(config("rowsPerStep").toInt());
+    board.setFrameBudget(config("frameBudget").toFloat());
+    board.setSeed(config("seed").toInt());
 
     // Load the last board or make a new one of the configured size
     bool status = false;
@@ -112,6 +180,9 @@ Cells::Cells():
     gui.loadSettings();
     gui.setVisible();
 
+    // Start simulating on another thread once everything is loaded
+    board.setThreaded(config("thread", "Simulation").toBool());
+
     createWindow();
 }
 
@@ -159,7 +230,10 @@ void Cells::start()
     sf::Clock clock;
     while (running && window.isOpen())
     {
-        elapsedTime = clock.restart().asSeconds();
+        sf::Time frameTime = clock.restart();
+        elapsedTime = frameTime.asSeconds();
+        perfHud.endFrame(frameTime);
+        TRACE_SCOPE("Frame");
         handleEvents();
         update();
         draw();
@@ -168,6 +242,7 @@ void Cells::start()
 
 void Cells::handleEvents()
 {
+    TRACE_SCOPE("Cells::handleEvents");
     sf::Event event;
     while (window.pollEvent(event))
     {
@@ -194,6 +269,8 @@ void Cells::handleEvents()
                 {
                     if (event.key.code == sf::Keyboard::Escape)
                         gui.toggle();
+                    else if (event.key.code == sf::Keyboard::F3)
+                        perfHud.toggle();
                     else if (event.key.code == sf::Keyboard::F4 && event.key.alt)
                         running = false;
                 }
@@ -256,19 +333,31 @@ void Cells::handleOtherEvent(const sf::Event& event)
 
 void Cells::update()
 {
+    TRACE_SCOPE("Cells::update");
+    bool wasPlaying = board.isPlaying();
     board.update();
+    if (board.isPlaying() != wasPlaying)
+        gui.updatePlayButton(); // Finding a cycle can pause the board
     board.updateTexture();
     if (gui.isVisible())
-        gui.update();
-    /*if (fpsTimer.getElapsedTime().asMilliseconds() >= 500)
     {
-        window.setTitle(strlib::toString(1 / elapsedTime));
-        fpsTimer.restart();
-    }*/
+        sf::Clock guiTimer;
+        gui.update();
+        perfHud.addTime(PerfHud::Gui, guiTimer.getElapsedTime());
+    }
+
+    // Simulations can also happen while handling input, so the counters are taken once per frame
+    auto counters = board.takeCounters();
+    perfHud.addTime(PerfHud::Simulate, counters.simulate);
+    perfHud.addTime(PerfHud::Colorize, counters.colorize);
+    perfHud.addTime(PerfHud::Upload, counters.upload);
+    perfHud.addGenerations(counters.generations, counters.cells);
 }
 
 void Cells::draw()
 {
+    TRACE_SCOPE("Cells::draw");
+    sf::Clock drawTimer;
     window.clear(board.getFirstColor());
 
     window.setView(boardView);
@@ -279,9 +368,32 @@ void Cells::draw()
     window.setView(uiView);
     window.draw(gui);
 
+    // The overlay goes in the bottom left corner of the window
+    if (perfHud.isVisible())
+    {
+        window.setView(sf::View(sf::FloatRect(0, 0, windowSize.x, windowSize.y)));
+        perfHud.setPosition(sf::Vector2f(4, windowSize.y - perfHud.getSize().y - 4));
+        window.draw(perfHud);
+    }
+    perfHud.addTime(PerfHud::Draw, drawTimer.getElapsedTime());
+
     window.display();
 }
 
+void Cells::startTrace()
+{
+    const std::string filename = config("traceFilename", "Debug").toString();
+    if (!filename.empty())
+    {
+#ifdef CELLS_TRACE
+        if (!Trace::start(filename))
+            std::cerr << "Error: Could not write the trace to \"" << filename << "\".\n";
+#else
+        std::cerr << "Warning: traceFilename is set, but Cells was built without CELLS_TRACE.\n";
+#endif
+    }
+}
+
 void Cells::createWindow()
 {
     // Read settings from config file
@@ -329,6 +441,18 @@ void Cells::handleKeyPressed(const sf::Event::KeyEvent& key)
             board.simulate(); // Run a simulation
             break;
 
+        case sf::Keyboard::BackSpace:
+            board.stepBack(); // Rewind a generation (or run one backwards for reversible rules)
+            break;
+
+        case sf::Keyboard::PageUp:
+            board.rewind(rewindJump);
+            break;
+
+        case sf::Keyboard::PageDown:
+            board.fastForward(rewindJump);
+            break;
+
         case sf::Keyboard::Num1:
             tool.setTool(Tool::Paint);
             gui.updateToolButtons();
@@ -381,7 +505,25 @@ void Cells::handleKeyPressed(const sf::Event::KeyEvent& key)
             break;
 
         case sf::Keyboard::Y:
-            board.saveToImageFile(); // Save a screenshot
+            if (key.control)
+                board.redo();
+            else
+                board.saveToImageFile(); // Save a screenshot
+            break;
+
+        case sf::Keyboard::Z:
+            if (key.control && key.shift)
+                board.redo();
+            else if (key.control)
+                board.undo();
+            break;
+
+        case sf::Keyboard::V:
+            board.toggleRecording();
+            break;
+
+        case sf::Keyboard::K:
+            board.printCensus(censusPeriod);
             break;
 
         case sf::Keyboard::Q:
@@ -509,7 +651,7 @@ void Cells::handleInput()
         if (!tool.changingSelection && tool.getTool() >= Tool::NormalSimulator && sf::Mouse::isButtonPressed(sf::Mouse::Left))
             board.simulate(tool.cursor.getRect(), (tool.getTool() == Tool::ToroidalSimulator));
         else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Space))
-            board.simulate();
+            board.simulateFrame();
 
         // Zooming
         if (sf::Keyboard::isKeyPressed(sf::Keyboard::Add))
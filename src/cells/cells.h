@@ -10,6 +10,7 @@
 #include "board.h"
 #include "tool.h"
 #include "settingsgui.h"
+#include "perfhud.h"
 
 /*
 This class handles the window, input, and output.
@@ -27,6 +28,7 @@ class Cells
         void update();
         void draw();
 
+        void startTrace(); // Starts writing a trace file if one is set in the config file
         void createWindow();
         void handleKeyPressed(const sf::Event::KeyEvent& key);
         void handleMouseButtonPressed(const sf::Event::MouseButtonEvent& mouseButton);
@@ -50,13 +52,13 @@ class Cells
         bool mouseMoved;
         bool mouseClicked;
         float elapsedTime; // Elapsed time between frames
-        //sf::Clock fpsTimer;
 
         // Main objects
         sf::RenderWindow window; // The main window
         cfg::File config; // The main configuration file
         Board board; // The cellular automata board
         SettingsGUI gui; // The interface for the settings
+        PerfHud perfHud; // Overlay with the simulation speed and frame times
 
         // Views
         sf::View boardView; // View for the board
@@ -79,6 +81,8 @@ class Cells
 
         // Other
         int currentPresetRule;
+        unsigned rewindJump; // Generations to rewind or fast forward with page up and page down
+        unsigned censusPeriod; // Longest period of the objects that the census looks for
 
         // Constants
         static const char* title;
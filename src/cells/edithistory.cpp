@@ -0,0 +1,255 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "edithistory.h"
+#include <algorithm>
+#include <iostream>
+#include "deltacoder.h"
+#include "trace.h"
+
+const unsigned EditHistory::tileSize = 64;
+
+EditHistory::EditHistory():
+    memoryLimit(256 * 1024 * 1024),
+    memoryUsed(0),
+    editing(false),
+    tooBig(false),
+    startWidth(0),
+    startHeight(0),
+    originalSize(0)
+{
+}
+
+void EditHistory::setMemoryLimit(std::size_t bytes)
+{
+    memoryLimit = bytes;
+    trimToLimit();
+}
+
+void EditHistory::begin()
+{
+    if (!editing)
+    {
+        editing = true;
+        tooBig = false;
+        startWidth = 0;
+        startHeight = 0;
+    }
+}
+
+void EditHistory::touch(const Matrix<char>& cells, const sf::Rect<unsigned>& rect)
+{
+    if (!editing || tooBig || memoryLimit == 0 || rect.width == 0 || rect.height == 0)
+        return;
+    if (originalTiles.empty())
+    {
+        startWidth = cells.width();
+        startHeight = cells.height();
+    }
+    else if (cells.width() != startWidth || cells.height() != startHeight)
+        return;
+
+    // Keep a copy of each tile the first time it is touched
+    unsigned tilesX = (cells.width() + tileSize - 1) / tileSize;
+    unsigned lastX = std::min(rect.left + rect.width, cells.width());
+    unsigned lastY = std::min(rect.top + rect.height, cells.height());
+    std::vector<char> tile;
+    for (unsigned y = rect.top / tileSize; y * tileSize < lastY; ++y)
+    {
+        for (unsigned x = rect.left / tileSize; x * tileSize < lastX; ++x)
+        {
+            unsigned index = y * tilesX + x;
+            if (originalTiles.count(index) == 0)
+            {
+                readTile(cells, getTileRect(index, cells.width(), cells.height()), tile);
+                auto& original = originalTiles[index];
+                DeltaCoder::encode(tile.data(), tile.size(), original);
+                original.shrink_to_fit();
+                originalSize += original.size();
+                memoryUsed += original.size();
+            }
+        }
+
+        // Give up on this edit if it doesn't fit by itself, otherwise make room by forgetting older edits
+        if (originalSize > memoryLimit)
+        {
+            std::cerr << "Warning: The edit is too big to undo (see \"undoMemory\" in the [Board] section).\n";
+            tooBig = true;
+            memoryUsed -= originalSize;
+            originalSize = 0;
+            originalTiles.clear();
+            return;
+        }
+        trimToLimit();
+    }
+}
+
+void EditHistory::end(const Matrix<char>& cells)
+{
+    if (!editing)
+        return;
+    editing = false;
+    memoryUsed -= originalSize;
+    originalSize = 0;
+    if (tooBig || originalTiles.empty() || cells.width() != startWidth || cells.height() != startHeight)
+    {
+        originalTiles.clear();
+        return;
+    }
+
+    TRACE_SCOPE("EditHistory::end");
+    Step step;
+    step.width = cells.width();
+    step.height = cells.height();
+    step.size = sizeof(Step);
+    std::vector<char> original;
+    std::vector<char> current;
+    bool first = true;
+    for (auto& entry: originalTiles)
+    {
+        auto rect = getTileRect(entry.first, cells.width(), cells.height());
+        DeltaCoder::decode(entry.second, original);
+        readTile(cells, rect, current);
+        bool same = true;
+        for (std::size_t i = 0; i < current.size(); ++i)
+        {
+            original[i] ^= current[i];
+            if (original[i] == 0)
+                current[i] = 0;
+            else
+                same = false;
+        }
+        if (same)
+            continue;
+        step.tiles.push_back(TileDelta{entry.first, std::vector<char>(), std::vector<char>()});
+        TileDelta& tile = step.tiles.back();
+        DeltaCoder::encode(original.data(), original.size(), tile.delta);
+        DeltaCoder::encode(current.data(), current.size(), tile.newStates);
+        tile.delta.shrink_to_fit();
+        tile.newStates.shrink_to_fit();
+        step.size += sizeof(TileDelta) + tile.delta.size() + tile.newStates.size();
+
+        // Keep track of the area that changed, so only that part needs to be redrawn
+        if (first)
+            step.bounds = rect;
+        else
+        {
+            unsigned right = std::max(step.bounds.left + step.bounds.width, rect.left + rect.width);
+            unsigned bottom = std::max(step.bounds.top + step.bounds.height, rect.top + rect.height);
+            step.bounds.left = std::min(step.bounds.left, rect.left);
+            step.bounds.top = std::min(step.bounds.top, rect.top);
+            step.bounds.width = right - step.bounds.left;
+            step.bounds.height = bottom - step.bounds.top;
+        }
+        first = false;
+    }
+    originalTiles.clear();
+    if (step.tiles.empty())
+        return;
+
+    // A new edit replaces anything that was undone
+    for (const auto& redoStep: redoSteps)
+        memoryUsed -= redoStep.size;
+    redoSteps.clear();
+    memoryUsed += step.size;
+    undoSteps.push_back(std::move(step));
+    trimToLimit();
+}
+
+bool EditHistory::undo(const Matrix<char>& cells, const SetCell& setCell, sf::Rect<unsigned>& changed)
+{
+    if (undoSteps.empty() || !apply(undoSteps.back(), true, cells, setCell, changed))
+        return false;
+    redoSteps.push_back(std::move(undoSteps.back()));
+    undoSteps.pop_back();
+    return true;
+}
+
+bool EditHistory::redo(const Matrix<char>& cells, const SetCell& setCell, sf::Rect<unsigned>& changed)
+{
+    if (redoSteps.empty() || !apply(redoSteps.back(), false, cells, setCell, changed))
+        return false;
+    undoSteps.push_back(std::move(redoSteps.back()));
+    redoSteps.pop_back();
+    return true;
+}
+
+void EditHistory::clear()
+{
+    undoSteps.clear();
+    redoSteps.clear();
+    memoryUsed = 0;
+    editing = false;
+    originalTiles.clear();
+    originalSize = 0;
+}
+
+std::size_t EditHistory::getMemoryUsed() const
+{
+    return memoryUsed;
+}
+
+bool EditHistory::apply(const Step& step, bool undoing, const Matrix<char>& cells, const SetCell& setCell, sf::Rect<unsigned>& changed)
+{
+    // The tiles don't line up with a board of another size
+    if (step.width != cells.width() || step.height != cells.height())
+    {
+        clear();
+        return false;
+    }
+
+    TRACE_SCOPE("EditHistory::apply");
+    std::vector<char> delta;
+    std::vector<char> newStates;
+    for (const auto& tile: step.tiles)
+    {
+        auto rect = getTileRect(tile.index, cells.width(), cells.height());
+        DeltaCoder::decode(tile.delta, delta);
+        DeltaCoder::decode(tile.newStates, newStates);
+        std::size_t i = 0;
+        for (unsigned y = rect.top; y < rect.top + rect.height; ++y)
+        {
+            for (unsigned x = rect.left; x < rect.left + rect.width; ++x, ++i)
+            {
+                // Only the cells the edit changed are set, whatever the simulation did with them since
+                if (delta[i] != 0)
+                    setCell(sf::Vector2u(x, y), (undoing ? newStates[i] ^ delta[i] : newStates[i]));
+            }
+        }
+    }
+    changed = step.bounds;
+    return true;
+}
+
+sf::Rect<unsigned> EditHistory::getTileRect(unsigned index, unsigned width, unsigned height) const
+{
+    unsigned tilesX = (width + tileSize - 1) / tileSize;
+    unsigned left = (index % tilesX) * tileSize;
+    unsigned top = (index / tilesX) * tileSize;
+    return sf::Rect<unsigned>(left, top, std::min(tileSize, width - left), std::min(tileSize, height - top));
+}
+
+void EditHistory::readTile(const Matrix<char>& cells, const sf::Rect<unsigned>& rect, std::vector<char>& tile) const
+{
+    tile.resize(rect.width * rect.height);
+    for (unsigned y = 0; y < rect.height; ++y)
+    {
+        const char* row = &cells(rect.left, rect.top + y);
+        std::copy(row, row + rect.width, tile.begin() + y * rect.width);
+    }
+}
+
+void EditHistory::trimToLimit()
+{
+    // Forget the oldest edits first
+    while (memoryUsed > memoryLimit && !undoSteps.empty())
+    {
+        memoryUsed -= undoSteps.front().size;
+        undoSteps.pop_front();
+    }
+    while (memoryUsed > memoryLimit && !redoSteps.empty())
+    {
+        memoryUsed -= redoSteps.front().size;
+        redoSteps.erase(redoSteps.begin());
+    }
+}
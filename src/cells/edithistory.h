@@ -0,0 +1,78 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef EDITHISTORY_H
+#define EDITHISTORY_H
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <cstddef>
+#include <SFML/Graphics/Rect.hpp>
+#include "matrix.h"
+
+/*
+This class keeps the undo and redo history of edits to the board (painting, pasting, clearing, etc.).
+The board is split into tiles, and the first time an edit touches a tile, a compressed copy of the tile is kept.
+When the edit is finished, each touched tile is stored as the XOR of its old and new cells, and the new states of the cells that changed,
+    compressed so runs of unchanged cells take almost nothing. Only the touched tiles ever need to be copied.
+Undoing sets the cells the edit changed back to their old states, and redoing sets them to the new ones,
+    so edits can still be undone after the simulation has moved on (only the edited cells are put back).
+The board shouldn't be simulated while an edit is in progress (the Board class holds the simulation thread until it's finished).
+The oldest edits are forgotten when the history goes over its memory limit, which includes the copies kept during an edit.
+*/
+class EditHistory
+{
+    public:
+        using SetCell = std::function<void(const sf::Vector2u&, char)>;
+
+        EditHistory();
+        void setMemoryLimit(std::size_t bytes);
+        void begin(); // Starts a new edit, unless one was already started
+        void touch(const Matrix<char>& cells, const sf::Rect<unsigned>& rect); // Call before changing the cells in the rectangle
+        void end(const Matrix<char>& cells); // Stores what changed since the edit started (it is dropped if it went over the memory limit)
+        bool undo(const Matrix<char>& cells, const SetCell& setCell, sf::Rect<unsigned>& changed); // Returns false if there is nothing to undo
+        bool redo(const Matrix<char>& cells, const SetCell& setCell, sf::Rect<unsigned>& changed);
+        void clear(); // Forgets everything (like after loading a board)
+        std::size_t getMemoryUsed() const;
+
+    private:
+        static const unsigned tileSize;
+
+        struct TileDelta
+        {
+            unsigned index; // Row by row
+            std::vector<char> delta; // Compressed XOR of the old and new cells
+            std::vector<char> newStates; // Compressed new states of the cells that changed (0 everywhere else)
+        };
+
+        struct Step
+        {
+            std::vector<TileDelta> tiles;
+            unsigned width;
+            unsigned height;
+            sf::Rect<unsigned> bounds; // The tiles that changed
+            std::size_t size; // Bytes used
+        };
+
+        bool apply(const Step& step, bool undoing, const Matrix<char>& cells, const SetCell& setCell, sf::Rect<unsigned>& changed); // Returns false if the step doesn't fit the board
+        sf::Rect<unsigned> getTileRect(unsigned index, unsigned width, unsigned height) const;
+        void readTile(const Matrix<char>& cells, const sf::Rect<unsigned>& rect, std::vector<char>& tile) const;
+        void trimToLimit();
+
+        std::size_t memoryLimit;
+        std::size_t memoryUsed;
+        std::deque<Step> undoSteps;
+        std::vector<Step> redoSteps;
+
+        // The edit in progress
+        bool editing;
+        bool tooBig; // True if the edit went over the memory limit, so it won't be kept
+        unsigned startWidth;
+        unsigned startHeight;
+        std::unordered_map<unsigned, std::vector<char>> originalTiles; // Compressed cells from before the edit, by tile index (see the DeltaCoder class)
+        std::size_t originalSize; // Bytes used by the original tiles, which are counted in memoryUsed
+};
+
+#endif
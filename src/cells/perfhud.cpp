@@ -0,0 +1,173 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "perfhud.h"
+#include <algorithm>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+
+const float PerfHud::historySeconds = 5.0f;
+const float PerfHud::refreshSeconds = 0.5f;
+const unsigned PerfHud::fontSize = 14;
+const char* PerfHud::phaseNames[] = {"Simulate", "Colorize", "Upload", "GUI", "Draw", "Frame"};
+
+namespace
+{
+    // Formats large numbers like 1.23 M
+    std::string formatRate(double rate)
+    {
+        const char* suffixes[] = {"", " K", " M", " G", " T"};
+        unsigned suffix = 0;
+        while (rate >= 1000.0 && suffix < 4)
+        {
+            rate /= 1000.0;
+            ++suffix;
+        }
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(suffix > 0 ? 2 : 0) << rate << suffixes[suffix];
+        return out.str();
+    }
+}
+
+PerfHud::PerfHud():
+    visible(false),
+    current()
+{
+    font.loadFromFile("data/fonts/Ubuntu-B.ttf");
+    background.setFillColor(sf::Color(0, 0, 0, 160));
+    background.setOutlineColor(sf::Color(64, 64, 64));
+    background.setOutlineThickness(1);
+    rateText.setFont(font);
+    rateText.setCharacterSize(fontSize);
+    for (auto& text: columnText)
+    {
+        text.setFont(font);
+        text.setCharacterSize(fontSize);
+    }
+    setPosition(sf::Vector2f(0, 0));
+}
+
+void PerfHud::toggle()
+{
+    visible = !visible;
+    if (visible)
+    {
+        // Don't show old frames from the last time it was visible
+        samples.clear();
+        current = Sample();
+        updateText();
+    }
+}
+
+bool PerfHud::isVisible() const
+{
+    return visible;
+}
+
+void PerfHud::addTime(Phase phase, sf::Time time)
+{
+    current.times[phase] += time.asSeconds() * 1000.0f;
+}
+
+void PerfHud::addGenerations(std::uint64_t generations, double cells)
+{
+    current.generations += generations;
+    current.cells += cells;
+}
+
+void PerfHud::endFrame(sf::Time frameTime)
+{
+    if (visible)
+    {
+        // Keep the frame, and remove the ones that are too old
+        current.timestamp = clock.getElapsedTime().asSeconds();
+        current.times[Frame] = frameTime.asSeconds() * 1000.0f;
+        samples.push_back(current);
+        while (!samples.empty() && samples.front().timestamp < current.timestamp - historySeconds)
+            samples.pop_front();
+        if (refreshTimer.getElapsedTime().asSeconds() >= refreshSeconds)
+        {
+            updateText();
+            refreshTimer.restart();
+        }
+    }
+    current = Sample();
+}
+
+void PerfHud::setPosition(const sf::Vector2f& pos)
+{
+    background.setPosition(pos);
+    rateText.setPosition(pos.x + 6, pos.y + 4);
+    float rowHeight = font.getLineSpacing(fontSize);
+    float columnWidths[columns] = {80, 60, 60, 60};
+    float x = pos.x + 6;
+    for (unsigned i = 0; i < columns; ++i)
+    {
+        columnText[i].setPosition(x, pos.y + 4 + rowHeight * 2);
+        x += columnWidths[i];
+    }
+    background.setSize(sf::Vector2f(x - pos.x, rowHeight * (TotalPhases + 3) + 8));
+}
+
+sf::Vector2f PerfHud::getSize() const
+{
+    return background.getSize();
+}
+
+void PerfHud::draw(sf::RenderTarget& window, sf::RenderStates states) const
+{
+    if (visible)
+    {
+        window.draw(background, states);
+        window.draw(rateText, states);
+        for (const auto& text: columnText)
+            window.draw(text, states);
+    }
+}
+
+void PerfHud::updateText()
+{
+    // The rates are averaged over the whole history
+    std::uint64_t generations = 0;
+    double cells = 0.0;
+    for (const auto& sample: samples)
+    {
+        generations += sample.generations;
+        cells += sample.cells;
+    }
+    float seconds = (samples.size() >= 2 ? samples.back().timestamp - samples.front().timestamp : 0.0f);
+    if (seconds > 0.0f)
+        rateText.setString("Generations/s: " + formatRate(generations / seconds) + "\nCells/s: " + formatRate(cells / seconds));
+    else
+        rateText.setString("Generations/s: -\nCells/s: -");
+
+    // Each phase gets a row of percentiles in milliseconds
+    std::ostringstream columnStreams[columns];
+    columnStreams[0] << "ms\n";
+    columnStreams[1] << "p50\n";
+    columnStreams[2] << "p95\n";
+    columnStreams[3] << "p99\n";
+    const float percentiles[] = {0.5f, 0.95f, 0.99f};
+    for (unsigned phase = 0; phase < TotalPhases; ++phase)
+    {
+        columnStreams[0] << phaseNames[phase] << "\n";
+        for (unsigned i = 0; i < 3; ++i)
+            columnStreams[i + 1] << std::fixed << std::setprecision(2) << getPercentile(static_cast<Phase>(phase), percentiles[i]) << "\n";
+    }
+    for (unsigned i = 0; i < columns; ++i)
+        columnText[i].setString(columnStreams[i].str());
+}
+
+float PerfHud::getPercentile(Phase phase, float percentile) const
+{
+    if (samples.empty())
+        return 0.0f;
+    std::vector<float> times;
+    times.reserve(samples.size());
+    for (const auto& sample: samples)
+        times.push_back(sample.times[phase]);
+    auto nth = times.begin() + static_cast<std::size_t>(percentile * (times.size() - 1) + 0.5f);
+    std::nth_element(times.begin(), nth, times.end());
+    return *nth;
+}
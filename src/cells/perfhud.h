@@ -0,0 +1,73 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef PERFHUD_H
+#define PERFHUD_H
+
+#include <deque>
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+
+/*
+This class is an overlay that shows how fast the board is being simulated, and where the time of each frame goes.
+Times are added to the current frame for each phase, and each frame is kept for the last few seconds,
+    so the rates and percentiles are rolling instead of only showing the last frame.
+The text is only refreshed a few times per second, so it is readable while running.
+*/
+class PerfHud: public sf::Drawable
+{
+    public:
+        // The parts of a frame that are timed
+        enum Phase
+        {
+            Simulate = 0, // Running the rules
+            Colorize, // Updating the pixels of the image from the cells
+            Upload, // Copying the image to the texture
+            Gui, // Updating the settings GUI
+            Draw, // Drawing everything (not including waiting for vsync)
+            Frame, // The entire frame
+            TotalPhases
+        };
+
+        PerfHud();
+        void toggle();
+        bool isVisible() const;
+        void addTime(Phase phase, sf::Time time); // Adds time to a phase of the current frame
+        void addGenerations(std::uint64_t generations, double cells); // Adds simulated generations and cells to the current frame
+        void endFrame(sf::Time frameTime); // Stores the current frame, and starts a new one
+        void setPosition(const sf::Vector2f& pos);
+        sf::Vector2f getSize() const;
+        void draw(sf::RenderTarget& window, sf::RenderStates states) const;
+
+    private:
+        struct Sample
+        {
+            float timestamp; // Seconds since the overlay was created
+            float times[TotalPhases]; // In milliseconds
+            std::uint64_t generations;
+            double cells;
+        };
+
+        void updateText();
+        float getPercentile(Phase phase, float percentile) const;
+
+        bool visible;
+        sf::Clock clock; // Used for timestamps
+        sf::Clock refreshTimer;
+        Sample current;
+        std::deque<Sample> samples; // The frames from the last few seconds, oldest first
+
+        // Graphics
+        sf::Font font;
+        sf::RectangleShape background;
+        sf::Text rateText;
+        static const unsigned columns = 4;
+        sf::Text columnText[columns]; // Phase names, then the percentiles
+
+        static const float historySeconds;
+        static const float refreshSeconds;
+        static const unsigned fontSize;
+        static const char* phaseNames[TotalPhases];
+};
+
+#endif
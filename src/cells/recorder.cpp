@@ -0,0 +1,342 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "recorder.h"
+#include <algorithm>
+#include <iostream>
+#include "trace.h"
+
+namespace
+{
+    // Packs variable sized codes into GIF's sub-blocks of up to 255 bytes, least significant bit first
+    class GIFCodeWriter
+    {
+        public:
+            GIFCodeWriter(std::ofstream& file):
+                file(file),
+                bits(0),
+                bitCount(0),
+                blockSize(0)
+            {
+            }
+
+            void write(unsigned code, unsigned size)
+            {
+                bits |= code << bitCount;
+                bitCount += size;
+                while (bitCount >= 8)
+                {
+                    writeByte(bits & 0xFF);
+                    bits >>= 8;
+                    bitCount -= 8;
+                }
+            }
+
+            void finish()
+            {
+                if (bitCount > 0)
+                    writeByte(bits & 0xFF);
+                flushBlock();
+                file.put(0); // Block terminator
+            }
+
+        private:
+            void writeByte(unsigned value)
+            {
+                block[blockSize++] = static_cast<char>(value);
+                if (blockSize == 255)
+                    flushBlock();
+            }
+
+            void flushBlock()
+            {
+                if (blockSize > 0)
+                {
+                    file.put(static_cast<char>(blockSize));
+                    file.write(block, blockSize);
+                    blockSize = 0;
+                }
+            }
+
+            std::ofstream& file;
+            unsigned bits;
+            unsigned bitCount;
+            char block[255];
+            unsigned blockSize;
+    };
+}
+
+Recorder::Recorder():
+    format(Format::Y4M),
+    width(0),
+    height(0),
+    fps(30),
+    colorBits(1),
+    frameCount(0)
+{
+}
+
+Recorder::~Recorder()
+{
+    stop();
+}
+
+bool Recorder::start(const std::string& filename, unsigned newWidth, unsigned newHeight, const std::vector<sf::Color>& newPalette, unsigned newFps)
+{
+    stop();
+    std::string extension = filename.substr(std::min(filename.rfind('.'), filename.size()));
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == ".y4m")
+        format = Format::Y4M;
+    else if (extension == ".gif")
+        format = Format::GIF;
+    else
+    {
+        std::cerr << "Error: Unknown recording format \"" << extension << "\" (use .y4m or .gif)\n";
+        return false;
+    }
+    if (newWidth == 0 || newHeight == 0 || newPalette.empty() || (format == Format::GIF && (newWidth > 65535 || newHeight > 65535)))
+    {
+        std::cerr << "Error: Can't record a " << newWidth << "x" << newHeight << " board to \"" << filename << "\"\n";
+        return false;
+    }
+    file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Couldn't open \"" << filename << "\" for recording\n";
+        return false;
+    }
+
+    width = newWidth;
+    height = newHeight;
+    fps = std::max(newFps, 1u);
+    palette = newPalette;
+    frameCount = 0;
+    if (format == Format::Y4M)
+        writeY4MHeader();
+    else
+        writeGIFHeader();
+    return true;
+}
+
+bool Recorder::addFrame(const Matrix<std::uint8_t>& frame)
+{
+    TRACE_SCOPE("Recorder::addFrame");
+    if (!file.is_open() || frame.width() != width || frame.height() != height)
+        return false;
+    if (format == Format::Y4M)
+        writeY4MFrame(frame);
+    else
+        writeGIFFrame(frame);
+    ++frameCount;
+    return true;
+}
+
+void Recorder::stop()
+{
+    if (file.is_open())
+    {
+        if (format == Format::GIF)
+            file.put(0x3B); // Trailer
+        file.close();
+    }
+    lastFrame.clear();
+    planes.clear();
+    planes.shrink_to_fit();
+    yuvPalette.clear();
+}
+
+bool Recorder::isRecording() const
+{
+    return file.is_open();
+}
+
+unsigned Recorder::getFrameCount() const
+{
+    return frameCount;
+}
+
+void Recorder::writeY4MHeader()
+{
+    file << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C444\n";
+    planes.resize(width * height * 3);
+
+    // Convert the palette to studio range BT.601 once, then each pixel is just a lookup
+    yuvPalette.resize(256 * 3);
+    for (unsigned i = 0; i < 256; ++i)
+    {
+        const sf::Color& color = palette[std::min<unsigned>(i, palette.size() - 1)];
+        yuvPalette[i * 3] = static_cast<std::uint8_t>(16 + (65.738f * color.r + 129.057f * color.g + 25.064f * color.b) / 256 + 0.5f);
+        yuvPalette[i * 3 + 1] = static_cast<std::uint8_t>(128 + (-37.945f * color.r - 74.494f * color.g + 112.439f * color.b) / 256 + 0.5f);
+        yuvPalette[i * 3 + 2] = static_cast<std::uint8_t>(128 + (112.439f * color.r - 94.154f * color.g - 18.285f * color.b) / 256 + 0.5f);
+    }
+}
+
+void Recorder::writeY4MFrame(const Matrix<std::uint8_t>& frame)
+{
+    unsigned planeSize = width * height;
+    const std::uint8_t* indexes = frame.data();
+    for (unsigned i = 0; i < planeSize; ++i)
+    {
+        const std::uint8_t* color = &yuvPalette[indexes[i] * 3];
+        planes[i] = color[0];
+        planes[planeSize + i] = color[1];
+        planes[planeSize * 2 + i] = color[2];
+    }
+    file << "FRAME\n";
+    file.write(planes.data(), planes.size());
+}
+
+void Recorder::writeGIFHeader()
+{
+    colorBits = 1;
+    while (colorBits < 8 && (1u << colorBits) < palette.size())
+        ++colorBits;
+
+    // Header and logical screen descriptor, with a global color table
+    file.write("GIF89a", 6);
+    writeShort(width);
+    writeShort(height);
+    file.put(static_cast<char>(0xF0 | (colorBits - 1)));
+    file.put(0); // Background color
+    file.put(0); // Square pixels
+    for (unsigned i = 0; i < (1u << colorBits); ++i)
+    {
+        const sf::Color& color = palette[std::min<unsigned>(i, palette.size() - 1)];
+        file.put(color.r);
+        file.put(color.g);
+        file.put(color.b);
+    }
+
+    // Loop forever
+    file.write("\x21\xFF\x0BNETSCAPE2.0\x03\x01", 16);
+    writeShort(0);
+    file.put(0);
+
+    lastFrame.clear();
+}
+
+void Recorder::writeGIFFrame(const Matrix<std::uint8_t>& frame)
+{
+    // Find the rectangle that changed since the last frame (the first frame is always whole)
+    unsigned left = 0;
+    unsigned top = 0;
+    unsigned right = width;
+    unsigned bottom = height;
+    if (lastFrame.width() == width && lastFrame.height() == height)
+    {
+        left = width;
+        top = height;
+        right = 0;
+        bottom = 0;
+        for (unsigned y = 0; y < height; ++y)
+        {
+            for (unsigned x = 0; x < width; ++x)
+            {
+                if (frame(x, y) != lastFrame(x, y))
+                {
+                    left = std::min(left, x);
+                    top = std::min(top, y);
+                    right = std::max(right, x + 1);
+                    bottom = std::max(bottom, y + 1);
+                }
+            }
+        }
+        // Nothing changed, but the frame still needs to take up time
+        if (left >= right)
+        {
+            left = 0;
+            top = 0;
+            right = 1;
+            bottom = 1;
+        }
+    }
+    lastFrame = frame;
+
+    // Graphic control extension, which leaves the last frame in place under this one
+    unsigned delay = (100 + fps / 2) / fps;
+    file.write("\x21\xF9\x04\x04", 4);
+    writeShort(std::max(delay, 2u)); // Most viewers slow down shorter delays anyway
+    file.put(0); // No transparent color
+    file.put(0);
+
+    // Image descriptor, using the global color table
+    file.put(0x2C);
+    writeShort(left);
+    writeShort(top);
+    writeShort(right - left);
+    writeShort(bottom - top);
+    file.put(0);
+
+    writeLZW(frame, left, top, right - left, bottom - top);
+}
+
+void Recorder::writeLZW(const Matrix<std::uint8_t>& frame, unsigned left, unsigned top, unsigned rectWidth, unsigned rectHeight)
+{
+    const unsigned maxCodes = 4096;
+    unsigned minCodeSize = std::max(colorBits, 2u);
+    unsigned alphabetSize = 1u << colorBits;
+    unsigned clearCode = 1u << minCodeSize;
+    unsigned endCode = clearCode + 1;
+    file.put(static_cast<char>(minCodeSize));
+
+    // The dictionary is a tree, where each code has a child code for every color (0 means there isn't one)
+    std::vector<std::uint16_t> children(maxCodes * alphabetSize);
+    unsigned nextCode = endCode + 1;
+    unsigned codeSize = minCodeSize + 1;
+    GIFCodeWriter writer(file);
+    writer.write(clearCode, codeSize);
+
+    unsigned mask = alphabetSize - 1;
+    int prefix = -1;
+    for (unsigned y = top; y < top + rectHeight; ++y)
+    {
+        for (unsigned x = left; x < left + rectWidth; ++x)
+        {
+            unsigned color = frame(x, y) & mask;
+            if (prefix < 0)
+            {
+                prefix = color;
+                continue;
+            }
+            std::uint16_t& child = children[prefix * alphabetSize + color];
+            if (child)
+            {
+                prefix = child;
+                continue;
+            }
+            writer.write(prefix, codeSize);
+            if (nextCode < maxCodes)
+            {
+                child = nextCode++;
+                // The decoder adds each code one step later, so the size only grows after it's needed
+                if (nextCode > (1u << codeSize) && codeSize < 12)
+                    ++codeSize;
+            }
+            else
+            {
+                // The dictionary is full, so start a new one
+                writer.write(clearCode, codeSize);
+                std::fill(children.begin(), children.end(), 0);
+                nextCode = endCode + 1;
+                codeSize = minCodeSize + 1;
+            }
+            prefix = color;
+        }
+    }
+    if (prefix >= 0)
+    {
+        writer.write(prefix, codeSize);
+        // The decoder still adds a code for the last one, which can make the end code bigger
+        if (nextCode < maxCodes && ++nextCode > (1u << codeSize) && codeSize < 12)
+            ++codeSize;
+    }
+    writer.write(endCode, codeSize);
+    writer.finish();
+}
+
+void Recorder::writeShort(unsigned value)
+{
+    file.put(static_cast<char>(value & 0xFF));
+    file.put(static_cast<char>((value >> 8) & 0xFF));
+}
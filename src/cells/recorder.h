@@ -0,0 +1,60 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <SFML/Graphics/Color.hpp>
+#include "matrix.h"
+
+/*
+This class streams frames into a single video file, instead of saving an image for every generation.
+Frames are palette indexes (usually the cell states), so they're small, and the colors are only converted once.
+The format is picked from the extension of the filename:
+    .y4m: Uncompressed YUV4MPEG2 (4:4:4), which can be piped into video tools like ffmpeg
+    .gif: Animated GIF, where each frame only stores the rectangle that changed since the last one
+GIFs can have at most 256 colors, so larger palettes are cut off.
+*/
+class Recorder
+{
+    public:
+        enum class Format
+        {
+            Y4M,
+            GIF
+        };
+
+        Recorder();
+        ~Recorder();
+        bool start(const std::string& filename, unsigned width, unsigned height, const std::vector<sf::Color>& palette, unsigned fps);
+        bool addFrame(const Matrix<std::uint8_t>& frame); // Returns false if the frame is the wrong size
+        void stop(); // Finishes the file
+        bool isRecording() const;
+        unsigned getFrameCount() const;
+
+    private:
+        void writeY4MHeader();
+        void writeY4MFrame(const Matrix<std::uint8_t>& frame);
+        void writeGIFHeader();
+        void writeGIFFrame(const Matrix<std::uint8_t>& frame);
+        void writeLZW(const Matrix<std::uint8_t>& frame, unsigned left, unsigned top, unsigned width, unsigned height);
+        void writeShort(unsigned value);
+
+        std::ofstream file;
+        Format format;
+        unsigned width;
+        unsigned height;
+        unsigned fps;
+        std::vector<sf::Color> palette;
+        unsigned colorBits; // GIF palettes are a power of 2
+        unsigned frameCount;
+        Matrix<std::uint8_t> lastFrame; // GIF frames only store the changes from this
+        std::vector<char> planes; // Y4M frames are written all at once
+        std::vector<std::uint8_t> yuvPalette; // The Y, U, and V values of each palette index
+};
+
+#endif
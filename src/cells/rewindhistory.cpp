@@ -0,0 +1,278 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "rewindhistory.h"
+#include <algorithm>
+#include "deltacoder.h"
+#include "trace.h"
+
+RewindHistory::RewindHistory():
+    memoryLimit(0),
+    keyframeInterval(64),
+    memoryUsed(0),
+    current(0),
+    framesSinceKeyframe(0),
+    newestPosition()
+{
+}
+
+void RewindHistory::setLimits(std::size_t bytes, unsigned keyframeInterval)
+{
+    memoryLimit = bytes;
+    this->keyframeInterval = std::max(keyframeInterval, 1u);
+    if (memoryLimit == 0)
+        clear();
+    else
+        trimToLimit();
+}
+
+bool RewindHistory::isEnabled() const
+{
+    return (memoryLimit > 0);
+}
+
+void RewindHistory::record(const Matrix<char>& cells, const Automaton::Position& position)
+{
+    if (memoryLimit == 0)
+        return;
+
+    // Start over with these cells if there is nothing to compare them to
+    if (cells.width() != newest.width() || cells.height() != newest.height())
+    {
+        clear();
+        newest = cells;
+        newestPosition = position;
+        return;
+    }
+
+    TRACE_SCOPE("RewindHistory::record");
+    truncate();
+    Frame frame;
+    frame.position = newestPosition;
+    std::size_t size = cells.size();
+    DeltaCoder::encodeXor(newest.data(), cells.data(), size, frame.delta);
+    std::size_t firstIndex = size;
+    std::size_t lastIndex = 0;
+    DeltaCoder::forEach(frame.delta, [&](std::size_t index, char){
+        firstIndex = std::min(firstIndex, index);
+        lastIndex = std::max(lastIndex, index);
+    });
+    bool unchanged = (firstIndex == size);
+    if (unchanged && position.generation == newestPosition.generation)
+        return;
+    frame.firstRow = (unchanged ? 1 : firstIndex / cells.width());
+    frame.lastRow = (unchanged ? 0 : lastIndex / cells.width());
+
+    // Keep the whole board every so often, before it changes
+    if (frames.empty() || framesSinceKeyframe >= keyframeInterval)
+    {
+        DeltaCoder::encode(newest.data(), size, frame.keyframe);
+        frame.keyframe.shrink_to_fit();
+        framesSinceKeyframe = 0;
+    }
+    ++framesSinceKeyframe;
+
+    // Only the cells that changed need to be copied
+    applyDelta(frame, newest.data());
+    newestPosition = position;
+    frame.delta.shrink_to_fit();
+    memoryUsed += getSize(frame);
+    frames.push_back(std::move(frame));
+    current = frames.size();
+    trimToLimit();
+}
+
+bool RewindHistory::rewind(unsigned steps, const Matrix<char>& cells, const SetCell& setCell, Automaton::Position& position, sf::Rect<unsigned>& changed)
+{
+    if (current == 0 || steps == 0)
+        return false;
+    std::size_t target = current - std::min<std::size_t>(steps, current);
+    if (!moveTo(target, cells, setCell, changed))
+        return false;
+    position = frames[target].position;
+    return true;
+}
+
+bool RewindHistory::forward(unsigned steps, const Matrix<char>& cells, const SetCell& setCell, Automaton::Position& position, sf::Rect<unsigned>& changed)
+{
+    if (current >= frames.size() || steps == 0)
+        return false;
+    std::size_t target = current + std::min<std::size_t>(steps, frames.size() - current);
+    if (!moveTo(target, cells, setCell, changed))
+        return false;
+    position = (target < frames.size() ? frames[target].position : newestPosition);
+    return true;
+}
+
+bool RewindHistory::isRewound() const
+{
+    return (current < frames.size());
+}
+
+void RewindHistory::clear()
+{
+    frames.clear();
+    memoryUsed = 0;
+    current = 0;
+    framesSinceKeyframe = 0;
+    newest.clear();
+}
+
+std::size_t RewindHistory::getMemoryUsed() const
+{
+    return memoryUsed;
+}
+
+bool RewindHistory::moveTo(std::size_t target, const Matrix<char>& cells, const SetCell& setCell, sf::Rect<unsigned>& changed)
+{
+    // The board was resized, so the history doesn't fit it anymore
+    if (cells.width() != newest.width() || cells.height() != newest.height())
+    {
+        clear();
+        return false;
+    }
+
+    TRACE_SCOPE("RewindHistory::moveTo");
+    auto deltaBytes = [&](std::size_t first, std::size_t last)
+    {
+        std::size_t bytes = 0;
+        for (std::size_t i = first; i < last; ++i)
+            bytes += frames[i].delta.size();
+        return bytes;
+    };
+
+    // Going through the deltas costs as much as they take up, and starting from a keyframe
+    // (or the newest cells) costs a whole board, so only do that when it's cheaper
+    std::size_t walkCost = deltaBytes(std::min(current, target), std::max(current, target));
+    std::size_t keyframe = frames.size();
+    std::size_t jumpCost = walkCost;
+    bool fromNewest = false;
+    if (walkCost > cells.size())
+    {
+        for (std::size_t i = std::min(target + 1, frames.size()); i-- > 0; )
+        {
+            if (!frames[i].keyframe.empty())
+            {
+                keyframe = i;
+                jumpCost = cells.size() + deltaBytes(i, target);
+                break;
+            }
+        }
+        std::size_t newestCost = cells.size() + deltaBytes(target, frames.size());
+        if (newestCost < jumpCost)
+        {
+            fromNewest = true;
+            jumpCost = newestCost;
+        }
+    }
+
+    unsigned firstRow = cells.height();
+    unsigned lastRow = 0;
+    if (jumpCost >= walkCost)
+    {
+        // Step through each generation in between, one delta at a time
+        if (target < current)
+        {
+            for (std::size_t i = current; i-- > target; )
+                applyDelta(frames[i], cells, setCell);
+        }
+        else
+        {
+            for (std::size_t i = current; i < target; ++i)
+                applyDelta(frames[i], cells, setCell);
+        }
+        for (std::size_t i = std::min(current, target); i < std::max(current, target); ++i)
+        {
+            firstRow = std::min(firstRow, frames[i].firstRow);
+            lastRow = std::max(lastRow, frames[i].lastRow);
+        }
+    }
+    else
+    {
+        // Build the cells of the target, then only set the ones that are different
+        std::vector<char> targetCells;
+        if (fromNewest)
+        {
+            targetCells.assign(newest.data(), newest.data() + newest.size());
+            for (std::size_t i = frames.size(); i-- > target; )
+                applyDelta(frames[i], targetCells.data());
+        }
+        else
+        {
+            DeltaCoder::decode(frames[keyframe].keyframe, targetCells);
+            targetCells.resize(cells.size(), 0);
+            for (std::size_t i = keyframe; i < target; ++i)
+                applyDelta(frames[i], targetCells.data());
+        }
+        const char* data = cells.data();
+        for (std::size_t i = 0; i < targetCells.size(); ++i)
+        {
+            if (data[i] != targetCells[i])
+            {
+                unsigned y = i / cells.width();
+                setCell(sf::Vector2u(i % cells.width(), y), targetCells[i]);
+                firstRow = std::min(firstRow, y);
+                lastRow = std::max(lastRow, y);
+            }
+        }
+    }
+    current = target;
+    changed = sf::Rect<unsigned>(0, firstRow, cells.width(), (firstRow <= lastRow ? lastRow - firstRow + 1 : 0));
+    return true;
+}
+
+void RewindHistory::applyDelta(const Frame& frame, const Matrix<char>& cells, const SetCell& setCell) const
+{
+    unsigned width = cells.width();
+    DeltaCoder::forEach(frame.delta, [&](std::size_t index, char value){
+        sf::Vector2u pos(index % width, index / width);
+        setCell(pos, cells(pos) ^ value);
+    });
+}
+
+void RewindHistory::applyDelta(const Frame& frame, char* cells) const
+{
+    DeltaCoder::forEach(frame.delta, [cells](std::size_t index, char value){ cells[index] ^= value; });
+}
+
+void RewindHistory::truncate()
+{
+    if (current >= frames.size())
+        return;
+
+    // Take the newest cells back to where the board was rewound to
+    for (std::size_t i = frames.size(); i-- > current; )
+    {
+        applyDelta(frames[i], newest.data());
+        memoryUsed -= getSize(frames[i]);
+    }
+    newestPosition = frames[current].position;
+    frames.erase(frames.begin() + current, frames.end());
+
+    // The next keyframe is due based on the last one that is left
+    framesSinceKeyframe = keyframeInterval;
+    for (std::size_t i = frames.size(); i-- > 0 && frames.size() - i < keyframeInterval; )
+    {
+        if (!frames[i].keyframe.empty())
+        {
+            framesSinceKeyframe = frames.size() - i;
+            break;
+        }
+    }
+}
+
+void RewindHistory::trimToLimit()
+{
+    // Forget the oldest generations first, but never the one the board is at
+    while (memoryUsed > memoryLimit && current > 0)
+    {
+        memoryUsed -= getSize(frames.front());
+        frames.pop_front();
+        --current;
+    }
+}
+
+std::size_t RewindHistory::getSize(const Frame& frame)
+{
+    return sizeof(Frame) + frame.delta.capacity() + frame.keyframe.capacity();
+}
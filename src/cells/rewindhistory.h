@@ -0,0 +1,69 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef REWINDHISTORY_H
+#define REWINDHISTORY_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <cstddef>
+#include <SFML/Graphics/Rect.hpp>
+#include "matrix.h"
+#include "automaton.h"
+
+/*
+This class keeps the recent generations of a board, so it can be rewound and played forward again.
+Each generation is stored as the XOR of its cells and the cells before it, compressed so unchanged cells
+    take almost nothing (see the DeltaCoder class). XOR works both ways, so stepping backward or forward
+    only touches the cells that changed in that generation.
+Every so many generations, a compressed copy of all of the cells is kept too (a keyframe),
+    so jumping far back starts from the closest keyframe instead of going through every delta.
+Edits between generations are stored the same way, so going back over them is exact too.
+Once the board was rewound, recording a new generation replaces the ones that came after it.
+The oldest generations are forgotten when the history goes over its memory limit.
+A copy of the newest cells is also kept to compare against, which isn't counted in the limit.
+*/
+class RewindHistory
+{
+    public:
+        using SetCell = std::function<void(const sf::Vector2u&, char)>;
+
+        RewindHistory();
+        void setLimits(std::size_t bytes, unsigned keyframeInterval); // 0 bytes turns the history off
+        bool isEnabled() const;
+        void record(const Matrix<char>& cells, const Automaton::Position& position); // Call after each generation, and before rewinding if the cells were edited
+        bool rewind(unsigned steps, const Matrix<char>& cells, const SetCell& setCell, Automaton::Position& position, sf::Rect<unsigned>& changed); // Returns false if there is nothing older
+        bool forward(unsigned steps, const Matrix<char>& cells, const SetCell& setCell, Automaton::Position& position, sf::Rect<unsigned>& changed); // Returns false if already at the newest generation
+        bool isRewound() const; // Returns true if there are newer generations to go forward to
+        void clear(); // Forgets everything (like after loading a board)
+        std::size_t getMemoryUsed() const;
+
+    private:
+        struct Frame
+        {
+            Automaton::Position position; // Of the cells before the change
+            std::vector<char> delta; // Compressed XOR of the cells before and after
+            std::vector<char> keyframe; // Compressed cells before the change, empty except every so many frames
+            unsigned firstRow; // The rows that changed
+            unsigned lastRow;
+        };
+
+        bool moveTo(std::size_t target, const Matrix<char>& cells, const SetCell& setCell, sf::Rect<unsigned>& changed);
+        void applyDelta(const Frame& frame, const Matrix<char>& cells, const SetCell& setCell) const; // Changes the cells through setCell
+        void applyDelta(const Frame& frame, char* cells) const;
+        void truncate(); // Drops the frames after the current position
+        void trimToLimit();
+        static std::size_t getSize(const Frame& frame);
+
+        std::size_t memoryLimit;
+        unsigned keyframeInterval; // Frames between keyframes
+        std::size_t memoryUsed;
+        std::deque<Frame> frames; // Oldest first
+        std::size_t current; // Index of the frame the cells are at, frames.size() when at the newest cells
+        unsigned framesSinceKeyframe;
+        Matrix<char> newest; // The cells after the last frame
+        Automaton::Position newestPosition;
+};
+
+#endif
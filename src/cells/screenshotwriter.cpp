@@ -0,0 +1,146 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "screenshotwriter.h"
+#include <algorithm>
+#include "trace.h"
+
+ScreenshotWriter::ScreenshotWriter():
+    head(0),
+    tail(0),
+    stopping(false),
+    dropWhenFull(false),
+    dropped(0)
+{
+    setup(8, 0, false);
+}
+
+ScreenshotWriter::~ScreenshotWriter()
+{
+    stopWorkers();
+}
+
+void ScreenshotWriter::setup(unsigned slotCount, unsigned workers, bool drop)
+{
+    // The workers finish everything that's already queued before the slots are replaced
+    stopWorkers();
+    slots = std::vector<Slot>(std::max(slotCount, 1u));
+    head = 0;
+    tail = 0;
+    dropWhenFull = drop;
+    if (workers == 0)
+        workers = std::max(std::thread::hardware_concurrency(), 1u);
+    startWorkers(std::min<unsigned>(workers, slots.size()));
+}
+
+bool ScreenshotWriter::add(const sf::Image& image, const std::string& filename)
+{
+    Slot* slot = getFreeSlot();
+    if (!slot)
+        return false;
+    // Assigning reuses the slot's pixels when the size hasn't changed
+    slot->image = image;
+    queue(*slot, filename);
+    return true;
+}
+
+bool ScreenshotWriter::add(const sf::Image& image, const sf::IntRect& rect, const std::string& filename)
+{
+    Slot* slot = getFreeSlot();
+    if (!slot)
+        return false;
+    auto size = slot->image.getSize();
+    if (size.x != static_cast<unsigned>(rect.width) || size.y != static_cast<unsigned>(rect.height))
+        slot->image.create(rect.width, rect.height);
+    slot->image.copy(image, 0, 0, rect);
+    queue(*slot, filename);
+    return true;
+}
+
+void ScreenshotWriter::finish()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    slotFreed.wait(lock, [this]{
+        return std::all_of(slots.begin(), slots.end(), [](const Slot& slot){ return slot.state == State::Free; });
+    });
+}
+
+std::uint64_t ScreenshotWriter::takeDropped()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto count = dropped;
+    dropped = 0;
+    return count;
+}
+
+void ScreenshotWriter::startWorkers(unsigned workers)
+{
+    stopping = false;
+    for (unsigned i = 0; i < workers; ++i)
+        threads.emplace_back(&ScreenshotWriter::run, this);
+}
+
+void ScreenshotWriter::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slotQueued.notify_all();
+    for (auto& thread: threads)
+        thread.join();
+    threads.clear();
+}
+
+ScreenshotWriter::Slot* ScreenshotWriter::getFreeSlot()
+{
+    // Only the thread adding images changes the head, so the slot can be filled without holding the lock
+    TRACE_SCOPE("ScreenshotWriter::getFreeSlot");
+    std::unique_lock<std::mutex> lock(mutex);
+    Slot& slot = slots[head];
+    if (slot.state != State::Free)
+    {
+        if (dropWhenFull)
+        {
+            ++dropped;
+            return nullptr;
+        }
+        slotFreed.wait(lock, [&slot]{ return slot.state == State::Free; });
+    }
+    return &slot;
+}
+
+void ScreenshotWriter::queue(Slot& slot, const std::string& filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.filename = filename;
+        slot.state = State::Queued;
+        head = (head + 1) % slots.size();
+    }
+    slotQueued.notify_one();
+}
+
+void ScreenshotWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        slotQueued.wait(lock, [this]{ return stopping || slots[tail].state == State::Queued; });
+        Slot& slot = slots[tail];
+        if (slot.state != State::Queued)
+            break; // Stopping, and there is nothing left to save
+        slot.state = State::Saving;
+        tail = (tail + 1) % slots.size();
+
+        // Encode the image without holding the lock, so the other workers can save at the same time
+        lock.unlock();
+        {
+            TRACE_SCOPE("ScreenshotWriter::save");
+            slot.image.saveToFile(slot.filename);
+        }
+        lock.lock();
+        slot.state = State::Free;
+        slotFreed.notify_all();
+    }
+}
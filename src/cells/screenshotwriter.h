@@ -0,0 +1,68 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef SCREENSHOTWRITER_H
+#define SCREENSHOTWRITER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/Rect.hpp>
+
+/*
+This class saves images to files on worker threads, so encoding them doesn't hold up the simulation.
+Images are copied into a ring of slots, which are reused so the pixels don't need to be allocated every time.
+The slots are saved in the order they were added, by however many workers there are.
+When every slot is waiting to be saved, adding another image either waits for a free slot,
+    or skips the image if dropping is enabled (the number of skipped images is counted).
+Any images still in the queue are saved before the writer is destroyed.
+*/
+class ScreenshotWriter
+{
+    public:
+        ScreenshotWriter();
+        ~ScreenshotWriter();
+        void setup(unsigned slots, unsigned workers, bool dropWhenFull); // 0 workers uses one for each core
+        bool add(const sf::Image& image, const std::string& filename); // Returns false if the image was skipped
+        bool add(const sf::Image& image, const sf::IntRect& rect, const std::string& filename); // Only saves part of the image
+        void finish(); // Waits for the queued images to be saved
+        std::uint64_t takeDropped(); // Returns the number of skipped images since the last call, and resets it
+
+    private:
+        enum class State
+        {
+            Free,
+            Queued,
+            Saving
+        };
+
+        struct Slot
+        {
+            sf::Image image;
+            std::string filename;
+            State state = State::Free;
+        };
+
+        void startWorkers(unsigned workers);
+        void stopWorkers();
+        Slot* getFreeSlot(); // Returns the next slot to fill, or null if the image should be skipped
+        void queue(Slot& slot, const std::string& filename);
+        void run(); // Each worker's main loop
+
+        std::vector<Slot> slots;
+        std::vector<std::thread> threads;
+        std::mutex mutex; // Protects everything below
+        std::condition_variable slotQueued; // Signaled when there is an image to save, or when stopping
+        std::condition_variable slotFreed; // Signaled when an image was saved
+        unsigned head; // The next slot to fill
+        unsigned tail; // The next slot to save
+        bool stopping;
+        bool dropWhenFull;
+        std::uint64_t dropped;
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include "board.h"
 #include "tool.h"
+#include "trace.h"
 
 SettingsGUI::SettingsGUI(Board& board, cfg::File& config, Tool& tool, CallbackType callback):
     board(board),
@@ -114,7 +115,7 @@ SettingsGUI::SettingsGUI(Board& board, cfg::File& config, Tool& tool, CallbackTy
     buttons["medium"].setup(font, sf::Vector2f(left, top + 28), sf::Vector2u(halfElemWidth, elemHeight), "Medium");
     buttons["medium"].setPressedCallback(std::bind(&SettingsGUI::changeSpeedPreset, this, _1, 20.0f));
     buttons["fast"].setup(font, sf::Vector2f(left, top + 28 * 2), sf::Vector2u(halfElemWidth, elemHeight), "Fast");
-    buttons["fast"].setPressedCallback(std::bind(&SettingsGUI::changeSpeedPreset, this, _1, 60.0f));
+    buttons["fast"].setPressedCallback(std::bind(&SettingsGUI::changeSpeedPreset, this, _1, 0.0f)); // Unlimited
     buttons["play"].setup(font, sf::Vector2f(left + 76, top), sf::Vector2u(halfElemWidth, elemHeight), "Play");
     buttons["play"].setPressedCallback(std::bind(&SettingsGUI::playBoard, this, _1));
     buttons["play"].setMode(Button::Mode::Toggle);
@@ -298,9 +299,13 @@ void SettingsGUI::handleMouseEvent(const sf::Event& event, const sf::Vector2f& p
         setFocus(collisionBox.contains(pos));
 
     // Only pass events to the rule grid if the GUI has focus
-    if (focus && ruleGrid.handleMouseEvent(event, pos, board.accessRules()))
-        ruleText.setText(board.getRules());
-    // Update the inputbox if the grid was changed
+    // The grid changes a copy of the rules, since the board could be simulating them on another thread
+    RuleSet rules = board.accessRules();
+    if (focus && ruleGrid.handleMouseEvent(event, pos, rules))
+    {
+        board.setRules(rules);
+        ruleText.setText(board.getRules()); // Update the inputbox if the grid was changed
+    }
 
     ruleText.handleMouseEvent(event, pos);
     boardFilename.handleMouseEvent(event, pos);
@@ -318,6 +323,7 @@ void SettingsGUI::handleMouseEvent(const sf::Event& event, const sf::Vector2f& p
 
 void SettingsGUI::update()
 {
+    TRACE_SCOPE("SettingsGUI::update");
     ruleText.update();
     boardFilename.update();
     widthInput.update();
@@ -359,7 +365,12 @@ void SettingsGUI::changeRules(InputBox& input)
 
 void SettingsGUI::loadBoard(Button& button)
 {
-    board.loadFromFile(boardFilename.getText());
+    if (board.loadFromFile(boardFilename.getText()))
+    {
+        // Patterns can have their own rules
+        ruleGrid.setRules(board.accessRules());
+        ruleText.setText(board.getRules());
+    }
 }
 
 void SettingsGUI::saveBoard(Button& button)
@@ -0,0 +1,309 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include "automaton.h"
+#include "patternfile.h"
+#include "checkpointer.h"
+#include "cycledetector.h"
+#include "census.h"
+#include "statslog.h"
+#include "trace.h"
+
+/*
+A command-line runner for simulating boards without opening a window.
+It loads a board (or makes a new one), runs a number of generations as fast as possible,
+    then saves the result and prints some timing stats.
+*/
+
+namespace
+{
+    const unsigned defaultPatternBoardSize = 1024;
+
+    void printUsage(const char* name)
+    {
+        std::cout << "Usage: " << name << " [options] [input board or pattern (.rle, .cells, .lif, .mc)]\n"
+                  << "Options:\n"
+                  << "  -r, --rules <rules>            Rule string to simulate (default is " << Automaton::defaultRuleString << ")\n"
+                  << "  -g, --generations <n>          Number of generations to run (default is 100)\n"
+                  << "  -o, --output <file>            Saves the board to a file after running (patterns too, from the extension)\n"
+                  << "  -s, --size <width>x<height>    Makes a new board of this size instead of loading one (patterns are drawn in it)\n"
+                  << "  -f, --fill                     Adds random cells before running\n"
+                  << "      --region <x>,<y>,<w>,<h>   Only loads this part of the input board\n"
+                  << "      --seed <n>                 Seed used for random cells and stochastic rules\n"
+                  << "      --states <n>               Number of cell states, including the dead state (default is 2)\n"
+                  << "      --bounded                  Cells outside of the board are dead, instead of wrapping around\n"
+                  << "      --checkpoint <file>        Saves the board to this file in the background while running\n"
+                  << "      --checkpoint-every <n>     Saves a checkpoint every n generations\n"
+                  << "      --checkpoint-seconds <s>   Saves a checkpoint every s seconds (the default is 60 if neither is set)\n"
+                  << "      --resume                   Carries on from the checkpoint if it exists, and only runs the generations that are left\n"
+                  << "      --stop-on-cycle            Stops once the board repeats itself (a still life, oscillator, or spaceship)\n"
+                  << "      --skip-cycles              Once the board repeats itself, skips whole periods instead of simulating them\n"
+                  << "      --max-period <n>           Longest period that is looked for (default is 1024)\n"
+                  << "      --census                   Counts each kind of object on the board after running (still lifes, oscillators, and spaceships)\n"
+                  << "      --census-period <n>        Longest period of the objects that the census looks for (default is " << Census::defaultMaxPeriod << ")\n"
+                  << "      --stats <file>             Writes the population, births, deaths, and bounds of each generation (.bin is binary, otherwise CSV)\n"
+                  << "      --trace <file>             Writes a Chrome trace of each generation (needs a build with CELLS_TRACE)\n"
+                  << "  -h, --help                     Shows this message\n";
+    }
+
+    unsigned countLiveCells(const Automaton& automaton)
+    {
+        const Matrix<char>& cells = automaton.getCells();
+        unsigned count = 0;
+        for (unsigned i = 0; i < cells.size(); ++i)
+            count += (cells.data()[i] != 0);
+        return count;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string rules = Automaton::defaultRuleString;
+    std::string inputFilename;
+    std::string outputFilename;
+    std::string traceFilename;
+    std::string checkpointFilename;
+    std::string statsFilename;
+    std::uint64_t checkpointGenerations = 0;
+    float checkpointSeconds = 0.0f;
+    bool resume = false;
+    bool stopOnCycle = false;
+    bool skipCycles = false;
+    unsigned maxPeriod = 1024;
+    bool census = false;
+    unsigned censusPeriod = Census::defaultMaxPeriod;
+    std::uint64_t generations = 100;
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned seed = 0;
+    unsigned states = 2;
+    bool fill = false;
+    bool toroidal = true;
+    sf::Rect<unsigned> region;
+    bool useRegion = false;
+
+    // Read the arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if ((arg == "-r" || arg == "--rules") && hasValue)
+            rules = argv[++i];
+        else if ((arg == "-g" || arg == "--generations") && hasValue)
+            generations = std::strtoull(argv[++i], nullptr, 10);
+        else if ((arg == "-o" || arg == "--output") && hasValue)
+            outputFilename = argv[++i];
+        else if ((arg == "-s" || arg == "--size") && hasValue)
+        {
+            std::string size = argv[++i];
+            std::size_t separator = size.find_first_of("xX");
+            width = std::strtoul(size.c_str(), nullptr, 10);
+            height = (separator != std::string::npos ? std::strtoul(size.c_str() + separator + 1, nullptr, 10) : width);
+        }
+        else if (arg == "-f" || arg == "--fill")
+            fill = true;
+        else if (arg == "--region" && hasValue)
+        {
+            // Only the tiles that overlap the region are read from the board file
+            char* next = argv[++i];
+            unsigned* values[] = {&region.left, &region.top, &region.width, &region.height};
+            for (unsigned* value: values)
+            {
+                *value = std::strtoul(next, &next, 10);
+                next += (*next == ',');
+            }
+            useRegion = true;
+        }
+        else if (arg == "--seed" && hasValue)
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--states" && hasValue)
+            states = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--bounded")
+            toroidal = false;
+        else if (arg == "--checkpoint" && hasValue)
+            checkpointFilename = argv[++i];
+        else if (arg == "--checkpoint-every" && hasValue)
+            checkpointGenerations = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--checkpoint-seconds" && hasValue)
+            checkpointSeconds = std::strtof(argv[++i], nullptr);
+        else if (arg == "--resume")
+            resume = true;
+        else if (arg == "--stop-on-cycle")
+            stopOnCycle = true;
+        else if (arg == "--skip-cycles")
+            skipCycles = true;
+        else if (arg == "--max-period" && hasValue)
+            maxPeriod = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--census")
+            census = true;
+        else if (arg == "--census-period" && hasValue)
+            censusPeriod = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--stats" && hasValue)
+            statsFilename = argv[++i];
+        else if (arg == "--trace" && hasValue)
+            traceFilename = argv[++i];
+        else if (arg == "-h" || arg == "--help")
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] != '-' && inputFilename.empty())
+            inputFilename = arg;
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!traceFilename.empty() && !Trace::start(traceFilename))
+    {
+        std::cerr << "Error: Could not write the trace to \"" << traceFilename << "\".\n";
+        return 1;
+    }
+
+    // Setup the automaton
+    Automaton automaton;
+    automaton.setMaxState(static_cast<char>(std::min(std::max(states, 2u), 128u) - 1));
+    automaton.setSeed(seed);
+    if (!automaton.setRules(rules))
+    {
+        std::cerr << "Error: Could not load the rules \"" << rules << "\".\n";
+        return 1;
+    }
+    // Patterns are drawn in the middle of a board, which doesn't need to be given a size
+    bool isPattern = (PatternFile::getFormat(inputFilename) != PatternFile::Format::None);
+    if (width > 0 && height > 0)
+        automaton.resize(width, height, false);
+    else if (isPattern)
+        automaton.resize(defaultPatternBoardSize, defaultPatternBoardSize, false);
+    if (isPattern && !automaton.loadFromFile(inputFilename))
+    {
+        std::cerr << "Error: Could not load the pattern \"" << inputFilename << "\".\n";
+        return 1;
+    }
+    else if (!isPattern && (width == 0 || height == 0) &&
+        (inputFilename.empty() || !(useRegion ? automaton.loadFromFile(inputFilename, region) : automaton.loadFromFile(inputFilename))))
+    {
+        std::cerr << "Error: Could not load the board \"" << inputFilename << "\", use --size to make a new one.\n";
+        return 1;
+    }
+    // Smaller boards can't be simulated, so the generation would never go up
+    if (automaton.width() < 3 || automaton.height() < 3)
+    {
+        std::cerr << "Error: The board has to be at least 3x3.\n";
+        return 1;
+    }
+    if (fill)
+        automaton.addRandom();
+
+    // The checkpoint has the generation it was saved at, so only the rest of the generations are run
+    std::uint64_t endGeneration = automaton.getGeneration() + generations;
+    if (resume && !checkpointFilename.empty() && std::ifstream(checkpointFilename).good())
+    {
+        if (!automaton.loadFromFile(checkpointFilename))
+        {
+            std::cerr << "Error: Could not load the checkpoint \"" << checkpointFilename << "\".\n";
+            return 1;
+        }
+        std::cout << "resumed at generation: " << automaton.getGeneration() << "\n";
+    }
+    Checkpointer checkpointer;
+    if (!checkpointFilename.empty())
+        checkpointer.setup(checkpointFilename, checkpointGenerations, (checkpointGenerations == 0 && checkpointSeconds <= 0.0f ? 60.0f : checkpointSeconds));
+
+    CycleDetector cycleDetector;
+    if (stopOnCycle || skipCycles)
+        cycleDetector.setHistorySize(maxPeriod);
+
+    // The statistics are counted while simulating, so they don't need another pass over the cells
+    StatsLog statsLog;
+    if (!statsFilename.empty())
+    {
+        if (!statsLog.open(statsFilename))
+        {
+            std::cerr << "Error: Could not write the statistics to \"" << statsFilename << "\".\n";
+            return 1;
+        }
+        automaton.setStatistics(true);
+    }
+
+    // Run the simulation
+    auto startGeneration = automaton.getGeneration();
+    auto startTime = std::chrono::steady_clock::now();
+    std::uint64_t skipped = 0;
+    checkpointer.update(automaton.getCells(), startGeneration);
+    while (automaton.getGeneration() < endGeneration)
+    {
+        auto lastGeneration = automaton.getGeneration();
+        automaton.simulate(toroidal);
+        if (automaton.getGeneration() == lastGeneration)
+        {
+            std::cerr << "Error: The board couldn't be simulated.\n";
+            return 1;
+        }
+        statsLog.add(automaton.getStatistics());
+        if (cycleDetector.update(automaton))
+        {
+            const auto& cycle = cycleDetector.getCycle();
+            std::cout << "cycle: period " << cycle.period << ", displacement " << cycle.dx << "," << cycle.dy
+                      << ", found at generation " << cycle.generation << "\n";
+            if (stopOnCycle)
+                break;
+            skipped += cycleDetector.jump(automaton, endGeneration, toroidal);
+        }
+        checkpointer.update(automaton.getCells(), automaton.getGeneration());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    generations = automaton.getGeneration() - startGeneration - skipped;
+    checkpointer.finish();
+    statsLog.close();
+
+    if (!outputFilename.empty() && !automaton.saveToFile(outputFilename))
+    {
+        std::cerr << "Error: Could not save the board to \"" << outputFilename << "\".\n";
+        return 1;
+    }
+
+    // Print the stats (one-dimensional rules only compute a single row for each generation)
+    double cellsPerGeneration = automaton.width();
+    if (automaton.getEngine() != Automaton::SpaceTime)
+        cellsPerGeneration *= automaton.height();
+    double cells = cellsPerGeneration * generations;
+    std::cout << "rules: " << automaton.getRules() << "\n"
+              << "size: " << automaton.width() << "x" << automaton.height() << "\n"
+              << "generations: " << generations << "\n"
+              << "generation: " << automaton.getGeneration() << "\n"
+              << "skipped generations: " << skipped << "\n"
+              << "seconds: " << seconds << "\n"
+              << "generations/second: " << (seconds > 0.0 ? generations / seconds : 0.0) << "\n"
+              << "cells/second: " << (seconds > 0.0 ? cells / seconds : 0.0) << "\n"
+              << "population: " << countLiveCells(automaton) << "\n";
+
+    // The census runs a copy of the board, so it doesn't change the saved result
+    if (census)
+    {
+        std::vector<Census::Entry> entries;
+        auto censusStart = std::chrono::steady_clock::now();
+        if (!Census::take(automaton, toroidal, censusPeriod, entries))
+        {
+            std::cerr << "Error: The census only works with rules that don't use random numbers, and have a fixed neighborhood.\n";
+            return 1;
+        }
+        std::uint64_t objects = 0;
+        for (const auto& entry: entries)
+            objects += entry.count;
+        std::cout << "census seconds: " << std::chrono::duration<double>(std::chrono::steady_clock::now() - censusStart).count() << "\n"
+                  << "census objects: " << objects << "\n";
+        for (const auto& entry: entries)
+            std::cout << "census: " << entry.code << " " << entry.count << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,576 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "automaton.h"
+#include <algorithm>
+#include <iostream>
+#include "bitpacking.h"
+#include "boardfile.h"
+#include "patternfile.h"
+#include "trace.h"
+
+const char* Automaton::defaultRuleString = "B3/S23";
+
+Automaton::Automaton():
+    engine(LifeLike),
+    rowsPerStep(1),
+    readCells(0),
+    writeCells(0),
+    maxState(1),
+    generation(0),
+    seed(0),
+    randomFills(0),
+    statisticsEnabled(false),
+    countingCells(false),
+    statistics(),
+    boundsLeft(0),
+    boundsTop(0),
+    boundsRight(0),
+    boundsBottom(0)
+{
+    setRules();
+}
+
+Automaton::Automaton(unsigned width, unsigned height):
+    Automaton()
+{
+    resize(width, height, false);
+}
+
+void Automaton::resize(unsigned width, unsigned height, bool preserve)
+{
+    // Only resize if the new size is different
+    if (width != cells[readCells].width() || height != cells[readCells].height())
+    {
+        // Clear the cells if specified
+        if (!preserve)
+        {
+            cells[0].clear();
+            cells[1].clear();
+        }
+        cells[0].resize(width, height);
+        cells[1].resize(width, height);
+        if (engine == Continuous)
+            updateContinuousField();
+    }
+}
+
+unsigned Automaton::width() const
+{
+    return cells[readCells].width();
+}
+
+unsigned Automaton::height() const
+{
+    return cells[readCells].height();
+}
+
+void Automaton::setMaxState(char state)
+{
+    maxState = std::max(state, static_cast<char>(1));
+}
+
+char Automaton::getMaxState() const
+{
+    return maxState;
+}
+
+bool Automaton::setRules(const std::string& ruleString)
+{
+    bool status = true;
+    if (Lenia::isLeniaString(ruleString))
+    {
+        continuousRules.setFromString(ruleString);
+        if (engine != Continuous)
+        {
+            engine = Continuous;
+            updateContinuousField();
+        }
+    }
+    else if (Elementary::isElementaryString(ruleString))
+    {
+        lineRules.setFromString(ruleString);
+        engine = SpaceTime;
+    }
+    else if (Margolus::isMargolusString(ruleString))
+    {
+        blockRules.setFromString(ruleString);
+        engine = Block;
+    }
+    else if (RuleTable::isRuleTableString(ruleString))
+    {
+        // Keep the current rules if the table can't be loaded
+        status = tableRules.loadFromString(ruleString);
+        if (status)
+            engine = Table;
+    }
+    else
+    {
+        rules.setFromString(ruleString.empty() ? defaultRuleString : ruleString);
+        engine = LifeLike;
+    }
+    return status;
+}
+
+void Automaton::setRules(const RuleSet& newRules)
+{
+    rules = newRules;
+    engine = LifeLike;
+}
+
+const std::string& Automaton::getRules() const
+{
+    if (engine == Continuous)
+        return continuousRules.toString();
+    else if (engine == Table)
+        return tableRules.toString();
+    else if (engine == Block)
+        return blockRules.toString();
+    else if (engine == SpaceTime)
+        return lineRules.toString();
+    return rules.toString();
+}
+
+RuleSet& Automaton::accessRules()
+{
+    return rules;
+}
+
+int Automaton::getEngine() const
+{
+    return engine;
+}
+
+bool Automaton::isDeterministic() const
+{
+    return !(engine == LifeLike && rules.isStochastic());
+}
+
+const std::vector<std::string>& Automaton::getTableColors() const
+{
+    return tableRules.getColors();
+}
+
+void Automaton::simulate(bool toroidal)
+{
+    simulate(sf::Rect<unsigned>(0, 0, width(), height()), toroidal, false);
+}
+
+sf::Rect<unsigned> Automaton::simulate(const sf::Rect<unsigned>& rect, bool toroidal, bool partial)
+{
+    TRACE_SCOPE("Automaton::simulate");
+    sf::Rect<unsigned> changed(0, 0, 0, 0);
+    // Make sure the simulation area is at least 3x3
+    if (rect.width >= 3 && rect.height >= 3)
+    {
+        if (statisticsEnabled)
+        {
+            statistics = Statistics();
+            boundsLeft = width();
+            boundsTop = height();
+            boundsRight = 0;
+            boundsBottom = 0;
+        }
+        if (engine == Continuous)
+        {
+            simulateContinuous(); // The convolution always covers all of the cells
+            changed = sf::Rect<unsigned>(0, 0, width(), height());
+        }
+        else
+        {
+            toggle(writeCells);
+
+            // This fixes a bug where partial simulations cause not all cells to be copied
+            bool partialArea = (partial || rect.width < width() || rect.height < height());
+            if (partialArea) // If this is a partial simulation
+                cells[writeCells] = cells[readCells]; // Copy the latest cells to the cells being written to
+
+            // Birth/survival rules visit every cell anyway, so they count them as they go
+            countingCells = (statisticsEnabled && engine == LifeLike && !partialArea);
+            if (engine == Table)
+                tableRules.step(cells[readCells], cells[writeCells], rect, toroidal);
+            else if (engine == Block)
+                blockRules.step(cells[readCells], cells[writeCells], rect, toroidal);
+            else if (engine == SpaceTime)
+                lineRules.step(cells[readCells], cells[writeCells], rect, toroidal, rowsPerStep);
+            else
+                simulateLifeLike(rect, toroidal);
+            if (statisticsEnabled && !countingCells)
+                countChanges(cells[readCells], cells[writeCells]);
+            countingCells = false;
+            readCells = writeCells;
+            changed = rect;
+        }
+        generation += (engine == SpaceTime ? rowsPerStep : 1);
+        if (statisticsEnabled)
+        {
+            statistics.generation = generation;
+            if (boundsLeft <= boundsRight)
+                statistics.bounds = sf::Rect<unsigned>(boundsLeft, boundsTop, boundsRight - boundsLeft + 1, boundsBottom - boundsTop + 1);
+        }
+    }
+    return changed;
+}
+
+bool Automaton::stepBack(bool toroidal)
+{
+    bool status = false;
+    if (engine == Block && blockRules.isReversible())
+    {
+        toggle(writeCells);
+        status = blockRules.stepBack(cells[readCells], cells[writeCells], sf::Rect<unsigned>(0, 0, width(), height()), toroidal);
+        readCells = writeCells;
+        if (generation > 0)
+            --generation;
+    }
+    return status;
+}
+
+void Automaton::setRowsPerStep(unsigned rows)
+{
+    rowsPerStep = std::max(rows, 1u);
+}
+
+void Automaton::setSeed(unsigned seed)
+{
+    this->seed = seed;
+    random = Philox(seed);
+    randomFills = 0;
+}
+
+std::uint64_t Automaton::getGeneration() const
+{
+    return generation;
+}
+
+Automaton::Position Automaton::getPosition() const
+{
+    return Position{generation, blockRules.getPhase(), lineRules.getRow()};
+}
+
+void Automaton::setPosition(const Position& position)
+{
+    generation = position.generation;
+    blockRules.setPhase(position.blockPhase);
+    lineRules.setRow(position.lineRow);
+}
+
+void Automaton::setStatistics(bool enabled)
+{
+    statisticsEnabled = enabled;
+    statistics = Statistics();
+}
+
+const Automaton::Statistics& Automaton::getStatistics() const
+{
+    return statistics;
+}
+
+char Automaton::operator()(unsigned x, unsigned y) const
+{
+    return cells[readCells](x, y);
+}
+
+float Automaton::getValue(unsigned x, unsigned y) const
+{
+    if (engine == Continuous)
+        return continuousRules(x, y);
+    return std::min(static_cast<float>(cells[readCells](x, y)) / maxState, 1.0f);
+}
+
+void Automaton::setCell(const sf::Vector2u& pos, char state)
+{
+    cells[writeCells](pos) = state;
+    if (engine == Continuous)
+        continuousRules(pos.x, pos.y) = std::min(static_cast<float>(state) / maxState, 1.0f);
+}
+
+char Automaton::liveState() const
+{
+    // Added cells in continuous rules start out fully live
+    return (engine == Continuous ? maxState : 1);
+}
+
+const Matrix<char>& Automaton::getCells() const
+{
+    return cells[readCells];
+}
+
+void Automaton::clear()
+{
+    Matrix<char>& current = cells[writeCells];
+    std::fill(current.data(), current.data() + current.size(), 0);
+    if (engine == Continuous)
+        continuousRules.clear();
+    lineRules.resetRow();
+    generation = 0;
+}
+
+void Automaton::addRandom(float density)
+{
+    // Uses a separate stream of random numbers from the simulation
+    Philox fillRandom(seed, 1);
+    sf::Vector2u cellPos;
+    for (cellPos.y = 0; cellPos.y < height(); ++cellPos.y)
+        for (cellPos.x = 0; cellPos.x < width(); ++cellPos.x)
+            if (Philox::chance(fillRandom(randomFills, cellPos.x, cellPos.y)[0], density))
+                setCell(cellPos, liveState());
+    ++randomFills;
+}
+
+bool Automaton::saveToFile(const std::string& filename) const
+{
+    if (PatternFile::getFormat(filename) != PatternFile::Format::None)
+    {
+        // Other programs name rule tables without the "@"
+        const std::string& ruleString = getRules();
+        return PatternFile::save(filename, cells[readCells], (engine == Table && !ruleString.empty() && ruleString[0] == '@') ? ruleString.substr(1) : ruleString);
+    }
+    return BoardFile::save(filename, cells[readCells], generation);
+}
+
+bool Automaton::loadFromFile(const std::string& filename)
+{
+    bool status = false;
+    std::uint64_t loadedGeneration = 0;
+    if (PatternFile::getFormat(filename) != PatternFile::Format::None)
+    {
+        std::string ruleString;
+        status = PatternFile::load(filename, cells[writeCells], ruleString);
+        if (status && !ruleString.empty())
+        {
+            // Rule names without a slash (like "WireWorld") are rule tables, which need an "@" here
+            if (ruleString.find('/') == std::string::npos && ruleString[0] != '@' && !Lenia::isLeniaString(ruleString) &&
+                !Elementary::isElementaryString(ruleString) && !Margolus::isMargolusString(ruleString))
+                ruleString = "@" + ruleString;
+            if (!setRules(ruleString))
+                std::cerr << "Warning: Couldn't use the pattern's rules \"" << ruleString << "\".\n";
+        }
+    }
+    else
+        status = BoardFile::load(filename, cells[writeCells], &loadedGeneration);
+    if (status)
+        loadedCells(loadedGeneration);
+    return status;
+}
+
+bool Automaton::loadFromFile(const std::string& filename, const sf::Rect<unsigned>& region)
+{
+    std::uint64_t loadedGeneration = 0;
+    bool status = BoardFile::loadRegion(filename, region, cells[writeCells], &loadedGeneration);
+    if (status)
+        loadedCells(loadedGeneration);
+    return status;
+}
+
+void Automaton::loadedCells(std::uint64_t loadedGeneration)
+{
+    // Needs to copy the newly loaded cells to the other layer
+    cells[(writeCells + 1) % 2] = cells[writeCells];
+    generation = loadedGeneration;
+    if (engine == Continuous)
+        updateContinuousField();
+}
+
+void Automaton::simulateLifeLike(const sf::Rect<unsigned>& rect, bool toroidal)
+{
+    /*
+    The order in which the cells are simulated:
+    2 2 2 2 2
+    3 1 1 1 3
+    3 1 1 1 3
+    3 1 1 1 3
+    2 2 2 2 2
+    This is so we can skip bounds checking and toroidal wrap-around algorithms for most of the cells.
+    */
+
+    sf::Vector2u cellPos;
+    unsigned bottom = rect.top + rect.height;
+    unsigned right = rect.left + rect.width;
+
+    // 1) Go through the main part of the cells except for the edges
+    for (cellPos.y = rect.top + 1; cellPos.y < bottom - 1; ++cellPos.y)
+        for (cellPos.x = rect.left + 1; cellPos.x < right - 1; ++cellPos.x)
+            determineState(cellPos, countCellsFast(cellPos));
+    // 2) Top and bottom rows
+    for (cellPos.y = rect.top; cellPos.y < bottom; cellPos.y += rect.height - 1)
+        for (cellPos.x = rect.left; cellPos.x < right; ++cellPos.x)
+            determineState(cellPos, (toroidal ? countCellsToroidal(cellPos, rect) : countCellsNormal(cellPos)));
+    // 3) Left and right columns
+    for (cellPos.x = rect.left; cellPos.x < right; cellPos.x += rect.width - 1)
+        for (cellPos.y = rect.top + 1; cellPos.y < bottom - 1; ++cellPos.y)
+            determineState(cellPos, (toroidal ? countCellsToroidal(cellPos, rect) : countCellsNormal(cellPos)));
+}
+
+unsigned Automaton::countCellsFast(const sf::Vector2u& pos) const
+{
+    // WARNING: This function assumes the following is true:
+    // if (pos.x > 0 && pos.y > 0 && pos.x < width() - 1 && pos.y < height() - 1)
+    // Which means that you should not use this function on cells that are on the edge of the board!
+    // This is only done for performance reasons.
+    unsigned count = 0;
+    sf::Vector2u startPos(pos.x - 1, pos.y - 1);
+    sf::Vector2u endPos(pos.x + 1, pos.y + 1);
+    sf::Vector2u tempPos;
+
+    // Iterate through a 3x3 grid around the cell
+    for (tempPos.y = startPos.y; tempPos.y <= endPos.y; ++tempPos.y)
+        for (tempPos.x = startPos.x; tempPos.x <= endPos.x; ++tempPos.x)
+            if (tempPos != pos) // Ignore the center cell
+                count += (cells[readCells](tempPos) != 0); // Increment the count if the cell is live
+
+    return count;
+}
+
+unsigned Automaton::countCellsNormal(const sf::Vector2u& pos) const
+{
+    unsigned count = 0;
+    sf::Vector2u startPos((pos.x > 0 ? pos.x - 1 : 0), (pos.y > 0 ? pos.y - 1 : 0));
+    sf::Vector2u endPos(std::min(pos.x + 1, width() - 1), std::min(pos.y + 1, height() - 1));
+    sf::Vector2u tempPos;
+
+    // Iterate through a 3x3 grid around the cell
+    for (tempPos.y = startPos.y; tempPos.y <= endPos.y; ++tempPos.y)
+        for (tempPos.x = startPos.x; tempPos.x <= endPos.x; ++tempPos.x)
+            if (tempPos != pos) // Ignore the center cell
+                count += (cells[readCells](tempPos) != 0); // Increment the count if the cell is live
+
+    return count;
+}
+
+unsigned Automaton::countCellsToroidal(const sf::Vector2u& pos, const sf::Rect<unsigned>& rect) const
+{
+    unsigned count = 0;
+    unsigned bottom = rect.top + rect.height - 1;
+    unsigned right = rect.left + rect.width - 1;
+
+    // Pre-calculate the ranges of cells to count
+    unsigned rangeX[3] = {pos.x - 1, pos.x, pos.x + 1};
+    unsigned rangeY[3] = {pos.y - 1, pos.y, pos.y + 1};
+    if (pos.x == rect.left)
+        rangeX[0] = right;
+    else if (pos.x == right)
+        rangeX[2] = rect.left;
+    if (pos.y == rect.top)
+        rangeY[0] = bottom;
+    else if (pos.y == bottom)
+        rangeY[2] = rect.top;
+
+    // Iterate through the ranges as a wrapped-around 3x3 grid
+    for (unsigned y: rangeY)
+        for (unsigned x: rangeX)
+            if (x != pos.x || y != pos.y) // Ignore the center cell
+                count += (cells[readCells](x, y) != 0); // Increment the count if the cell is live
+
+    return count;
+}
+
+void Automaton::determineState(const sf::Vector2u& pos, unsigned count)
+{
+    // Uses the rule set lookup table, and updates the state of the cell to the new state
+    bool currentState = (cells[readCells](pos) != 0);
+    bool newState = rules.getRule(currentState, count);
+    if (rules.isStochastic())
+    {
+        // Skip the update entirely, or only let the birth or survival happen some of the time
+        auto numbers = random(generation, pos.x, pos.y);
+        if (!Philox::chance(numbers[0], rules.getUpdateChance()))
+            newState = currentState;
+        else if (newState && !Philox::chance(numbers[1], rules.getChance(currentState ? RuleSet::Survival : RuleSet::Birth)))
+            newState = false;
+    }
+
+    // Live cells age up to the highest state
+    char& cell = cells[writeCells](pos);
+    if (newState)
+        cell = std::min(static_cast<char>(cells[readCells](pos) + 1), maxState);
+    else
+        cell = 0;
+    if (countingCells)
+        countCell(pos.x, pos.y, currentState, newState);
+}
+
+void Automaton::simulateContinuous()
+{
+    continuousRules.step();
+
+    // Quantize the field into cell states, so everything else can treat it like normal cells
+    Matrix<char>& current = cells[writeCells];
+    for (unsigned y = 0; y < height(); ++y)
+    {
+        for (unsigned x = 0; x < width(); ++x)
+        {
+            char state = static_cast<char>(continuousRules(x, y) * maxState + 0.5f);
+            if (statisticsEnabled)
+                countCell(x, y, current(x, y) != 0, state != 0);
+            current(x, y) = state;
+        }
+    }
+}
+
+void Automaton::updateContinuousField()
+{
+    continuousRules.resize(width(), height());
+    for (unsigned y = 0; y < height(); ++y)
+        for (unsigned x = 0; x < width(); ++x)
+            continuousRules(x, y) = std::min(static_cast<float>(cells[readCells](x, y)) / maxState, 1.0f);
+}
+
+void Automaton::toggle(unsigned& val) const
+{
+    val = !(static_cast<bool>(val));
+}
+
+void Automaton::countCell(unsigned x, unsigned y, bool wasLive, bool isLive)
+{
+    if (isLive)
+    {
+        ++statistics.population;
+        statistics.births += !wasLive;
+        boundsLeft = std::min(boundsLeft, x);
+        boundsTop = std::min(boundsTop, y);
+        boundsRight = std::max(boundsRight, x);
+        boundsBottom = std::max(boundsBottom, y);
+    }
+    else
+        statistics.deaths += wasLive;
+}
+
+void Automaton::countChanges(const Matrix<char>& previous, const Matrix<char>& current)
+{
+    // Each group of 8 cells is packed into a byte of live bits, so the counts are popcounts
+    unsigned width = current.width();
+    for (unsigned y = 0; y < current.height(); ++y)
+    {
+        const char* oldRow = &previous(0, y);
+        const char* newRow = &current(0, y);
+        for (unsigned x = 0; x < width; x += 8)
+        {
+            unsigned oldBits = 0;
+            unsigned newBits = 0;
+            if (x + 8 <= width)
+            {
+                oldBits = BitPacking::packWord(oldRow + x);
+                newBits = BitPacking::packWord(newRow + x);
+            }
+            else
+            {
+                for (unsigned i = 0; x + i < width; ++i)
+                {
+                    oldBits |= (oldRow[x + i] != 0) << i;
+                    newBits |= (newRow[x + i] != 0) << i;
+                }
+            }
+            statistics.births += BitPacking::countBits(newBits & ~oldBits);
+            statistics.deaths += BitPacking::countBits(oldBits & ~newBits);
+            if (newBits != 0)
+            {
+                statistics.population += BitPacking::countBits(newBits);
+                boundsLeft = std::min(boundsLeft, x + BitPacking::lowestBit(newBits));
+                boundsTop = std::min(boundsTop, y);
+                boundsRight = std::max(boundsRight, x + BitPacking::highestBit(newBits));
+                boundsBottom = y;
+            }
+        }
+    }
+}
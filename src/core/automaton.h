@@ -0,0 +1,157 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef AUTOMATON_H
+#define AUTOMATON_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <SFML/System/Vector2.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include "matrix.h"
+#include "ruleset.h"
+#include "lenia.h"
+#include "ruletable.h"
+#include "margolus.h"
+#include "elementary.h"
+#include "philox.h"
+
+/*
+This class holds the cells of a cellular automaton and simulates them, without any graphics.
+The type of rules is picked from the rule string (see the Engine enum).
+Live cells of birth/survival rules age each generation, up to the highest state.
+Continuous rules (see the Lenia class) are stored as states from 0 to the highest state,
+    and the real values can be read with getValue.
+Random numbers come from a counter-based generator keyed by the seed, generation, and cell position,
+    so stochastic rules and random fills are reproducible.
+Population statistics can be counted while simulating (see setStatistics). Birth/survival rules count the cells
+    as they are written, and the other rules compare the new cells to the last generation 8 at a time.
+The Board class draws an automaton, but this class can also be used by itself (like in cells-cli).
+*/
+class Automaton
+{
+    public:
+        static const char* defaultRuleString;
+
+        // The types of rules that can be simulated, which is picked from the rule string
+        enum Engine
+        {
+            LifeLike = 0, // Birth/survival rules (see the RuleSet class)
+            Continuous, // Real valued cells (see the Lenia class)
+            Table, // Any number of states (see the RuleTable class)
+            Block, // 2x2 blocks (see the Margolus class)
+            SpaceTime // One-dimensional rules, where each generation is a row (see the Elementary class)
+        };
+
+        // Everything about where the simulation is besides the cells, used for going back to earlier generations
+        struct Position
+        {
+            std::uint64_t generation;
+            unsigned blockPhase; // See the Margolus class
+            unsigned lineRow; // See the Elementary class
+        };
+
+        // Live cells of a generation, and how many changed since the last one
+        struct Statistics
+        {
+            std::uint64_t generation;
+            std::uint64_t population; // Live cells (any state besides 0)
+            std::uint64_t births; // Dead cells that became live
+            std::uint64_t deaths; // Live cells that died
+            sf::Rect<unsigned> bounds; // Around all of the live cells (empty when there are none)
+        };
+
+        Automaton();
+        Automaton(unsigned width, unsigned height);
+
+        // Size
+        void resize(unsigned width, unsigned height, bool preserve = true); // Resizes the cells, can be non-destructive
+        unsigned width() const;
+        unsigned height() const;
+        void setMaxState(char state); // Sets the highest state that cells can age to
+        char getMaxState() const;
+
+        // Rule settings
+        bool setRules(const std::string& ruleString = defaultRuleString); // Sets the rules from a rule string, returns false if they couldn't be loaded
+        void setRules(const RuleSet& newRules); // Sets the rules from another rule set object
+        const std::string& getRules() const; // Returns the rules in the same string format as above
+        RuleSet& accessRules(); // Returns a reference to the rule set
+        int getEngine() const; // Returns which type of rules are being simulated
+        bool isDeterministic() const; // Returns false if the rules use random numbers
+        const std::vector<std::string>& getTableColors() const; // Colors from the current rule table, if it has any
+
+        // Simulation
+        void simulate(bool toroidal = true); // Runs a single generation on all of the cells
+        sf::Rect<unsigned> simulate(const sf::Rect<unsigned>& rect, bool toroidal = true, bool partial = true); // Runs a single generation on an area, returns the area that changed
+        bool stepBack(bool toroidal = true); // Runs a single generation backwards, returns false if the rules aren't reversible
+        void setRowsPerStep(unsigned rows); // Sets how many generations of one-dimensional rules run in a single step
+        void setSeed(unsigned seed); // Sets the seed used for stochastic rules and random cells
+        std::uint64_t getGeneration() const; // Returns the number of generations since the cells were cleared (board files keep it when saved and loaded)
+        Position getPosition() const;
+        void setPosition(const Position& position); // The cells have to be set separately (the real values of continuous rules can't be restored)
+        void setStatistics(bool enabled); // Counts the live cells of each generation while simulating
+        const Statistics& getStatistics() const; // From the last generation that was simulated (edits to the cells aren't counted)
+
+        // Cells
+        char operator()(unsigned x, unsigned y) const; // Returns the state of a cell
+        float getValue(unsigned x, unsigned y) const; // Returns the state of a cell from 0 to 1 (the real value for continuous rules)
+        void setCell(const sf::Vector2u& pos, char state); // Sets the state of a cell, does no bounds checking
+        char liveState() const; // The state used when adding live cells
+        const Matrix<char>& getCells() const;
+        void clear(); // Kills all of the cells
+        void addRandom(float density = 0.125f); // Adds live cells with a chance of density for each cell
+
+        // Loading/saving
+        bool saveToFile(const std::string& filename) const; // Saves in the tiled format (see the BoardFile class), or a pattern format from the extension (see the PatternFile class)
+        bool loadFromFile(const std::string& filename); // Patterns keep the size of the board, and use the rules from the file if they have any
+        bool loadFromFile(const std::string& filename, const sf::Rect<unsigned>& region); // Only loads part of the board, which becomes the whole board
+
+    private:
+        // These are used for simulation
+        void simulateLifeLike(const sf::Rect<unsigned>& rect, bool toroidal); // Runs a single generation of the birth/survival rules
+        unsigned countCellsFast(const sf::Vector2u& pos) const; // Counts neighboring cells at a position, this is not toroidal and does no bounds checking
+        unsigned countCellsNormal(const sf::Vector2u& pos) const; // Counts neighboring cells at a position, this is not toroidal
+        unsigned countCellsToroidal(const sf::Vector2u& pos, const sf::Rect<unsigned>& rect) const; // Counts neighboring cells at a position, this is toroidal
+        void determineState(const sf::Vector2u& pos, unsigned count); // Determines the next state of the cell based on the number of neighboring cells
+        void simulateContinuous(); // Runs a single step of the continuous rules, and updates the cell states from the field
+        void updateContinuousField(); // Sets the continuous field from the cell states
+        void toggle(unsigned& val) const; // Toggles an unsigned int like a bool
+        void countCell(unsigned x, unsigned y, bool wasLive, bool isLive); // Adds a cell to the statistics of the generation being simulated
+        void countChanges(const Matrix<char>& previous, const Matrix<char>& current); // Counts all of the cells for the statistics, 8 at a time
+        void loadedCells(std::uint64_t loadedGeneration); // Sets everything else up after new cells were loaded into the write layer
+
+        // The rules
+        RuleSet rules;
+        Lenia continuousRules;
+        RuleTable tableRules;
+        Margolus blockRules;
+        Elementary lineRules;
+        int engine;
+        unsigned rowsPerStep; // Generations of one-dimensional rules per step
+
+        // Cells
+        Matrix<char> cells[2]; // Holds the states of the cells
+        unsigned readCells; // Which layer should be read from
+        unsigned writeCells; // Which layer should be written to
+        // Needs to switch between layers to properly simulate everything
+        // Note that both of these variables are the same when a simulation is not in progress
+        char maxState;
+
+        // Random numbers
+        std::uint64_t generation;
+        unsigned seed;
+        Philox random; // Used for stochastic rules
+        unsigned randomFills; // Number of times random cells were added, so each time is different
+
+        // Statistics
+        bool statisticsEnabled;
+        bool countingCells; // True while the birth/survival rules count the cells as they write them
+        Statistics statistics;
+        unsigned boundsLeft; // Edges of the live cells while counting (left is past right when there are none)
+        unsigned boundsTop;
+        unsigned boundsRight;
+        unsigned boundsBottom;
+};
+
+#endif
@@ -0,0 +1,473 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "census.h"
+#include <map>
+#include <unordered_map>
+#include <atomic>
+#include <algorithm>
+#include "parallel.h"
+#include "trace.h"
+
+const unsigned Census::defaultMaxPeriod = 64;
+
+namespace
+{
+    const unsigned tileSize = 128;
+    const unsigned joinDistance = 2; // Cells this close together can change each other in a single generation
+    const unsigned margin = 2; // Dead cells around an object when it's run by itself
+    const unsigned maxCanonicalSize = 40; // Bigger phases don't get a Wechsler code (the same limit as apgsearch)
+    const char* digits = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+    // The cells of an object that was separated from the others
+    struct Object
+    {
+        std::vector<unsigned> cells; // Indexes of everywhere it went on the board
+    };
+
+    // A phase of an object, cut down to its bounding box
+    struct Phase
+    {
+        Matrix<char> cells;
+        unsigned left;
+        unsigned top;
+    };
+
+    unsigned findRoot(std::vector<unsigned>& parent, unsigned i)
+    {
+        // Path halving, so later searches are shorter
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    void join(std::vector<unsigned>& parent, unsigned first, unsigned second)
+    {
+        // The smaller index is always the root, so the roots don't depend on the order of the joins
+        unsigned firstRoot = findRoot(parent, first);
+        unsigned secondRoot = findRoot(parent, second);
+        if (firstRoot < secondRoot)
+            parent[secondRoot] = firstRoot;
+        else if (secondRoot < firstRoot)
+            parent[firstRoot] = secondRoot;
+    }
+
+    void copyRules(const Automaton& source, Automaton& target)
+    {
+        target.setMaxState(source.getMaxState());
+        target.setRules(source.getRules());
+    }
+
+    void markLiveCells(const Matrix<char>& cells, Matrix<char>& path)
+    {
+        const char* data = cells.data();
+        char* marks = path.data();
+        for (unsigned i = 0; i < cells.size(); ++i)
+            marks[i] |= (data[i] != 0);
+    }
+
+    // Finds the range of coordinates an object covers, which can go across the edge of a toroidal board
+    void findSpan(std::vector<unsigned>& values, unsigned size, bool toroidal, unsigned& start, unsigned& span)
+    {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        start = values.front();
+        span = values.back() - values.front() + 1;
+        if (toroidal)
+        {
+            // The object is everywhere but the biggest gap between its coordinates (counting the one around the edge)
+            unsigned gap = values.front() + size - values.back();
+            for (unsigned i = 1; i < values.size(); ++i)
+            {
+                if (values[i] - values[i - 1] > gap)
+                {
+                    gap = values[i] - values[i - 1];
+                    start = values[i];
+                }
+            }
+            span = size - gap + 1;
+        }
+    }
+
+    // Birth/survival rules only keep whether each cell is alive (their states are how long the cells have been alive)
+    Phase cropPhase(const Matrix<char>& cells, bool binary)
+    {
+        unsigned left = cells.width();
+        unsigned top = cells.height();
+        unsigned right = 0;
+        unsigned bottom = 0;
+        for (unsigned y = 0; y < cells.height(); ++y)
+        {
+            for (unsigned x = 0; x < cells.width(); ++x)
+            {
+                if (cells(x, y) != 0)
+                {
+                    left = std::min(left, x);
+                    top = std::min(top, y);
+                    right = std::max(right, x);
+                    bottom = std::max(bottom, y);
+                }
+            }
+        }
+        Phase phase{Matrix<char>(), left, top};
+        if (left <= right)
+        {
+            phase.cells.resize(right - left + 1, bottom - top + 1, false);
+            for (unsigned y = top; y <= bottom; ++y)
+            {
+                if (binary)
+                    std::transform(&cells(left, y), &cells(left, y) + phase.cells.width(), &phase.cells(0, y - top), [](char state){ return static_cast<char>(state != 0); });
+                else
+                    std::copy(&cells(left, y), &cells(left, y) + phase.cells.width(), &phase.cells(0, y - top));
+            }
+        }
+        return phase;
+    }
+
+    bool isSamePattern(const Matrix<char>& first, const Matrix<char>& second)
+    {
+        return (first.width() == second.width() && first.height() == second.height() &&
+            std::equal(first.data(), first.data() + first.size(), second.data()));
+    }
+
+    // Writes one bit plane of the cells in the extended Wechsler format, rotated and reflected by the orientation (0 to 7)
+    std::string encodePlane(const Matrix<char>& cells, unsigned orientation, unsigned plane)
+    {
+        bool swap = ((orientation & 4) != 0);
+        bool flipX = ((orientation & 1) != 0);
+        bool flipY = ((orientation & 2) != 0);
+        unsigned length = (swap ? cells.height() : cells.width());
+        unsigned breadth = (swap ? cells.width() : cells.height());
+        auto getBit = [&](unsigned column, unsigned row)
+        {
+            if (row >= breadth)
+                return 0;
+            unsigned x = (swap ? row : column);
+            unsigned y = (swap ? column : row);
+            if (flipX)
+                x = cells.width() - 1 - x;
+            if (flipY)
+                y = cells.height() - 1 - y;
+            return (cells(x, y) >> plane) & 0x1;
+        };
+
+        // Each strip of 5 rows is written a column at a time, as a digit from 0 to v,
+        // where runs of empty columns are shortened (trailing ones are left off)
+        std::string code;
+        for (unsigned strip = 0; strip * 5 < breadth; ++strip)
+        {
+            if (strip > 0)
+                code += 'z';
+            unsigned zeros = 0;
+            for (unsigned column = 0; column < length; ++column)
+            {
+                unsigned value = 0;
+                for (unsigned row = 0; row < 5; ++row)
+                    value |= getBit(column, strip * 5 + row) << row;
+                if (value == 0)
+                {
+                    ++zeros;
+                    continue;
+                }
+                if (zeros == 1)
+                    code += '0';
+                else if (zeros == 2)
+                    code += 'w';
+                else if (zeros == 3)
+                    code += 'x';
+                else if (zeros > 3)
+                {
+                    code += 'y';
+                    code += digits[zeros - 4];
+                }
+                zeros = 0;
+                code += digits[value];
+            }
+        }
+        return code;
+    }
+
+    // Shorter codes come first, then they are compared by their characters
+    bool isBetterCode(const std::string& code, const std::string& best)
+    {
+        return (best.empty() || code.size() < best.size() || (code.size() == best.size() && code < best));
+    }
+
+    // Runs an object by itself to find out what it is, the code is empty if it has no live cells to start with
+    // Birth/survival rules are compared in every orientation, and only by which cells are alive
+    Census::Entry classify(Automaton& local, const Matrix<char>& cells, const Object& object, bool toroidal, unsigned maxPeriod, bool lifeLike)
+    {
+        Census::Entry entry{"zz_UNKNOWN", Census::Unknown, 0, 0, 0, 1};
+        unsigned width = cells.width();
+        unsigned height = cells.height();
+
+        // Work out where the object is, and give it some room around it (but not past the edges of a bounded board)
+        std::vector<unsigned> columns;
+        std::vector<unsigned> rows;
+        for (unsigned index: object.cells)
+        {
+            columns.push_back(index % width);
+            rows.push_back(index / width);
+        }
+        unsigned startX, spanX, startY, spanY;
+        findSpan(columns, width, toroidal, startX, spanX);
+        findSpan(rows, height, toroidal, startY, spanY);
+        if (toroidal && (spanX + margin * 2 > width || spanY + margin * 2 > height))
+            return entry; // It would run into itself around the board
+        unsigned marginLeft = (toroidal ? margin : std::min(margin, startX));
+        unsigned marginTop = (toroidal ? margin : std::min(margin, startY));
+        unsigned localWidth = marginLeft + spanX + (toroidal ? margin : std::min(margin, width - startX - spanX));
+        unsigned localHeight = marginTop + spanY + (toroidal ? margin : std::min(margin, height - startY - spanY));
+
+        // Copy the object, and mark where it went on the board
+        local.resize(localWidth, localHeight, false);
+        local.clear();
+        Matrix<char> path(localWidth, localHeight);
+        for (unsigned index: object.cells)
+        {
+            sf::Vector2u pos((index % width + width - startX) % width + marginLeft, (index / width + height - startY) % height + marginTop);
+            path(pos) = 1;
+            if (cells.data()[index] != 0)
+                local.setCell(pos, (lifeLike ? 1 : cells.data()[index]));
+        }
+        std::vector<Phase> phases;
+        phases.push_back(cropPhase(local.getCells(), lifeLike));
+        if (phases.front().cells.size() == 0)
+        {
+            entry.code.clear();
+            return entry;
+        }
+        unsigned population = std::count_if(phases.front().cells.data(), phases.front().cells.data() + phases.front().cells.size(), [](char state){ return state != 0; });
+
+        // Run it until it looks the same as it started
+        for (unsigned generation = 1; generation <= maxPeriod; ++generation)
+        {
+            local.simulate(false);
+            const Matrix<char>& next = local.getCells();
+            // Leaving the path it took on the board means it was changed by something else, or changes something else
+            for (unsigned i = 0; i < next.size(); ++i)
+            {
+                if (next.data()[i] != 0 && path.data()[i] == 0)
+                    return entry;
+            }
+            Phase phase = cropPhase(next, lifeLike);
+            if (phase.cells.size() == 0)
+                return entry;
+            if (isSamePattern(phase.cells, phases.front().cells))
+            {
+                entry.period = generation;
+                entry.dx = static_cast<int>(phase.left) - static_cast<int>(phases.front().left);
+                entry.dy = static_cast<int>(phase.top) - static_cast<int>(phases.front().top);
+                break;
+            }
+            phases.push_back(std::move(phase));
+        }
+        if (entry.period == 0)
+            return entry;
+
+        std::string prefix;
+        if (entry.dx != 0 || entry.dy != 0)
+        {
+            entry.kind = Census::Spaceship;
+            prefix = "xq" + std::to_string(entry.period);
+        }
+        else if (entry.period == 1)
+        {
+            entry.kind = Census::StillLife;
+            prefix = "xs" + std::to_string(population);
+        }
+        else
+        {
+            entry.kind = Census::Oscillator;
+            prefix = "xp" + std::to_string(entry.period);
+        }
+
+        // Multi-state cells get a code for each bit of their states that is used
+        unsigned char usedBits = 0;
+        for (const auto& phase: phases)
+            for (unsigned i = 0; i < phase.cells.size(); ++i)
+                usedBits |= static_cast<unsigned char>(phase.cells.data()[i]);
+
+        // Use the smallest code out of every phase and orientation
+        std::string best;
+        for (const auto& phase: phases)
+        {
+            if (phase.cells.width() > maxCanonicalSize || phase.cells.height() > maxCanonicalSize)
+                continue;
+            for (unsigned orientation = 0; orientation < (lifeLike ? 8u : 1u); ++orientation)
+            {
+                std::string code;
+                for (unsigned plane = 0; (usedBits >> plane) != 0; ++plane)
+                {
+                    if (((usedBits >> plane) & 0x1) != 0)
+                        code += (code.empty() ? "" : "_") + encodePlane(phase.cells, orientation, plane);
+                }
+                if (isBetterCode(code, best))
+                    best = code;
+            }
+        }
+        entry.code = (best.empty() ? "ov_" + prefix.substr(1) : prefix + "_" + best);
+        return entry;
+    }
+}
+
+bool Census::canTake(const Automaton& automaton)
+{
+    int engine = automaton.getEngine();
+    return ((engine == Automaton::LifeLike && automaton.isDeterministic()) || engine == Automaton::Table);
+}
+
+bool Census::take(const Automaton& automaton, bool toroidal, unsigned maxPeriod, std::vector<Entry>& entries)
+{
+    entries.clear();
+    if (!canTake(automaton))
+        return false;
+
+    TRACE_SCOPE("Census::take");
+    const Matrix<char>& cells = automaton.getCells();
+    unsigned width = cells.width();
+    unsigned height = cells.height();
+
+    // Run a copy of the board, and mark everywhere the cells go
+    Automaton board;
+    copyRules(automaton, board);
+    board.resize(width, height, false);
+    for (unsigned y = 0; y < height; ++y)
+    {
+        for (unsigned x = 0; x < width; ++x)
+        {
+            if (cells(x, y) != 0)
+                board.setCell(sf::Vector2u(x, y), cells(x, y));
+        }
+    }
+    Matrix<char> path(width, height);
+    markLiveCells(cells, path);
+    for (unsigned generation = 0; generation < maxPeriod; ++generation)
+    {
+        board.simulate(toroidal);
+        markLiveCells(board.getCells(), path);
+    }
+
+    // Join the marked cells that are close enough to change each other into objects, a tile at a time
+    std::vector<unsigned> parent(cells.size());
+    unsigned tilesX = (width + tileSize - 1) / tileSize;
+    unsigned tilesY = (height + tileSize - 1) / tileSize;
+    Parallel::forEach(tilesX * tilesY, [&](unsigned tile)
+    {
+        // Only cells inside of the tile are joined, so the threads never touch the same cells
+        unsigned left = (tile % tilesX) * tileSize;
+        unsigned top = (tile / tilesX) * tileSize;
+        unsigned right = std::min(left + tileSize, width);
+        unsigned bottom = std::min(top + tileSize, height);
+        for (unsigned y = top; y < bottom; ++y)
+        {
+            for (unsigned x = left; x < right; ++x)
+            {
+                unsigned i = y * width + x;
+                if (path.data()[i] == 0)
+                    continue;
+                parent[i] = i;
+                // Join with the cells that were already visited
+                for (unsigned nearY = std::max(y, top + joinDistance) - joinDistance; nearY <= y; ++nearY)
+                {
+                    unsigned nearRight = (nearY < y ? std::min(x + joinDistance, right - 1) : x);
+                    for (unsigned nearX = std::max(x, left + joinDistance) - joinDistance; nearX <= nearRight; ++nearX)
+                    {
+                        if (path(nearX, nearY) != 0)
+                            join(parent, i, nearY * width + nearX);
+                    }
+                }
+            }
+        }
+    });
+
+    // Then join the objects that go across the borders of the tiles (and the edges of a toroidal board)
+    auto joinAcross = [&](unsigned x, unsigned y)
+    {
+        unsigned i = y * width + x;
+        if (path.data()[i] == 0)
+            return;
+        int distance = joinDistance;
+        for (int offsetY = -distance; offsetY <= distance; ++offsetY)
+        {
+            for (int offsetX = -distance; offsetX <= distance; ++offsetX)
+            {
+                int nearX = static_cast<int>(x) + offsetX;
+                int nearY = static_cast<int>(y) + offsetY;
+                if (toroidal)
+                {
+                    nearX = (nearX + width) % width;
+                    nearY = (nearY + height) % height;
+                }
+                else if (nearX < 0 || nearY < 0 || nearX >= static_cast<int>(width) || nearY >= static_cast<int>(height))
+                    continue;
+                if (path(nearX, nearY) != 0)
+                    join(parent, i, nearY * width + nearX);
+            }
+        }
+    };
+    for (unsigned y = 0; y < height; ++y)
+    {
+        if (y % tileSize < joinDistance)
+        {
+            for (unsigned x = 0; x < width; ++x)
+                joinAcross(x, y);
+        }
+        else
+        {
+            for (unsigned x = 0; x < width; x += tileSize)
+                for (unsigned border = x; border < std::min(x + joinDistance, width); ++border)
+                    joinAcross(border, y);
+        }
+    }
+
+    // Group the cells of each object together
+    std::vector<Object> objects;
+    std::unordered_map<unsigned, unsigned> objectIndexes; // From the root of each object
+    for (unsigned i = 0; i < cells.size(); ++i)
+    {
+        if (path.data()[i] == 0)
+            continue;
+        auto inserted = objectIndexes.emplace(findRoot(parent, i), objects.size());
+        if (inserted.second)
+            objects.emplace_back();
+        objects[inserted.first->second].cells.push_back(i);
+    }
+
+    // Find out what each object is, spread across all of the cores
+    std::vector<Entry> found(objects.size());
+    bool lifeLike = (automaton.getEngine() == Automaton::LifeLike);
+    std::atomic<unsigned> next(0);
+    Parallel::forEach(Parallel::getThreadCount(objects.size()), [&](unsigned)
+    {
+        // Each thread uses its own automaton for all of its objects, since loading rule tables takes a while
+        Automaton local;
+        copyRules(automaton, local);
+        for (unsigned i = next++; i < objects.size(); i = next++)
+            found[i] = classify(local, cells, objects[i], toroidal, maxPeriod, lifeLike);
+    });
+
+    // Count each kind of object, with the most common first
+    std::map<std::string, Entry> counts;
+    for (const auto& entry: found)
+    {
+        if (entry.code.empty())
+            continue;
+        auto inserted = counts.emplace(entry.code, entry);
+        if (!inserted.second)
+            ++inserted.first->second.count;
+    }
+    for (const auto& count: counts)
+        entries.push_back(count.second);
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& first, const Entry& second){ return first.count > second.count; });
+    return true;
+}
+
+const char* Census::getKindName(Kind kind)
+{
+    static const char* names[] = {"still life", "oscillator", "spaceship", "unknown"};
+    return names[kind];
+}
@@ -0,0 +1,58 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef CENSUS_H
+#define CENSUS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "automaton.h"
+
+/*
+This class counts the objects on a board that has settled, like apgsearch does after running a soup.
+A copy of the board is run for a while, and everywhere the cells go is marked, so the phases of an oscillator
+    or the path of a spaceship join up into one object.
+The marked cells are split into objects in tiles on all of the cores, then joined across the tile borders.
+    Cells within 2 of each other can change each other, so they are in the same object (close objects are counted together).
+Each object is then run by itself to find its period and how far it moves, and is named by its canonical apgcode:
+    "xs" and the population for still lifes, "xp" and the period for oscillators, or "xq" and the period for spaceships,
+    then "_" and the extended Wechsler format of whichever phase and orientation gives the smallest code.
+Birth/survival rules only count whether cells are alive, since their states are how long the cells have been alive.
+    Cells of rule tables with states above 1 are written as bit planes, lowest first, each with their own Wechsler code
+    separated by "_" (planes that no cell uses are left out).
+Objects bigger than 40x40 are only named by their population or period (like "ov_p30"), and objects that
+    don't repeat or that change when they are separated from the others are counted as "zz_UNKNOWN".
+Only deterministic rules with a fixed neighborhood are supported (see canTake). Rule tables aren't always symmetric,
+    so their objects are only compared in the orientation they were found in.
+*/
+class Census
+{
+    public:
+        enum Kind
+        {
+            StillLife = 0,
+            Oscillator,
+            Spaceship,
+            Unknown
+        };
+
+        // One kind of object, and how many of them were found
+        struct Entry
+        {
+            std::string code; // The apgcode, like "xs4_33" for a block
+            Kind kind;
+            unsigned period; // 0 for unknown objects
+            int dx; // How far the first spaceship of this kind that was found moves each period
+            int dy;
+            std::uint64_t count;
+        };
+
+        static const unsigned defaultMaxPeriod;
+
+        static bool canTake(const Automaton& automaton); // Returns true if the rules are supported
+        static bool take(const Automaton& automaton, bool toroidal, unsigned maxPeriod, std::vector<Entry>& entries); // Sorts the objects with the most common first, returns false if the rules aren't supported
+        static const char* getKindName(Kind kind);
+};
+
+#endif
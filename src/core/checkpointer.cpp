@@ -0,0 +1,146 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "checkpointer.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include "boardfile.h"
+#include "trace.h"
+
+Checkpointer::Checkpointer():
+    generationInterval(0),
+    timeInterval(Clock::duration::zero()),
+    lastGeneration(0),
+    started(false),
+    snapshotGeneration(0),
+    pending(false),
+    stopping(false)
+{
+}
+
+Checkpointer::~Checkpointer()
+{
+    stopThread();
+}
+
+void Checkpointer::setup(const std::string& newFilename, std::uint64_t generations, float seconds)
+{
+    // The last checkpoint is finished with the old settings
+    stopThread();
+    filename = newFilename;
+    generationInterval = generations;
+    timeInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(std::max(seconds, 0.0f)));
+    started = false;
+    if (isEnabled())
+        startThread();
+}
+
+bool Checkpointer::isEnabled() const
+{
+    return (!filename.empty() && (generationInterval > 0 || timeInterval > Clock::duration::zero()));
+}
+
+bool Checkpointer::isDue(std::uint64_t generation) const
+{
+    if (!isEnabled() || !started || generation <= lastGeneration)
+        return false;
+    return ((generationInterval > 0 && generation - lastGeneration >= generationInterval) ||
+        (timeInterval > Clock::duration::zero() && Clock::now() - lastTime >= timeInterval));
+}
+
+bool Checkpointer::update(const Matrix<char>& cells, std::uint64_t generation)
+{
+    if (!isEnabled())
+        return false;
+    if (!started || generation < lastGeneration)
+    {
+        // Start counting from here, so loading or clearing the board doesn't save a checkpoint right away
+        started = true;
+        lastGeneration = generation;
+        lastTime = Clock::now();
+        return false;
+    }
+    return (isDue(generation) && save(cells, generation));
+}
+
+bool Checkpointer::save(const Matrix<char>& cells, std::uint64_t generation)
+{
+    if (!isEnabled())
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending)
+            return false; // Try again after the next generation
+        TRACE_SCOPE("Checkpointer::save");
+        // Assigning reuses the snapshot's memory when the size hasn't changed
+        snapshot = cells;
+        snapshotGeneration = generation;
+        pending = true;
+    }
+    wakeUp.notify_one();
+    started = true;
+    lastGeneration = generation;
+    lastTime = Clock::now();
+    return true;
+}
+
+void Checkpointer::finish()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    written.wait(lock, [this]{ return !pending; });
+}
+
+const std::string& Checkpointer::getFilename() const
+{
+    return filename;
+}
+
+void Checkpointer::startThread()
+{
+    stopping = false;
+    thread = std::thread(&Checkpointer::run, this);
+}
+
+void Checkpointer::stopThread()
+{
+    if (thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_one();
+        thread.join();
+    }
+}
+
+void Checkpointer::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wakeUp.wait(lock, [this]{ return pending || stopping; });
+        if (!pending)
+            break; // Only stop once the last snapshot is written
+
+        // Nothing else touches the snapshot while it is pending
+        lock.unlock();
+        {
+            TRACE_SCOPE("Checkpointer::write");
+            std::string tempFilename = filename + ".tmp";
+            bool status = BoardFile::save(tempFilename, snapshot, snapshotGeneration);
+            if (status && std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+            {
+                // Renaming over an existing file fails on some systems
+                std::remove(filename.c_str());
+                status = (std::rename(tempFilename.c_str(), filename.c_str()) == 0);
+            }
+            if (!status)
+                std::cerr << "Error: Could not save a checkpoint to \"" << filename << "\".\n";
+        }
+        lock.lock();
+        pending = false;
+        written.notify_all();
+    }
+}
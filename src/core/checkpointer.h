@@ -0,0 +1,60 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef CHECKPOINTER_H
+#define CHECKPOINTER_H
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "matrix.h"
+
+/*
+This class saves checkpoints of a board every so many generations or seconds, so a long run isn't lost after a crash.
+The cells are copied into a snapshot between generations, and the snapshot is compressed and written by a background thread.
+If the last checkpoint is still being written when the next one is due, it is tried again after the next generation,
+    so the simulation never waits for the disk.
+Checkpoints are board files (see the BoardFile class) with the generation in them, so a run can carry on from one.
+Each one is written to a temporary file first, then renamed over the last one, so a crash while writing doesn't lose it.
+*/
+class Checkpointer
+{
+    public:
+        Checkpointer();
+        ~Checkpointer();
+        void setup(const std::string& filename, std::uint64_t generations, float seconds); // 0 turns off either interval
+        bool isEnabled() const;
+        bool isDue(std::uint64_t generation) const; // Returns true if a checkpoint should be taken of this generation
+        bool update(const Matrix<char>& cells, std::uint64_t generation); // Takes a checkpoint if one is due, returns true if it did (call this after each generation)
+        bool save(const Matrix<char>& cells, std::uint64_t generation); // Takes a checkpoint now, returns false if the last one is still being written
+        void finish(); // Waits for the last checkpoint to be written
+        const std::string& getFilename() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void startThread();
+        void stopThread();
+        void run(); // The thread's main loop
+
+        std::string filename;
+        std::uint64_t generationInterval;
+        Clock::duration timeInterval;
+        std::uint64_t lastGeneration; // The generation of the last checkpoint, or when checkpointing started
+        Clock::time_point lastTime;
+        bool started; // False until the first generation is seen
+
+        std::thread thread;
+        std::mutex mutex; // Protects everything below
+        std::condition_variable wakeUp; // Signaled when there is a snapshot to write, or when stopping
+        std::condition_variable written; // Signaled when a snapshot was written
+        Matrix<char> snapshot;
+        std::uint64_t snapshotGeneration;
+        bool pending; // True when the snapshot needs to be written (or is being written)
+        bool stopping;
+};
+
+#endif
@@ -0,0 +1,389 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "cycledetector.h"
+#include <algorithm>
+#include <cstring>
+#include "trace.h"
+
+namespace
+{
+    // Odd numbers, so their powers never become 0 and they have inverses
+    const std::uint64_t columnBase = 0x9E3779B97F4A7C15ULL;
+    const std::uint64_t rowBase = 0xC2B2AE3D27D4EB4FULL;
+
+    std::uint64_t inverse(std::uint64_t value)
+    {
+        // Newton's method, each step doubles the number of correct low bits (odd numbers start with 3)
+        std::uint64_t result = value;
+        for (unsigned i = 0; i < 5; ++i)
+            result *= 2 - value * result;
+        return result;
+    }
+
+    void makePowers(std::uint64_t base, unsigned count, std::vector<std::uint64_t>& powers)
+    {
+        powers.resize(count);
+        std::uint64_t power = 1;
+        for (auto& value: powers)
+        {
+            value = power;
+            power *= base;
+        }
+    }
+
+    std::uint64_t getStateKey(char state)
+    {
+        // Scrambles the state, so states that are close together don't have related keys
+        std::uint64_t key = static_cast<unsigned char>(state) + 0x9E3779B97F4A7C15ULL;
+        key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+        return key ^ (key >> 31);
+    }
+}
+
+CycleDetector::CycleDetector():
+    historySize(0),
+    needsRebuild(true),
+    lastGeneration(0),
+    cycle(),
+    hash(0),
+    left(0),
+    top(0),
+    right(-1),
+    bottom(-1),
+    entryCount(0),
+    confirming(false),
+    candidate(),
+    confirmGeneration(0),
+    candidateLeft(0),
+    candidateTop(0),
+    pathLeft(0),
+    pathTop(0),
+    pathRight(0),
+    pathBottom(0)
+{
+}
+
+void CycleDetector::setHistorySize(unsigned generations)
+{
+    historySize = generations;
+    reset();
+}
+
+bool CycleDetector::isEnabled() const
+{
+    return (historySize > 0);
+}
+
+void CycleDetector::reset()
+{
+    needsRebuild = true;
+    cycle = Cycle();
+    entries.clear();
+    entryCount = 0;
+    entryIndexes.clear();
+    confirming = false;
+}
+
+bool CycleDetector::update(const Automaton& automaton)
+{
+    if (historySize == 0)
+        return false;
+    if (!canCycle(automaton))
+    {
+        reset();
+        return false;
+    }
+
+    TRACE_SCOPE("CycleDetector::update");
+    const Matrix<char>& cells = automaton.getCells();
+    std::uint64_t generation = automaton.getGeneration();
+    if (needsRebuild || cells.width() != previous.width() || cells.height() != previous.height())
+        rebuild(cells);
+    else
+    {
+        // Skip over the unchanged cells 8 at a time
+        const char* current = cells.data();
+        char* old = previous.data();
+        std::size_t size = cells.size();
+        for (std::size_t i = 0; i < size; )
+        {
+            std::uint64_t currentWord = 0;
+            std::uint64_t oldWord = 0;
+            if (i + 8 <= size)
+            {
+                std::memcpy(&currentWord, current + i, 8);
+                std::memcpy(&oldWord, old + i, 8);
+                if (currentWord == oldWord)
+                {
+                    i += 8;
+                    continue;
+                }
+            }
+            for (std::size_t end = std::min(i + 8, size); i < end; ++i)
+            {
+                if (current[i] != old[i])
+                {
+                    updateCell(i % cells.width(), i / cells.width(), old[i], current[i]);
+                    old[i] = current[i];
+                }
+            }
+        }
+        updateBounds();
+    }
+    lastGeneration = generation;
+
+    Entry entry{generation, hash, getShapeHash(), left, top, automaton.getPosition().blockPhase};
+    bool found = false;
+    if (confirming)
+    {
+        // Keep track of where the cells go during the period
+        pathLeft = std::min(pathLeft, left - candidateLeft);
+        pathTop = std::min(pathTop, top - candidateTop);
+        pathRight = std::max(pathRight, right - candidateLeft);
+        pathBottom = std::max(pathBottom, bottom - candidateTop);
+        if (generation >= confirmGeneration)
+        {
+            confirming = false;
+            Matrix<char> pattern;
+            copyBounds(cells, pattern);
+            found = (generation == confirmGeneration && left - candidateLeft == candidate.dx && top - candidateTop == candidate.dy &&
+                pattern.width() == candidateCells.width() && pattern.height() == candidateCells.height() &&
+                std::equal(pattern.data(), pattern.data() + pattern.size(), candidateCells.data()));
+            if (found)
+            {
+                cycle = candidate;
+                cycle.generation = generation;
+            }
+            candidateCells.clear();
+        }
+    }
+    else if (cycle.period == 0)
+    {
+        // Look for the same shape in the last few generations
+        auto match = entryIndexes.find(entry.shapeHash);
+        if (match != entryIndexes.end() && entryCount - match->second <= historySize)
+        {
+            const Entry& old = entries[match->second % historySize];
+            if (old.shapeHash == entry.shapeHash && old.blockPhase == entry.blockPhase && old.generation < generation)
+                startConfirming(cells, old);
+        }
+    }
+
+    // Add this generation to the history
+    if (entries.size() < historySize)
+        entries.push_back(entry);
+    else
+    {
+        const Entry& oldest = entries[entryCount % historySize];
+        auto oldIndex = entryIndexes.find(oldest.shapeHash);
+        if (oldIndex != entryIndexes.end() && oldIndex->second == entryCount - historySize)
+            entryIndexes.erase(oldIndex);
+        entries[entryCount % historySize] = entry;
+    }
+    entryIndexes[entry.shapeHash] = entryCount;
+    ++entryCount;
+    return found;
+}
+
+const CycleDetector::Cycle& CycleDetector::getCycle() const
+{
+    return cycle;
+}
+
+std::uint64_t CycleDetector::getHash() const
+{
+    return hash;
+}
+
+std::uint64_t CycleDetector::getShapeHash() const
+{
+    // Divide out the position of the bounding box
+    if (right < left)
+        return hash;
+    return hash * columnInverses[left] * rowInverses[top];
+}
+
+std::uint64_t CycleDetector::jump(Automaton& automaton, std::uint64_t targetGeneration, bool toroidal)
+{
+    std::uint64_t generation = automaton.getGeneration();
+    if (cycle.period == 0 || needsRebuild || generation != lastGeneration || generation >= targetGeneration)
+        return 0;
+    std::uint64_t periods = (targetGeneration - generation) / cycle.period;
+    if (periods == 0)
+        return 0;
+
+    unsigned width = automaton.width();
+    unsigned height = automaton.height();
+    if (cycle.dx != 0 || cycle.dy != 0)
+    {
+        // Blocks only line up again after moving an even number of cells
+        bool block = (automaton.getEngine() == Automaton::Block);
+        if (block && (cycle.dx % 2 != 0 || cycle.dy % 2 != 0 || (toroidal && (width % 2 != 0 || height % 2 != 0))))
+            return 0;
+
+        // Without wrapping around, the cells have to stay on the board the whole time
+        if (!toroidal)
+        {
+            auto limit = [&](int start, int pathStart, int pathEnd, int step, unsigned size)
+            {
+                if (step > 0)
+                    return static_cast<std::uint64_t>(std::max(static_cast<int>(size) - 1 - (start + pathEnd), 0) / step);
+                if (step < 0)
+                    return static_cast<std::uint64_t>(std::max(start + pathStart, 0) / -step);
+                return periods;
+            };
+            if (left + pathLeft < 0 || top + pathTop < 0 || left + pathRight >= static_cast<int>(width) || top + pathBottom >= static_cast<int>(height))
+                return 0;
+            periods = std::min(periods, limit(left, pathLeft, pathRight, cycle.dx, width));
+            periods = std::min(periods, limit(top, pathTop, pathBottom, cycle.dy, height));
+            if (periods == 0)
+                return 0;
+        }
+
+        // Move all of the cells at once
+        TRACE_SCOPE("CycleDetector::jump");
+        const Matrix<char>& cells = automaton.getCells();
+        Matrix<char> moved(width, height);
+        unsigned offsetX = static_cast<unsigned>(((static_cast<std::int64_t>(cycle.dx) * static_cast<std::int64_t>(periods % width)) % width + width) % width);
+        unsigned offsetY = static_cast<unsigned>(((static_cast<std::int64_t>(cycle.dy) * static_cast<std::int64_t>(periods % height)) % height + height) % height);
+        for (unsigned y = 0; y < height; ++y)
+            for (unsigned x = 0; x < width; ++x)
+                moved((x + offsetX) % width, (y + offsetY) % height) = cells(x, y);
+        for (unsigned y = 0; y < height; ++y)
+        {
+            for (unsigned x = 0; x < width; ++x)
+            {
+                if (moved(x, y) != cells(x, y))
+                    automaton.setCell(sf::Vector2u(x, y), moved(x, y));
+            }
+        }
+    }
+
+    // Still lifes and oscillators only need the generation to change
+    Automaton::Position position = automaton.getPosition();
+    position.generation += periods * cycle.period;
+    automaton.setPosition(position);
+    lastGeneration = position.generation;
+
+    // The cycle is still going, so keep it, but the history doesn't line up anymore
+    needsRebuild = true;
+    entries.clear();
+    entryCount = 0;
+    entryIndexes.clear();
+    return periods * cycle.period;
+}
+
+bool CycleDetector::canCycle(const Automaton& automaton)
+{
+    int engine = automaton.getEngine();
+    return ((engine == Automaton::LifeLike && automaton.isDeterministic()) || engine == Automaton::Table || engine == Automaton::Block);
+}
+
+void CycleDetector::rebuild(const Matrix<char>& cells)
+{
+    unsigned width = cells.width();
+    unsigned height = cells.height();
+    if (columnKeys.size() != width)
+    {
+        makePowers(columnBase, width, columnKeys);
+        makePowers(inverse(columnBase), width, columnInverses);
+    }
+    if (rowKeys.size() != height)
+    {
+        makePowers(rowBase, height, rowKeys);
+        makePowers(inverse(rowBase), height, rowInverses);
+    }
+    columnCounts.assign(width, 0);
+    rowCounts.assign(height, 0);
+    hash = 0;
+    for (unsigned y = 0; y < height; ++y)
+    {
+        for (unsigned x = 0; x < width; ++x)
+        {
+            if (cells(x, y) != 0)
+                updateCell(x, y, 0, cells(x, y));
+        }
+    }
+    previous = cells;
+    updateBounds();
+    needsRebuild = false;
+}
+
+void CycleDetector::updateCell(unsigned x, unsigned y, char oldState, char newState)
+{
+    if (oldState != 0)
+    {
+        hash -= getKey(x, y, oldState);
+        --columnCounts[x];
+        --rowCounts[y];
+    }
+    if (newState != 0)
+    {
+        hash += getKey(x, y, newState);
+        ++columnCounts[x];
+        ++rowCounts[y];
+    }
+}
+
+void CycleDetector::updateBounds()
+{
+    int width = columnCounts.size();
+    int height = rowCounts.size();
+    left = 0;
+    while (left < width && columnCounts[left] == 0)
+        ++left;
+    right = width - 1;
+    while (right >= left && columnCounts[right] == 0)
+        --right;
+    top = 0;
+    while (top < height && rowCounts[top] == 0)
+        ++top;
+    bottom = height - 1;
+    while (bottom >= top && rowCounts[bottom] == 0)
+        --bottom;
+
+    // An empty board has its corner at the origin
+    if (right < left || bottom < top)
+    {
+        left = top = 0;
+        right = bottom = -1;
+    }
+}
+
+std::uint64_t CycleDetector::getKey(unsigned x, unsigned y, char state) const
+{
+    return getStateKey(state) * columnKeys[x] * rowKeys[y];
+}
+
+void CycleDetector::copyBounds(const Matrix<char>& cells, Matrix<char>& pattern) const
+{
+    if (right < left)
+    {
+        pattern.clear();
+        return;
+    }
+    pattern.resize(right - left + 1, bottom - top + 1, false);
+    for (int y = top; y <= bottom; ++y)
+        std::copy(&cells(left, y), &cells(left, y) + pattern.width(), &pattern(0, y - top));
+}
+
+bool CycleDetector::startConfirming(const Matrix<char>& cells, const Entry& entry)
+{
+    candidate.period = lastGeneration - entry.generation;
+    candidate.dx = left - entry.left;
+    candidate.dy = top - entry.top;
+    if (candidate.period == 0 || (candidate.dx == 0 && candidate.dy == 0 && hash != entry.hash))
+        return false;
+    confirming = true;
+    confirmGeneration = lastGeneration + candidate.period;
+    copyBounds(cells, candidateCells);
+    candidateLeft = left;
+    candidateTop = top;
+    pathLeft = 0;
+    pathTop = 0;
+    pathRight = right - left;
+    pathBottom = bottom - top;
+    return true;
+}
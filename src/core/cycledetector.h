@@ -0,0 +1,106 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef CYCLEDETECTOR_H
+#define CYCLEDETECTOR_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "matrix.h"
+#include "automaton.h"
+
+/*
+This class finds when a board starts repeating itself, as a still life, an oscillator, or a spaceship.
+The cells are hashed Zobrist-style, where each live cell adds a key made from its state, column, and row.
+Only the cells that changed since the last generation are used to update the hash, and the live cells
+    in each row and column are counted, so the bounding box of the cells is known too.
+The column and row keys are powers of two odd numbers, so moving all of the cells multiplies the hash
+    by a known amount. Dividing that out for the corner of the bounding box gives a second hash that
+    doesn't change when the cells move, which is how spaceships are found.
+The hashes of the last few generations are kept in a table. When a hash comes up again, the cells are copied,
+    and they are compared exactly one period later, so a collision can never be reported as a cycle.
+Only deterministic rules with a fixed neighborhood are checked (not stochastic, continuous, or one-dimensional rules).
+*/
+class CycleDetector
+{
+    public:
+        // A repeating pattern that was found
+        struct Cycle
+        {
+            std::uint64_t period; // In generations, 0 when no cycle was found
+            int dx; // How far the cells move each period (0 for still lifes and oscillators)
+            int dy;
+            std::uint64_t generation; // When the cycle was confirmed
+        };
+
+        CycleDetector();
+        void setHistorySize(unsigned generations); // The longest period that can be found (0 turns it off)
+        bool isEnabled() const;
+        void reset(); // Forgets everything, call this when the cells were changed other than by a generation
+        bool update(const Automaton& automaton); // Call after each generation, returns true when a cycle was just confirmed
+        const Cycle& getCycle() const; // The cycle that was found since the last reset
+        std::uint64_t getHash() const; // Hash of the cells and where they are
+        std::uint64_t getShapeHash() const; // Hash of the cells that stays the same when they move
+        std::uint64_t jump(Automaton& automaton, std::uint64_t targetGeneration, bool toroidal); // Skips whole periods of the cycle, up to the target generation, returns the generations skipped
+
+    private:
+        // The hashes of one generation
+        struct Entry
+        {
+            std::uint64_t generation;
+            std::uint64_t hash;
+            std::uint64_t shapeHash;
+            int left; // Corner of the bounding box
+            int top;
+            unsigned blockPhase; // Block rules only repeat when the blocks line up the same way
+        };
+
+        static bool canCycle(const Automaton& automaton); // Returns true if the rules can be checked
+        void rebuild(const Matrix<char>& cells); // Hashes all of the cells from scratch
+        void updateCell(unsigned x, unsigned y, char oldState, char newState);
+        void updateBounds();
+        std::uint64_t getKey(unsigned x, unsigned y, char state) const;
+        void copyBounds(const Matrix<char>& cells, Matrix<char>& pattern) const; // Copies the cells inside of the bounding box
+        bool startConfirming(const Matrix<char>& cells, const Entry& entry);
+
+        unsigned historySize;
+        bool needsRebuild; // True when the hashes have to be made from scratch
+        std::uint64_t lastGeneration;
+        Cycle cycle;
+
+        // Hashes of the current cells
+        Matrix<char> previous; // The cells the hashes were made from
+        std::uint64_t hash;
+        std::vector<std::uint64_t> columnKeys; // Powers of the column base
+        std::vector<std::uint64_t> rowKeys;
+        std::vector<std::uint64_t> columnInverses; // Powers of the inverse of the column base
+        std::vector<std::uint64_t> rowInverses;
+        std::vector<unsigned> columnCounts; // Live cells in each column
+        std::vector<unsigned> rowCounts;
+        int left; // Bounding box of the live cells (empty when right < left)
+        int top;
+        int right;
+        int bottom;
+
+        // The last few generations
+        std::vector<Entry> entries; // Ring buffer
+        std::uint64_t entryCount; // Total entries added since the reset
+        std::unordered_map<std::uint64_t, std::uint64_t> entryIndexes; // Newest entry of each shape hash
+
+        // A repeat that is being checked
+        bool confirming;
+        Cycle candidate;
+        std::uint64_t confirmGeneration;
+        Matrix<char> candidateCells; // The cells inside of the bounding box when the repeat was found
+        int candidateLeft;
+        int candidateTop;
+
+        // Where the cells go during a period, relative to the corner of the bounding box (used when jumping)
+        int pathLeft;
+        int pathTop;
+        int pathRight;
+        int pathBottom;
+};
+
+#endif
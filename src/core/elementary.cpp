@@ -0,0 +1,231 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "elementary.h"
+#include <cstdlib>
+#include <algorithm>
+
+Elementary::Elementary():
+    totalistic(false),
+    radius(1),
+    code(0),
+    row(0)
+{
+    setFromString("W30");
+}
+
+bool Elementary::isElementaryString(const std::string& str)
+{
+    return (str.size() >= 2 && (str[0] == 'W' || str[0] == 'w' || str[0] == 'T' || str[0] == 't') &&
+            str[1] >= '0' && str[1] <= '9');
+}
+
+void Elementary::setFromString(const std::string& str)
+{
+    totalistic = (!str.empty() && (str[0] == 'T' || str[0] == 't'));
+    code = (str.size() > 1 ? std::strtoull(str.c_str() + 1, nullptr, 10) : 0);
+    radius = 1;
+    if (totalistic)
+    {
+        // The radius is optional, and comes after the code
+        std::size_t pos = str.find_first_of("Rr");
+        if (pos != std::string::npos)
+            radius = std::atoi(str.c_str() + pos + 1);
+        if (radius < 1)
+            radius = 1;
+        else if (radius > maxRadius)
+            radius = maxRadius;
+
+        // Sums go from 0 to the number of cells in the neighborhood
+        code &= (1ULL << (radius * 2 + 2)) - 1;
+        ruleString = "T" + std::to_string(code) + "/R" + std::to_string(radius);
+    }
+    else
+    {
+        code &= 255;
+        ruleString = "W" + std::to_string(code);
+    }
+    resetRow();
+}
+
+const std::string& Elementary::toString() const
+{
+    return ruleString;
+}
+
+void Elementary::resetRow()
+{
+    row = 0;
+}
+
+unsigned Elementary::getRow() const
+{
+    return row;
+}
+
+void Elementary::setRow(unsigned newRow)
+{
+    row = newRow;
+}
+
+void Elementary::step(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal, unsigned generations)
+{
+    unsigned w = rect.width;
+    unsigned h = rect.height;
+    if (w == 0 || h == 0)
+        return;
+    generations = std::max(generations, 1u);
+    row = std::min(row, h - 1);
+
+    // Pack the current generation into bits
+    unsigned words = (w + 63) / 64;
+    Row current(words, 0);
+    Row next(words, 0);
+    for (unsigned x = 0; x < w; ++x)
+        current[x / 64] |= static_cast<Word>(in(rect.left + x, rect.top + row) != 0) << (x % 64);
+
+    // Run all of the generations, only the ones that will be visible need to be kept
+    unsigned keep = std::min(generations, h);
+    history.resize(keep);
+    for (unsigned g = 0; g < generations; ++g)
+    {
+        nextRow(current, next, w, toroidal);
+        current.swap(next);
+        if (g >= generations - keep)
+            history[g % keep] = current;
+    }
+
+    // Scroll the old rows up if the new ones don't fit below the current row
+    unsigned lastRow = row + generations;
+    unsigned scroll = (lastRow >= h ? lastRow - (h - 1) : 0);
+    for (unsigned y = 0; y < h; ++y)
+    {
+        unsigned tapeRow = y + scroll; // Row as if the board never scrolled
+        if (tapeRow > row && tapeRow <= lastRow)
+        {
+            // Unpack one of the new generations
+            const Row& bits = history[(tapeRow - row - 1) % keep];
+            for (unsigned x = 0; x < w; ++x)
+                out(rect.left + x, rect.top + y) = (bits[x / 64] >> (x % 64)) & 1;
+        }
+        else
+        {
+            // Older rows and the rows below the new ones stay the same
+            std::copy(in.data() + (rect.top + tapeRow) * in.width() + rect.left,
+                      in.data() + (rect.top + tapeRow) * in.width() + rect.left + w,
+                      out.data() + (rect.top + y) * out.width() + rect.left);
+        }
+    }
+    row = std::min(lastRow, h - 1);
+}
+
+void Elementary::nextRow(const Row& current, Row& next, unsigned width, bool toroidal) const
+{
+    unsigned words = current.size();
+    unsigned neighbors = radius * 2 + 1;
+    shifted.resize(neighbors);
+    for (unsigned i = 0; i < neighbors; ++i)
+        shiftRow(current, shifted[i], width, static_cast<int>(i) - static_cast<int>(radius), toroidal);
+
+    if (!totalistic)
+    {
+        // Check each of the 8 neighborhoods that turn into a live cell, left neighbor is the highest bit
+        const Row& left = shifted[0];
+        const Row& right = shifted[2];
+        for (unsigned j = 0; j < words; ++j)
+        {
+            Word result = 0;
+            for (unsigned n = 0; n < 8; ++n)
+            {
+                if ((code >> n) & 1)
+                {
+                    result |= ((n & 4) ? left[j] : ~left[j]) &
+                              ((n & 2) ? current[j] : ~current[j]) &
+                              ((n & 1) ? right[j] : ~right[j]);
+                }
+            }
+            next[j] = result;
+        }
+    }
+    else
+    {
+        // Count the live cells with a bit-sliced adder, so each bit of a word has its own counter
+        unsigned planes = 1;
+        while ((1u << planes) <= neighbors)
+            ++planes;
+        counts.resize(planes);
+        for (auto& plane: counts)
+            plane.assign(words, 0);
+        for (unsigned i = 0; i < neighbors; ++i)
+        {
+            for (unsigned j = 0; j < words; ++j)
+            {
+                Word carry = shifted[i][j];
+                for (unsigned k = 0; k < planes && carry; ++k)
+                {
+                    Word overflow = counts[k][j] & carry;
+                    counts[k][j] ^= carry;
+                    carry = overflow;
+                }
+            }
+        }
+
+        // Then check each count that turns into a live cell
+        for (unsigned j = 0; j < words; ++j)
+        {
+            Word result = 0;
+            for (unsigned n = 0; n <= neighbors; ++n)
+            {
+                if ((code >> n) & 1)
+                {
+                    Word match = ~Word(0);
+                    for (unsigned k = 0; k < planes; ++k)
+                        match &= (((n >> k) & 1) ? counts[k][j] : ~counts[k][j]);
+                    result |= match;
+                }
+            }
+            next[j] = result;
+        }
+    }
+
+    // Cells past the width must stay dead, since they get shifted in next time
+    if (width % 64)
+        next.back() &= (Word(1) << (width % 64)) - 1;
+}
+
+void Elementary::shiftRow(const Row& current, Row& shifted, unsigned width, int offset, bool toroidal) const
+{
+    unsigned words = current.size();
+    shifted.resize(words);
+    unsigned k = std::abs(offset);
+    if (offset == 0)
+        shifted = current;
+    else if (offset > 0)
+    {
+        // Cells to the right are in the higher bits
+        for (unsigned j = 0; j < words; ++j)
+            shifted[j] = (current[j] >> k) | (j + 1 < words ? current[j + 1] << (64 - k) : 0);
+    }
+    else
+    {
+        for (unsigned j = 0; j < words; ++j)
+            shifted[j] = (current[j] << k) | (j > 0 ? current[j - 1] >> (64 - k) : 0);
+        if (width % 64)
+            shifted.back() &= (Word(1) << (width % 64)) - 1;
+    }
+
+    // Wrap the few cells that were shifted past the edges
+    if (toroidal && offset != 0)
+    {
+        unsigned first = (offset > 0 ? (k < width ? width - k : 0) : 0);
+        unsigned last = (offset > 0 ? width : std::min(k, width));
+        for (unsigned x = first; x < last; ++x)
+        {
+            int source = (static_cast<int>(x) + offset) % static_cast<int>(width);
+            if (source < 0)
+                source += width;
+            Word bit = (current[source / 64] >> (source % 64)) & 1;
+            shifted[x / 64] = (shifted[x / 64] & ~(Word(1) << (x % 64))) | (bit << (x % 64));
+        }
+    }
+}
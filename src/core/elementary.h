@@ -0,0 +1,60 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef ELEMENTARY_H
+#define ELEMENTARY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <SFML/Graphics/Rect.hpp>
+#include "matrix.h"
+
+/*
+This class simulates one-dimensional cellular automata with two states,
+    and draws them as a space-time diagram where each generation is the next row of the board.
+The current generation starts on the top row, and once the bottom row is reached the board scrolls up.
+There are two kinds of rule strings:
+    "W30" is one of Wolfram's elementary rules from 0 to 255, which use the cell and its two neighbors.
+    "T20/R2" is a totalistic rule with a radius from 1 to 15, where bit N of the code is the new state
+        of a cell when N cells are live within the radius (including the cell itself).
+Rows are packed into 64-bit words, so each row is computed with a few shifts and bitwise operations per word.
+*/
+class Elementary
+{
+    public:
+        Elementary();
+        static bool isElementaryString(const std::string& str); // Returns true if the string is meant for this class
+        void setFromString(const std::string& str); // Sets the rules from a rule string
+        const std::string& toString() const; // Returns the rules in the same string format as above
+        void resetRow(); // Starts the next generation from the top row again
+        unsigned getRow() const; // The row of the current generation
+        void setRow(unsigned newRow);
+
+        // Writes the next generations of the cells in rect into out, scrolling up when the bottom is reached
+        // Only the row of the current generation is read from in
+        // Toroidal wraps around the left and right edges of rect, otherwise cells outside of the board are dead
+        void step(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal, unsigned generations = 1);
+
+        static const unsigned maxRadius = 15;
+
+    private:
+        using Word = std::uint64_t;
+        using Row = std::vector<Word>;
+
+        void nextRow(const Row& current, Row& next, unsigned width, bool toroidal) const;
+        void shiftRow(const Row& current, Row& shifted, unsigned width, int offset, bool toroidal) const; // shifted[x] = current[x + offset]
+
+        bool totalistic;
+        unsigned radius;
+        std::uint64_t code; // Wolfram's rule number, or the totalistic code
+        std::string ruleString;
+        unsigned row; // Row of the current generation, relative to the top of the area
+
+        // Temporary rows, kept around to avoid allocating on every generation
+        mutable std::vector<Row> shifted;
+        mutable std::vector<Row> counts;
+        std::vector<Row> history; // Ring of the newest generations
+};
+
+#endif
@@ -0,0 +1,182 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "lenia.h"
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+
+Lenia::Lenia():
+    radius(0),
+    kernelChanged(true)
+{
+    setFromString("Lenia");
+}
+
+bool Lenia::isLeniaString(const std::string& str)
+{
+    return (str.size() >= 5 && (str.compare(0, 5, "Lenia") == 0 || str.compare(0, 5, "lenia") == 0));
+}
+
+void Lenia::setFromString(const std::string& str)
+{
+    // Defaults are for the "Orbium" glider
+    unsigned newRadius = 13;
+    growthCenter = 0.15f;
+    growthWidth = 0.015f;
+    timeScale = 10.0f;
+
+    // Read each "/X123" parameter after the name
+    std::istringstream stream(str);
+    std::string token;
+    std::getline(stream, token, '/');
+    while (std::getline(stream, token, '/'))
+    {
+        if (token.size() >= 2)
+        {
+            double value = std::atof(token.c_str() + 1);
+            switch (token[0])
+            {
+                case 'R':
+                case 'r':
+                    newRadius = std::max(1, static_cast<int>(value));
+                    break;
+
+                case 'M':
+                case 'm':
+                    growthCenter = value;
+                    break;
+
+                case 'S':
+                case 's':
+                    if (value > 0)
+                        growthWidth = value;
+                    break;
+
+                case 'T':
+                case 't':
+                    if (value > 0)
+                        timeScale = value;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+    if (newRadius != radius)
+        kernelChanged = true;
+    radius = newRadius;
+
+    std::ostringstream out;
+    out << "Lenia/R" << radius << "/M" << growthCenter << "/S" << growthWidth << "/T" << timeScale;
+    ruleString = out.str();
+}
+
+const std::string& Lenia::toString() const
+{
+    return ruleString;
+}
+
+void Lenia::resize(unsigned width, unsigned height)
+{
+    if (width != field.width() || height != field.height())
+    {
+        field.resize(width, height);
+        kernelChanged = true;
+    }
+}
+
+unsigned Lenia::width() const
+{
+    return field.width();
+}
+
+unsigned Lenia::height() const
+{
+    return field.height();
+}
+
+float& Lenia::operator()(unsigned x, unsigned y)
+{
+    return field(x, y);
+}
+
+float Lenia::operator()(unsigned x, unsigned y) const
+{
+    return field(x, y);
+}
+
+void Lenia::clear()
+{
+    std::fill(field.data(), field.data() + field.size(), 0.0f);
+}
+
+void Lenia::step()
+{
+    if (field.size() == 0)
+        return;
+    updateKernel();
+
+    // Convolve the field with the kernel: multiply the spectra, then transform back
+    fft.forward(field.data(), fieldSpectrum.data());
+    for (unsigned i = 0; i < fieldSpectrum.size(); ++i)
+    {
+        const FFT::Complex& a = fieldSpectrum[i];
+        const FFT::Complex& b = kernelSpectrum[i];
+        fieldSpectrum[i] = FFT::Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+    }
+    fft.inverse(fieldSpectrum.data(), potential.data());
+
+    // Grow or shrink each cell based on its neighborhood
+    float* cells = field.data();
+    float deltaTime = 1.0f / timeScale;
+    for (unsigned i = 0; i < field.size(); ++i)
+        cells[i] = std::min(std::max(cells[i] + deltaTime * growth(potential[i]), 0.0f), 1.0f);
+}
+
+void Lenia::updateKernel()
+{
+    if (kernelChanged)
+    {
+        unsigned w = field.width();
+        unsigned h = field.height();
+        fft.setSize(w, h);
+        potential.resize(field.size());
+        fieldSpectrum.resize(h * fft.spectrumWidth());
+        kernelSpectrum.resize(fieldSpectrum.size());
+
+        // Build a smooth ring around the origin, wrapping around the edges,
+        // which is then normalized so the potential stays between 0 and 1
+        std::vector<float> kernel(field.size(), 0.0f);
+        int r = std::min<int>(radius, std::max<int>(1, std::min(w, h) / 2 - 1));
+        double total = 0;
+        for (int dy = -r; dy <= r; ++dy)
+        {
+            for (int dx = -r; dx <= r; ++dx)
+            {
+                double distance = std::sqrt(static_cast<double>(dx * dx + dy * dy)) / r;
+                if (distance > 0 && distance < 1)
+                {
+                    double value = std::exp(4.0 - 1.0 / (distance * (1.0 - distance)));
+                    unsigned x = (dx + static_cast<int>(w)) % w;
+                    unsigned y = (dy + static_cast<int>(h)) % h;
+                    kernel[y * w + x] += value;
+                    total += value;
+                }
+            }
+        }
+        if (total > 0)
+            for (float& value: kernel)
+                value /= total;
+        fft.forward(kernel.data(), kernelSpectrum.data());
+        kernelChanged = false;
+    }
+}
+
+float Lenia::growth(float potential) const
+{
+    float distance = (potential - growthCenter) / growthWidth;
+    return 2.0f * std::exp(-distance * distance / 2.0f) - 1.0f;
+}
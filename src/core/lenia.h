@@ -0,0 +1,62 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef LENIA_H
+#define LENIA_H
+
+#include <string>
+#include <vector>
+#include "matrix.h"
+#include "fft.h"
+
+/*
+This class simulates a continuous cellular automaton, like Lenia or SmoothLife.
+Each cell holds a value from 0 to 1 instead of being dead or live.
+Every step, the field is convolved with a large ring shaped kernel, and the result is passed
+    through a growth function and added back to the cells.
+The convolution is done with FFTs, so the cost does not depend on the kernel radius.
+The board always wraps around, since the convolution is circular.
+The rules can be set from a string like "Lenia/R13/M0.15/S0.015/T10", where:
+    R is the kernel radius in cells
+    M and S are the center and width of the growth function
+    T is the number of steps it takes to go from 0 to 1
+*/
+class Lenia
+{
+    public:
+        Lenia();
+        static bool isLeniaString(const std::string& str); // Returns true if the string is meant for this class
+        void setFromString(const std::string& str); // Sets the parameters from a rule string
+        const std::string& toString() const; // Returns the parameters in the same string format as above
+
+        // Field size and access
+        void resize(unsigned width, unsigned height);
+        unsigned width() const;
+        unsigned height() const;
+        float& operator()(unsigned x, unsigned y);
+        float operator()(unsigned x, unsigned y) const;
+        void clear();
+
+        void step(); // Runs a single step on the entire field
+
+    private:
+        void updateKernel(); // Recalculates the kernel spectrum if the size or radius changed
+        float growth(float potential) const;
+
+        // Parameters
+        unsigned radius;
+        float growthCenter;
+        float growthWidth;
+        float timeScale;
+        std::string ruleString;
+
+        // Field and convolution
+        Matrix<float> field;
+        std::vector<float> potential;
+        RealFFT2D fft;
+        std::vector<FFT::Complex> kernelSpectrum;
+        std::vector<FFT::Complex> fieldSpectrum;
+        bool kernelChanged;
+};
+
+#endif
@@ -0,0 +1,191 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "margolus.h"
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+
+Margolus::Margolus():
+    reversible(true),
+    phase(0)
+{
+    setFromString("MS,D0;8;4;3;2;5;9;7;1;6;10;11;12;13;14;15"); // Billiard ball machine
+}
+
+bool Margolus::isMargolusString(const std::string& str)
+{
+    return (str.size() >= 3 && (str[0] == 'M' || str[0] == 'm') && (str[1] == 'S' || str[1] == 's') && str[2] == ',');
+}
+
+void Margolus::setFromString(const std::string& str)
+{
+    // Read the table after the "D"
+    unsigned newTable[16];
+    unsigned count = 0;
+    std::size_t start = str.find_first_of("Dd");
+    if (start != std::string::npos)
+    {
+        std::istringstream stream(str.substr(start + 1));
+        std::string token;
+        while (std::getline(stream, token, ';') && count < 16)
+        {
+            int value = std::atoi(token.c_str());
+            if (value < 0 || value > 15)
+                break;
+            newTable[count++] = value;
+        }
+    }
+
+    // Only use complete tables, otherwise nothing changes
+    for (unsigned i = 0; i < 16; ++i)
+        table[i] = (count == 16 ? newTable[i] : i);
+
+    std::ostringstream out;
+    out << "MS,D";
+    for (unsigned i = 0; i < 16; ++i)
+        out << (i > 0 ? ";" : "") << table[i];
+    ruleString = out.str();
+    resetPhase();
+    updateChanges();
+}
+
+const std::string& Margolus::toString() const
+{
+    return ruleString;
+}
+
+bool Margolus::isReversible() const
+{
+    return reversible;
+}
+
+void Margolus::resetPhase()
+{
+    phase = 0;
+}
+
+unsigned Margolus::getPhase() const
+{
+    return phase;
+}
+
+void Margolus::setPhase(unsigned newPhase)
+{
+    phase = newPhase & 1;
+}
+
+void Margolus::step(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal)
+{
+    apply(in, out, rect, toroidal, phase, forwardChanges);
+    phase ^= 1;
+}
+
+bool Margolus::stepBack(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal)
+{
+    // Undo the last generation by using the inverse table on the same blocks
+    if (!reversible)
+        return false;
+    phase ^= 1;
+    apply(in, out, rect, toroidal, phase, backwardChanges);
+    return true;
+}
+
+void Margolus::updateChanges()
+{
+    // Find the inverse table, which only exists if each block maps to a different block
+    bool used[16] = {false};
+    reversible = true;
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        if (used[table[i]])
+            reversible = false;
+        used[table[i]] = true;
+        inverse[table[i]] = i;
+    }
+
+    // Only the blocks that change need to be checked for
+    forwardChanges.clear();
+    backwardChanges.clear();
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        if (table[i] != i)
+            forwardChanges.push_back(Change{i, i ^ table[i]});
+        if (reversible && inverse[i] != i)
+            backwardChanges.push_back(Change{i, i ^ inverse[i]});
+    }
+}
+
+void Margolus::apply(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal,
+                     unsigned offset, const std::vector<Change>& changes) const
+{
+    unsigned w = rect.width;
+    unsigned h = rect.height;
+
+    // Cells that aren't part of a complete block stay the same
+    for (unsigned y = rect.top; y < rect.top + h; ++y)
+        std::copy(in.data() + y * in.width() + rect.left, in.data() + y * in.width() + rect.left + w,
+                  out.data() + y * out.width() + rect.left);
+    if (w < 2 || h < 2)
+        return;
+
+    // Blocks can only wrap around when they tile the area exactly
+    bool wrapX = (toroidal && w % 2 == 0);
+    bool wrapY = (toroidal && h % 2 == 0);
+    unsigned blockColumns = (wrapX ? w / 2 : (w - offset) / 2);
+    unsigned blockRows = (wrapY ? h / 2 : (h - offset) / 2);
+    unsigned bits = blockColumns * 2;
+    std::vector<Word> top((bits + 63) / 64);
+    std::vector<Word> bottom(top.size());
+
+    for (unsigned row = 0; row < blockRows; ++row)
+    {
+        unsigned y0 = rect.top + (offset + row * 2) % h;
+        unsigned y1 = rect.top + (offset + row * 2 + 1) % h;
+
+        // Pack both rows of blocks into bits
+        std::fill(top.begin(), top.end(), 0);
+        std::fill(bottom.begin(), bottom.end(), 0);
+        for (unsigned i = 0, x = offset; i < bits; ++i, ++x)
+        {
+            if (x >= w)
+                x -= w;
+            top[i / 64] |= static_cast<Word>(in(rect.left + x, y0) != 0) << (i % 64);
+            bottom[i / 64] |= static_cast<Word>(in(rect.left + x, y1) != 0) << (i % 64);
+        }
+
+        for (unsigned i = 0; i < top.size(); ++i)
+            applyToWords(top[i], bottom[i], changes);
+
+        // Unpack the new cells
+        for (unsigned i = 0, x = offset; i < bits; ++i, ++x)
+        {
+            if (x >= w)
+                x -= w;
+            out(rect.left + x, y0) = (top[i / 64] >> (i % 64)) & 1;
+            out(rect.left + x, y1) = (bottom[i / 64] >> (i % 64)) & 1;
+        }
+    }
+}
+
+void Margolus::applyToWords(Word& top, Word& bottom, const std::vector<Change>& changes) const
+{
+    // Line up the four cells of each block on the even bits
+    const Word even = 0x5555555555555555ULL;
+    Word cells[4] = {top & even, (top >> 1) & even, bottom & even, (bottom >> 1) & even};
+    Word flips[4] = {0, 0, 0, 0};
+
+    // Find every block that matches an entry of the table, and flip the cells that change
+    for (const Change& change: changes)
+    {
+        Word match = even;
+        for (unsigned i = 0; i < 4; ++i)
+            match &= (((change.block >> i) & 1) ? cells[i] : ~cells[i]);
+        for (unsigned i = 0; i < 4; ++i)
+            if ((change.flips >> i) & 1)
+                flips[i] |= match;
+    }
+
+    top ^= flips[0] | (flips[1] << 1);
+    bottom ^= flips[2] | (flips[3] << 1);
+}
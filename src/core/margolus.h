@@ -0,0 +1,63 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef MARGOLUS_H
+#define MARGOLUS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <SFML/Graphics/Rect.hpp>
+#include "matrix.h"
+
+/*
+This class simulates block cellular automata with the Margolus neighborhood,
+    like the billiard ball machine or critters.
+The board is split into 2x2 blocks, which are shifted by one cell diagonally every other generation.
+Each block is replaced using a table of 16 entries, where the cells are weighted like this:
+    1 2
+    4 8
+The rules can be set from a string in MCell's format, like "MS,D0;8;4;3;2;5;9;7;1;6;10;11;12;13;14;15".
+Rows are packed into 64-bit words, so each word operation updates 32 blocks at once.
+If the table is a permutation, the rules are reversible and can also be run backwards.
+*/
+class Margolus
+{
+    public:
+        Margolus();
+        static bool isMargolusString(const std::string& str); // Returns true if the string is meant for this class
+        void setFromString(const std::string& str); // Sets the rules from a rule string
+        const std::string& toString() const; // Returns the rules in the same string format as above
+        bool isReversible() const; // Returns true if the table is a permutation
+        void resetPhase(); // Starts the next generation with the blocks at the top left corner
+        unsigned getPhase() const; // Which offset the blocks of the next generation use (0 or 1)
+        void setPhase(unsigned newPhase);
+
+        // Writes the next (or previous) generation of the cells in rect into out
+        // Toroidal wraps blocks around the edges of rect when its size is even, otherwise edge cells are left alone
+        void step(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal);
+        bool stepBack(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal);
+
+    private:
+        using Word = std::uint64_t;
+        struct Change
+        {
+            unsigned block; // The block that changes
+            unsigned flips; // Which cells of the block flip
+        };
+
+        void updateChanges();
+        void apply(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal,
+                   unsigned offset, const std::vector<Change>& changes) const;
+        void applyToWords(Word& top, Word& bottom, const std::vector<Change>& changes) const;
+
+        unsigned table[16];
+        unsigned inverse[16];
+        bool reversible;
+        std::vector<Change> forwardChanges;
+        std::vector<Change> backwardChanges;
+        unsigned phase; // Offset of the blocks for the next generation
+        std::string ruleString;
+};
+
+#endif
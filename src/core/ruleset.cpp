@@ -0,0 +1,136 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "ruleset.h"
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+
+RuleSet::RuleSet():
+    chances{1.0f, 1.0f},
+    updateChance(1.0f)
+{
+    clear();
+}
+
+void RuleSet::setFromString(const std::string& str)
+{
+    clear();
+    chances[Birth] = 1.0f;
+    chances[Survival] = 1.0f;
+    updateChance = 1.0f;
+    unsigned type = Survival;
+    std::size_t chancesStart = str.find(':');
+    for (char c: str.substr(0, chancesStart))
+    {
+        if (c == 'B' || c == 'b')
+            type = Birth;
+        else if (c == 'S' || c == 's')
+            type = Survival;
+        else if (c == '/' || c == '\\')
+            ++type %= 2;
+        else if (c >= '0' && c <= '8')
+            rules[type][c - '0'] = true;
+    }
+
+    // Read the chances, which look like B0.9,S0.95,A0.5
+    if (chancesStart != std::string::npos)
+    {
+        std::istringstream stream(str.substr(chancesStart + 1));
+        std::string token;
+        while (std::getline(stream, token, ','))
+        {
+            if (token.size() < 2)
+                continue;
+            float chance = std::min(std::max(static_cast<float>(std::atof(token.c_str() + 1)), 0.0f), 1.0f);
+            char c = token[0];
+            if (c == 'B' || c == 'b')
+                chances[Birth] = chance;
+            else if (c == 'S' || c == 's')
+                chances[Survival] = chance;
+            else if (c == 'A' || c == 'a')
+                updateChance = chance;
+        }
+    }
+    rulesChanged = true;
+}
+
+const std::string& RuleSet::toString() const
+{
+    generateRuleString();
+    return ruleString;
+}
+
+bool RuleSet::getRule(unsigned type, unsigned count) const
+{
+    return rules[type][count];
+}
+
+void RuleSet::setRule(unsigned type, unsigned count, bool state)
+{
+    rules[type][count] = state;
+    rulesChanged = true;
+}
+
+void RuleSet::clear()
+{
+    for (auto& ruleSet: rules)
+        for (bool& rule: ruleSet)
+            rule = false;
+    rulesChanged = true;
+}
+
+float RuleSet::getChance(unsigned type) const
+{
+    return chances[type];
+}
+
+float RuleSet::getUpdateChance() const
+{
+    return updateChance;
+}
+
+bool RuleSet::isStochastic() const
+{
+    return (chances[Birth] < 1.0f || chances[Survival] < 1.0f || updateChance < 1.0f);
+}
+
+void RuleSet::generateRuleString() const
+{
+    if (rulesChanged)
+    {
+        ruleString = "B";
+        for (unsigned type = 0; type <= 1; ++type)
+        {
+            unsigned num = 0;
+            for (bool rule: rules[type])
+            {
+                if (rule)
+                    ruleString += static_cast<char>(num + '0');
+                ++num;
+            }
+            if (type == Birth)
+                ruleString += "/S";
+        }
+
+        // Only add the chances that aren't 1
+        if (isStochastic())
+        {
+            std::ostringstream stream;
+            const char* separator = ":";
+            const char names[] = {'B', 'S', 'A'};
+            const float values[] = {chances[Birth], chances[Survival], updateChance};
+            for (unsigned i = 0; i < 3; ++i)
+            {
+                if (values[i] < 1.0f)
+                {
+                    stream << separator << names[i] << values[i];
+                    separator = ",";
+                }
+            }
+            ruleString += stream.str();
+        }
+        rulesChanged = false;
+    }
+}
+
@@ -12,6 +12,9 @@ The rules can be set from a string in the S/B (like 3/23) or B{list}/S{list] for
 The rules can also be set from binary bits with the setRule function.
 You can use the getRule function to determine the new state of a cell by passing in the
     the current cell state (type), and live neighbor count (count).
+The rules can also be stochastic, by adding chances from 0 to 1 after a colon, like B3/S23:B0.9,S0.95,A0.5
+    B is the chance of a birth happening, S is the chance of a cell surviving,
+    and A is the chance of a cell being updated at all (so only some of the cells update each generation).
 */
 class RuleSet
 {
@@ -23,13 +26,18 @@ class RuleSet
         bool getRule(unsigned type, unsigned count) const; // Returns a rule
         void setRule(unsigned type, unsigned count, bool state); // Sets a rule
         void clear(); // Sets all of the rules to false
-        
+        float getChance(unsigned type) const; // Returns the chance of a birth or survival rule happening
+        float getUpdateChance() const; // Returns the chance of a cell being updated
+        bool isStochastic() const; // Returns true if any of the chances are less than 1
+
         enum {Birth = 0, Survival = 1}; // The rule types
 
     private:
         void generateRuleString() const; // Generates a new string only if needed
 
         bool rules[2][9]; // Holds all of the rules, you can plug in the cell state and live neighbor count to get the new state
+        float chances[2]; // Chances of the birth and survival rules happening
+        float updateChance;
         mutable bool rulesChanged; // Used so that the string doesn't have to be re-generated each time the rules change
         mutable std::string ruleString; // Stores the string version of the rules
 };
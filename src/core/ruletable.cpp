@@ -0,0 +1,555 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "ruletable.h"
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <functional>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+
+const char* RuleTable::directory = "data/rules/";
+
+namespace
+{
+    // Removes comments and surrounding whitespace
+    std::string cleanLine(const std::string& line)
+    {
+        std::string result = line.substr(0, line.find('#'));
+        std::size_t first = result.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos)
+            return "";
+        std::size_t last = result.find_last_not_of(" \t\r\n");
+        return result.substr(first, last - first + 1);
+    }
+
+    bool isNumber(const std::string& str)
+    {
+        return (!str.empty() && std::all_of(str.begin(), str.end(), [](char c){ return std::isdigit(static_cast<unsigned char>(c)); }));
+    }
+
+    // Splits a list like "a, 1,b" into trimmed tokens
+    std::vector<std::string> splitList(const std::string& str)
+    {
+        std::vector<std::string> tokens;
+        std::istringstream stream(str);
+        std::string token;
+        while (std::getline(stream, token, ','))
+            tokens.push_back(cleanLine(token));
+        return tokens;
+    }
+}
+
+RuleTable::RuleTable():
+    states(2),
+    permute(false),
+    root(0)
+{
+}
+
+bool RuleTable::isRuleTableString(const std::string& str)
+{
+    return (!str.empty() && str[0] == '@');
+}
+
+bool RuleTable::loadFromString(const std::string& str)
+{
+    std::string tableName = str.substr(isRuleTableString(str) ? 1 : 0);
+    if (tableName.empty())
+        return false;
+    // Names can also be paths to a .rule file
+    std::string filename = tableName;
+    if (filename.find(".rule") == std::string::npos)
+        filename = directory + tableName + ".rule";
+    return loadFromFile(filename);
+}
+
+bool RuleTable::loadFromFile(const std::string& filename)
+{
+    std::ifstream file(filename.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Could not open rule table \"" << filename << "\".\n";
+        return false;
+    }
+
+    // Parse into a temporary table, so the current one stays usable if anything fails
+    RuleTable table;
+    if (!table.parseTable(file))
+    {
+        std::cerr << "Error: Could not load rule table \"" << filename << "\".\n";
+        return false;
+    }
+    if (table.name.empty())
+    {
+        // Use the filename without the directory and extension
+        std::size_t start = filename.find_last_of("/\\");
+        table.name = filename.substr(start == std::string::npos ? 0 : start + 1);
+        table.name = table.name.substr(0, table.name.find(".rule"));
+    }
+    table.ruleString = "@" + table.name;
+    table.compile();
+    *this = table;
+    return true;
+}
+
+const std::string& RuleTable::toString() const
+{
+    return ruleString;
+}
+
+unsigned RuleTable::getStates() const
+{
+    return states;
+}
+
+const std::vector<std::string>& RuleTable::getColors() const
+{
+    return colors;
+}
+
+void RuleTable::step(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal) const
+{
+    unsigned inputCount = offsets.size();
+    if (tree.empty() || rect.width < 3 || rect.height < 3)
+        return;
+
+    // States the table doesn't know about are treated as dead
+    unsigned char validState[256];
+    for (unsigned i = 0; i < 256; ++i)
+        validState[i] = (i < states ? i : 0);
+
+    // Neighbor offsets within the array, for cells that aren't on an edge
+    std::vector<int> deltas;
+    for (const auto& offset: offsets)
+        deltas.push_back(offset.y * static_cast<int>(in.width()) + offset.x);
+
+    const char* cells = in.data();
+    unsigned right = rect.left + rect.width;
+    unsigned bottom = rect.top + rect.height;
+    for (unsigned y = rect.top; y < bottom; ++y)
+    {
+        bool edgeRow = (y == rect.top || y == bottom - 1);
+        for (unsigned x = rect.left; x < right; ++x)
+        {
+            unsigned node = root;
+            if (!edgeRow && x != rect.left && x != right - 1)
+            {
+                const char* cell = cells + y * in.width() + x;
+                for (unsigned i = 0; i < inputCount; ++i)
+                    node = tree[node + validState[static_cast<unsigned char>(cell[deltas[i]])]];
+            }
+            else
+            {
+                for (unsigned i = 0; i < inputCount; ++i)
+                {
+                    int neighborX = static_cast<int>(x) + offsets[i].x;
+                    int neighborY = static_cast<int>(y) + offsets[i].y;
+                    unsigned char state = 0;
+                    if (toroidal)
+                    {
+                        // Wrap around the edges of the simulated area
+                        if (neighborX < static_cast<int>(rect.left))
+                            neighborX = right - 1;
+                        else if (neighborX >= static_cast<int>(right))
+                            neighborX = rect.left;
+                        if (neighborY < static_cast<int>(rect.top))
+                            neighborY = bottom - 1;
+                        else if (neighborY >= static_cast<int>(bottom))
+                            neighborY = rect.top;
+                        state = in(neighborX, neighborY);
+                    }
+                    else if (neighborX >= 0 && neighborY >= 0 &&
+                             neighborX < static_cast<int>(in.width()) && neighborY < static_cast<int>(in.height()))
+                        state = in(neighborX, neighborY);
+                    node = tree[node + validState[state]];
+                }
+            }
+            out(x, y) = static_cast<char>(node);
+        }
+    }
+}
+
+bool RuleTable::parseTable(std::istream& stream)
+{
+    enum {Other, Rule, Table, Colors};
+    int section = Other;
+    bool foundTable = false;
+    std::map<std::string, Mask> variables;
+    std::string line;
+    setNeighborhood("Moore");
+    setSymmetries("none");
+    while (std::getline(stream, line))
+    {
+        line = cleanLine(line);
+        if (line.empty())
+            continue;
+        if (line[0] == '@')
+        {
+            // Start of a new section
+            std::string sectionName = line.substr(0, line.find_first_of(" \t"));
+            if (sectionName == "@RULE")
+            {
+                section = Rule;
+                name = cleanLine(line.substr(sectionName.size()));
+            }
+            else if (sectionName == "@TABLE")
+            {
+                section = Table;
+                foundTable = true;
+            }
+            else if (sectionName == "@COLORS")
+                section = Colors;
+            else if (sectionName == "@TREE")
+                return false; // Rule trees are not supported
+            else
+                section = Other;
+        }
+        else if (section == Table)
+        {
+            std::size_t colon = line.find(':');
+            if (line.compare(0, 4, "var ") == 0)
+            {
+                if (!parseVariable(line, variables))
+                    return false;
+            }
+            else if (colon != std::string::npos)
+            {
+                std::string key = cleanLine(line.substr(0, colon));
+                std::string value = cleanLine(line.substr(colon + 1));
+                if (key == "n_states")
+                {
+                    states = std::atoi(value.c_str());
+                    if (states < 2 || states > maxStates)
+                        return false;
+                }
+                else if (key == "neighborhood")
+                {
+                    if (!setNeighborhood(value))
+                        return false;
+                }
+                else if (key == "symmetries")
+                {
+                    if (!setSymmetries(value))
+                        return false;
+                }
+            }
+            else if (!parseTransition(line, variables))
+                return false;
+        }
+        else if (section == Colors)
+            parseColor(line);
+    }
+    return foundTable;
+}
+
+bool RuleTable::setNeighborhood(const std::string& name)
+{
+    // Offsets are in the same order as the transitions, starting with the center
+    offsets.clear();
+    offsets.emplace_back(0, 0);
+    if (name == "Moore")
+    {
+        int moore[8][2] = {{0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}};
+        for (auto& offset: moore)
+            offsets.emplace_back(offset[0], offset[1]);
+    }
+    else if (name == "vonNeumann")
+    {
+        int vonNeumann[4][2] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+        for (auto& offset: vonNeumann)
+            offsets.emplace_back(offset[0], offset[1]);
+    }
+    else if (name == "hexagonal")
+    {
+        int hexagonal[6][2] = {{0, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 0}, {-1, -1}};
+        for (auto& offset: hexagonal)
+            offsets.emplace_back(offset[0], offset[1]);
+    }
+    else if (name == "oneDimensional")
+    {
+        offsets.emplace_back(-1, 0);
+        offsets.emplace_back(1, 0);
+    }
+    else
+        return false;
+    return setSymmetries("none");
+}
+
+bool RuleTable::setSymmetries(const std::string& name)
+{
+    // The neighbors of every neighborhood are listed in a cycle around the center,
+    // so rotations and reflections are just shifts and reversals of the indexes
+    unsigned count = offsets.size() - 1;
+    std::vector<unsigned> identity(count);
+    for (unsigned i = 0; i < count; ++i)
+        identity[i] = i;
+    symmetries.assign(1, identity);
+    permute = false;
+
+    if (name == "none")
+        return true;
+    if (name == "permute")
+    {
+        permute = true;
+        return true;
+    }
+
+    bool reflect = (name.find("reflect") != std::string::npos);
+    unsigned rotations = 1;
+    if (name.compare(0, 6, "rotate") == 0)
+    {
+        rotations = std::atoi(name.c_str() + 6);
+        if (rotations == 0 || count % rotations != 0 || count == 2)
+            return false;
+    }
+    else if (name != "reflect" && name != "reflect_horizontal")
+        return false;
+
+    symmetries.clear();
+    for (unsigned r = 0; r < rotations; ++r)
+    {
+        unsigned shift = r * (count / rotations);
+        std::vector<unsigned> rotated(count);
+        std::vector<unsigned> reflected(count);
+        for (unsigned i = 0; i < count; ++i)
+        {
+            rotated[i] = (i + shift) % count;
+            // The two neighbors of one-dimensional rules aren't a cycle, so reflecting just swaps them
+            reflected[i] = (count == 2 ? count - 1 - i : (count - i + shift) % count);
+        }
+        symmetries.push_back(rotated);
+        if (reflect)
+            symmetries.push_back(reflected);
+    }
+    return true;
+}
+
+bool RuleTable::parseVariable(const std::string& line, std::map<std::string, Mask>& variables) const
+{
+    // Format: var name={0,1,other}
+    std::size_t equals = line.find('=');
+    std::size_t open = line.find('{');
+    std::size_t close = line.find('}');
+    if (equals == std::string::npos || open == std::string::npos || close == std::string::npos || close < open)
+        return false;
+    std::string varName = cleanLine(line.substr(4, equals - 4));
+    Mask mask = 0;
+    for (const std::string& token: splitList(line.substr(open + 1, close - open - 1)))
+    {
+        if (isNumber(token) && static_cast<unsigned>(std::atoi(token.c_str())) < states)
+            mask |= Mask(1) << std::atoi(token.c_str());
+        else if (variables.count(token))
+            mask |= variables.at(token);
+        else
+            return false;
+    }
+    variables[varName] = mask;
+    return !varName.empty();
+}
+
+bool RuleTable::parseTransition(const std::string& line, const std::map<std::string, Mask>& variables)
+{
+    // Transitions can be comma separated, or a plain string of digits when there are less than 10 states
+    std::vector<std::string> tokens;
+    if (line.find(',') != std::string::npos)
+        tokens = splitList(line);
+    else
+    {
+        for (char c: line)
+            if (!std::isspace(static_cast<unsigned char>(c)))
+                tokens.emplace_back(1, c);
+    }
+    if (tokens.size() != offsets.size() + 1)
+        return false;
+
+    // Variables that are used more than once (or as the output) are bound to a single value
+    std::map<std::string, unsigned> uses;
+    for (const std::string& token: tokens)
+    {
+        if (isNumber(token))
+        {
+            if (static_cast<unsigned>(std::atoi(token.c_str())) >= states)
+                return false;
+        }
+        else if (variables.count(token))
+            ++uses[token];
+        else
+            return false;
+    }
+    std::vector<std::string> bound;
+    for (const auto& use: uses)
+        if (use.second > 1 || use.first == tokens.back())
+            bound.push_back(use.first);
+
+    // Expand every combination of values of the bound variables into its own transition
+    std::map<std::string, unsigned> values;
+    std::function<void(unsigned)> expand = [&](unsigned index)
+    {
+        if (index < bound.size())
+        {
+            Mask mask = variables.at(bound[index]);
+            for (unsigned state = 0; state < states; ++state)
+            {
+                if ((mask >> state) & 1)
+                {
+                    values[bound[index]] = state;
+                    expand(index + 1);
+                }
+            }
+        }
+        else
+        {
+            Transition transition;
+            for (unsigned i = 0; i < tokens.size(); ++i)
+            {
+                Mask mask;
+                if (isNumber(tokens[i]))
+                    mask = Mask(1) << std::atoi(tokens[i].c_str());
+                else if (values.count(tokens[i]))
+                    mask = Mask(1) << values[tokens[i]];
+                else
+                    mask = variables.at(tokens[i]);
+                if (i + 1 < tokens.size())
+                    transition.inputs.push_back(mask);
+                else
+                {
+                    // The output is always a single state at this point
+                    unsigned char output = 0;
+                    while (!((mask >> output) & 1))
+                        ++output;
+                    transition.output = output;
+                }
+            }
+            addSymmetricTransitions(transition);
+        }
+    };
+    expand(0);
+    return true;
+}
+
+void RuleTable::parseColor(const std::string& line)
+{
+    // Format: state red green blue
+    std::istringstream stream(line);
+    unsigned state, red, green, blue;
+    if (stream >> state >> red >> green >> blue && state < states)
+    {
+        if (colors.empty())
+        {
+            colors.assign(states, "#FFFFFF");
+            colors[0] = "#000000";
+        }
+        std::ostringstream color;
+        color << '#' << std::hex << std::uppercase;
+        for (unsigned component: {red, green, blue})
+            color << ((component & 0xff) < 16 ? "0" : "") << (component & 0xff);
+        colors[state] = color.str();
+    }
+}
+
+void RuleTable::addSymmetricTransitions(const Transition& transition)
+{
+    std::set<std::vector<Mask>> added;
+    Transition variant = transition;
+    if (permute)
+    {
+        // Every distinct ordering of the neighbors
+        std::vector<Mask> neighbors(transition.inputs.begin() + 1, transition.inputs.end());
+        std::sort(neighbors.begin(), neighbors.end());
+        do
+        {
+            std::copy(neighbors.begin(), neighbors.end(), variant.inputs.begin() + 1);
+            transitions.push_back(variant);
+        }
+        while (std::next_permutation(neighbors.begin(), neighbors.end()));
+    }
+    else
+    {
+        for (const auto& symmetry: symmetries)
+        {
+            for (unsigned i = 0; i < symmetry.size(); ++i)
+                variant.inputs[1 + symmetry[i]] = transition.inputs[1 + i];
+            if (added.insert(variant.inputs).second)
+                transitions.push_back(variant);
+        }
+    }
+}
+
+void RuleTable::compile()
+{
+    tree.clear();
+    nodeCache.clear();
+    constantCache.clear();
+    Candidates all(transitions.size());
+    for (unsigned i = 0; i < all.size(); ++i)
+        all[i] = i;
+    root = buildNode(0, all, 0);
+
+    // Only needed while building
+    nodeCache.clear();
+    constantCache.clear();
+}
+
+unsigned RuleTable::buildNode(unsigned level, const Candidates& candidates, unsigned center)
+{
+    if (candidates.empty() && level > 0)
+        return buildConstantNode(level, center); // No transitions match, so the cell stays the same
+
+    // The first matching transition wins, so if it matches anything from here on, the result is known
+    if (!candidates.empty())
+    {
+        const Transition& first = transitions[candidates.front()];
+        Mask allStates = (states >= 64 ? ~Mask(0) : (Mask(1) << states) - 1);
+        bool matchesAll = true;
+        for (unsigned i = level; i < first.inputs.size() && matchesAll; ++i)
+            matchesAll = ((first.inputs[i] & allStates) == allStates);
+        if (matchesAll)
+            return buildConstantNode(level, first.output);
+    }
+
+    // Reuse identical branches
+    auto key = std::make_pair(level, std::make_pair(center, candidates));
+    auto found = nodeCache.find(key);
+    if (found != nodeCache.end())
+        return found->second;
+
+    bool lastLevel = (level + 1 == offsets.size());
+    std::vector<unsigned> children(states);
+    for (unsigned state = 0; state < states; ++state)
+    {
+        Candidates matching;
+        for (unsigned index: candidates)
+            if ((transitions[index].inputs[level] >> state) & 1)
+                matching.push_back(index);
+        unsigned nextCenter = (level == 0 ? state : center);
+        if (lastLevel)
+            children[state] = (matching.empty() ? nextCenter : transitions[matching.front()].output);
+        else
+            children[state] = buildNode(level + 1, matching, nextCenter);
+    }
+
+    unsigned node = tree.size();
+    tree.insert(tree.end(), children.begin(), children.end());
+    nodeCache[key] = node;
+    return node;
+}
+
+unsigned RuleTable::buildConstantNode(unsigned level, unsigned char state)
+{
+    auto key = std::make_pair(level, static_cast<unsigned>(state));
+    auto found = constantCache.find(key);
+    if (found != constantCache.end())
+        return found->second;
+
+    unsigned child = state;
+    if (level + 1 < offsets.size())
+        child = buildConstantNode(level + 1, state);
+    unsigned node = tree.size();
+    tree.insert(tree.end(), states, child);
+    constantCache[key] = node;
+    return node;
+}
@@ -0,0 +1,86 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef RULETABLE_H
+#define RULETABLE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <SFML/System/Vector2.hpp>
+#include <SFML/Graphics/Rect.hpp>
+#include "matrix.h"
+
+/*
+This class loads rule tables in Golly's .rule format, for automata with any number of states
+    (like WireWorld or Langton's loops).
+Supported neighborhoods are Moore, vonNeumann, hexagonal and oneDimensional,
+    with all of the usual symmetries (rotations, reflections and permute).
+Variables are bound, so a variable used more than once in a transition has the same value everywhere.
+When a table is loaded, it is compiled into a decision tree with shared branches:
+    each cell is updated by following one branch per neighbor, starting with the center cell.
+If no transition matches, the cell keeps its state.
+Rule strings look like "@WireWorld", which loads "data/rules/WireWorld.rule".
+*/
+class RuleTable
+{
+    public:
+        RuleTable();
+        static bool isRuleTableString(const std::string& str); // Returns true if the string is meant for this class
+        bool loadFromString(const std::string& str); // Loads the table named in a rule string
+        bool loadFromFile(const std::string& filename); // Loads and compiles a .rule file
+        const std::string& toString() const; // Returns the rule string
+        unsigned getStates() const; // Number of states, including the dead state
+        const std::vector<std::string>& getColors() const; // Colors from the @COLORS section, empty if there are none
+
+        // Writes the next generation of the cells in rect into out
+        // Toroidal wraps around the edges of rect, otherwise cells outside of the board are dead
+        void step(const Matrix<char>& in, Matrix<char>& out, const sf::Rect<unsigned>& rect, bool toroidal) const;
+
+        static const unsigned maxStates = 64;
+        static const char* directory;
+
+    private:
+        using Mask = std::uint64_t; // A set of states
+        struct Transition
+        {
+            std::vector<Mask> inputs; // Center, then each neighbor
+            unsigned char output;
+        };
+        using Candidates = std::vector<unsigned>; // Indexes of transitions that still match
+
+        // Parsing
+        bool parseTable(std::istream& stream);
+        bool setNeighborhood(const std::string& name);
+        bool setSymmetries(const std::string& name);
+        bool parseVariable(const std::string& line, std::map<std::string, Mask>& variables) const;
+        bool parseTransition(const std::string& line, const std::map<std::string, Mask>& variables);
+        void parseColor(const std::string& line);
+        void addSymmetricTransitions(const Transition& transition);
+
+        // Compiling
+        void compile();
+        unsigned buildNode(unsigned level, const Candidates& candidates, unsigned center);
+        unsigned buildConstantNode(unsigned level, unsigned char state);
+
+        // Rule table
+        std::string name;
+        std::string ruleString;
+        unsigned states;
+        std::vector<sf::Vector2i> offsets; // Center, then each neighbor in Golly's order
+        std::vector<std::vector<unsigned>> symmetries; // Permutations of the neighbors
+        bool permute;
+        std::vector<Transition> transitions;
+        std::vector<std::string> colors;
+
+        // Compiled decision tree
+        // Each node has one entry per state, which is the index of the next node,
+        // or the new state of the cell for nodes on the last level
+        std::vector<unsigned> tree;
+        unsigned root;
+        std::map<std::pair<unsigned, std::pair<unsigned, Candidates>>, unsigned> nodeCache;
+        std::map<std::pair<unsigned, unsigned>, unsigned> constantCache;
+};
+
+#endif
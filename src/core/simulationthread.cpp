@@ -0,0 +1,225 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "simulationthread.h"
+#include <chrono>
+#include <algorithm>
+#include "trace.h"
+
+SimulationThread::SimulationThread(Automaton& automaton):
+    automaton(automaton),
+    running(false),
+    playing(false),
+    held(false),
+    maxTime(0.0f),
+    version(0),
+    changed(false),
+    generationCount(0),
+    cellCount(0),
+    simulateMicroseconds(0)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::start()
+{
+    if (!running)
+    {
+        running = true;
+        thread = std::thread(&SimulationThread::run, this);
+    }
+}
+
+void SimulationThread::stop()
+{
+    if (running)
+    {
+        {
+            std::lock_guard<std::mutex> commandLock(commandMutex);
+            running = false;
+        }
+        wakeUp.notify_one();
+        thread.join();
+
+        // Don't lose any changes that were queued after the last generation
+        std::lock_guard<std::recursive_mutex> automatonLock(mutex);
+        runCommands();
+    }
+}
+
+bool SimulationThread::isRunning() const
+{
+    return running;
+}
+
+void SimulationThread::setPlaying(bool state)
+{
+    if (playing != state)
+    {
+        {
+            std::lock_guard<std::mutex> commandLock(commandMutex);
+            playing = state;
+        }
+        wakeUp.notify_one();
+    }
+}
+
+void SimulationThread::setHeld(bool state)
+{
+    if (held != state)
+    {
+        {
+            std::lock_guard<std::mutex> commandLock(commandMutex);
+            held = state;
+        }
+        wakeUp.notify_one();
+    }
+}
+
+void SimulationThread::setMaxSpeed(float speed)
+{
+    maxTime = (speed > 0.0f ? 1.0f / speed : 0.0f);
+}
+
+void SimulationThread::setGenerationCallback(const Command& callback)
+{
+    std::lock_guard<std::recursive_mutex> automatonLock(mutex);
+    generationCallback = callback;
+}
+
+void SimulationThread::post(const Command& command)
+{
+    if (running)
+    {
+        {
+            std::lock_guard<std::mutex> commandLock(commandMutex);
+            commands.push_back(command);
+        }
+        wakeUp.notify_one();
+    }
+    else
+    {
+        std::lock_guard<std::recursive_mutex> automatonLock(mutex);
+        command(automaton);
+    }
+}
+
+std::unique_lock<std::recursive_mutex> SimulationThread::lock()
+{
+    std::unique_lock<std::recursive_mutex> automatonLock(mutex);
+    ++version;
+    runCommands(); // So the queued changes are seen by whoever locked it
+    return automatonLock;
+}
+
+std::uint64_t SimulationThread::getVersion() const
+{
+    return version;
+}
+
+SimulationThread::Snapshot* SimulationThread::getSnapshot()
+{
+    return (snapshots.update() ? &snapshots.getFront() : nullptr);
+}
+
+void SimulationThread::takeCounters(std::uint64_t& generations, double& cells, double& seconds)
+{
+    generations = generationCount.exchange(0);
+    cells = static_cast<double>(cellCount.exchange(0));
+    seconds = simulateMicroseconds.exchange(0) / 1000000.0;
+}
+
+void SimulationThread::run()
+{
+    using Clock = std::chrono::steady_clock;
+    auto nextTime = Clock::now();
+    while (running)
+    {
+        bool simulated = false;
+        bool simulating = false;
+        {
+            std::lock_guard<std::recursive_mutex> automatonLock(mutex);
+            runCommands();
+            simulating = (playing && !held);
+            auto startTime = Clock::now();
+            if (simulating && startTime >= nextTime)
+            {
+                TRACE_SCOPE("SimulationThread::simulate");
+                auto startGeneration = automaton.getGeneration();
+                automaton.simulate();
+                if (generationCallback)
+                    generationCallback(automaton);
+                auto endTime = Clock::now();
+                // Keep the average rate even when it's faster than the sleeps are accurate, but don't catch up after falling behind
+                nextTime = std::max(nextTime, startTime - std::chrono::milliseconds(10)) +
+                    std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(maxTime.load()));
+                simulated = true;
+                changed = true;
+
+                // One-dimensional rules only compute a single row for each generation
+                auto generations = automaton.getGeneration() - startGeneration;
+                std::uint64_t cellsPerGeneration = automaton.width();
+                if (automaton.getEngine() != Automaton::SpaceTime)
+                    cellsPerGeneration *= automaton.height();
+                generationCount += generations;
+                cellCount += cellsPerGeneration * generations;
+                simulateMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
+            }
+
+            // Only copy the cells once the last snapshot was picked up, unless nothing else is going to change
+            if (changed && (snapshots.wasRead() || !simulating))
+                takeSnapshot();
+        }
+
+        if (!simulated)
+        {
+            // Sleep until the next generation, or until there is something else to do
+            std::unique_lock<std::mutex> commandLock(commandMutex);
+            if (running && commands.empty())
+            {
+                if (changed)
+                    wakeUp.wait_for(commandLock, std::chrono::milliseconds(1)); // Try taking a snapshot again soon
+                else if (playing && !held)
+                    wakeUp.wait_until(commandLock, nextTime);
+                else
+                    wakeUp.wait(commandLock);
+            }
+        }
+    }
+}
+
+void SimulationThread::runCommands()
+{
+    std::vector<Command> currentCommands;
+    {
+        std::lock_guard<std::mutex> commandLock(commandMutex);
+        currentCommands.swap(commands);
+    }
+    for (auto& command: currentCommands)
+        command(automaton);
+    if (!currentCommands.empty())
+        changed = true;
+}
+
+void SimulationThread::takeSnapshot()
+{
+    TRACE_SCOPE("SimulationThread::takeSnapshot");
+    Snapshot& snapshot = snapshots.getBack();
+    snapshot.cells = automaton.getCells();
+    snapshot.values.clear();
+    if (automaton.getEngine() == Automaton::Continuous)
+    {
+        snapshot.values.resize(automaton.width() * automaton.height());
+        for (unsigned y = 0; y < automaton.height(); ++y)
+            for (unsigned x = 0; x < automaton.width(); ++x)
+                snapshot.values[y * automaton.width() + x] = automaton.getValue(x, y);
+    }
+    snapshot.generation = automaton.getGeneration();
+    snapshot.version = version;
+    snapshots.publish();
+    changed = false;
+}
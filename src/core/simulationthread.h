@@ -0,0 +1,90 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include "automaton.h"
+#include "triplebuffer.h"
+
+/*
+This class simulates an automaton on its own thread, so a slow generation doesn't hold up drawing or input.
+Finished generations are copied into snapshots, which are passed to the drawing thread with a triple buffer.
+A new snapshot is only taken once the last one was picked up, so copying the cells doesn't slow down fast simulations.
+Other threads can change the automaton in two ways:
+    Commands are queued, and run by the simulation thread between generations (good for painting cells).
+    Locking waits for the current generation to finish, and blocks the simulation until it is unlocked.
+    Any queued commands are run first, so the automaton is always up to date while it is locked.
+Each lock increases the version, so snapshots from before a change can be ignored.
+When the thread isn't started, commands run right away, and locking never has to wait.
+*/
+class SimulationThread
+{
+    public:
+        using Command = std::function<void(Automaton&)>;
+
+        // A copy of the cells from a single generation
+        struct Snapshot
+        {
+            Matrix<char> cells;
+            std::vector<float> values; // Real values of continuous rules, row by row (empty for other rules)
+            std::uint64_t generation;
+            std::uint64_t version; // The version when the snapshot was taken
+        };
+
+        SimulationThread(Automaton& automaton);
+        ~SimulationThread();
+        void start();
+        void stop();
+        bool isRunning() const;
+
+        // Simulation settings
+        void setPlaying(bool state);
+        void setHeld(bool state); // Stops running generations while true (like during an edit), without changing whether it's playing
+        void setMaxSpeed(float speed); // In generations per second, 0 is unlimited
+        void setGenerationCallback(const Command& callback); // Runs on the simulation thread right after each generation
+
+        // Changing the automaton from other threads
+        void post(const Command& command); // Runs a command on the simulation thread between generations
+        std::unique_lock<std::recursive_mutex> lock(); // Stops the simulation until the lock is released (it can be locked again by the same thread)
+        std::uint64_t getVersion() const; // Increases every time the automaton is locked
+
+        // Reading the results
+        Snapshot* getSnapshot(); // Returns the newest snapshot, or null if there isn't a new one
+        void takeCounters(std::uint64_t& generations, double& cells, double& seconds); // Returns the work done since the last call, and resets it
+
+    private:
+        void run(); // The thread's main loop
+        void runCommands();
+        void takeSnapshot();
+
+        Automaton& automaton;
+        std::thread thread;
+        std::atomic<bool> running;
+        std::atomic<bool> playing;
+        std::atomic<bool> held;
+        std::atomic<float> maxTime; // Seconds between generations, 0 is unlimited
+
+        std::recursive_mutex mutex; // Held while simulating or running commands
+        std::condition_variable wakeUp; // Signaled when there is something to do
+        std::mutex commandMutex; // Protects the queued commands
+        std::vector<Command> commands;
+        Command generationCallback; // Protected by the main mutex
+        std::atomic<std::uint64_t> version;
+        bool changed; // True when there are changes that aren't in a snapshot yet
+        TripleBuffer<Snapshot> snapshots;
+
+        // Counters for performance stats
+        std::atomic<std::uint64_t> generationCount;
+        std::atomic<std::uint64_t> cellCount;
+        std::atomic<std::uint64_t> simulateMicroseconds;
+};
+
+#endif
@@ -0,0 +1,81 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "statslog.h"
+
+const std::uint32_t StatsLog::version = 1;
+
+StatsLog::StatsLog():
+    binary(false),
+    lastGeneration(0)
+{
+}
+
+bool StatsLog::open(const std::string& filename)
+{
+    close();
+    binary = (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".bin") == 0);
+    file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    if (binary)
+    {
+        char header[8] = {'S', 'T', 'A', 'T'};
+        for (unsigned i = 0; i < 4; ++i)
+            header[4 + i] = static_cast<char>((version >> (i * 8)) & 0xFF);
+        file.write(header, sizeof(header));
+    }
+    else
+        file << "generation,population,births,deaths,left,top,width,height\n";
+    lastGeneration = 0;
+    return true;
+}
+
+bool StatsLog::isOpen() const
+{
+    return file.is_open();
+}
+
+void StatsLog::add(const Automaton::Statistics& statistics)
+{
+    if (!file.is_open())
+        return;
+    const sf::Rect<unsigned>& bounds = statistics.bounds;
+    if (binary)
+    {
+        // Generations can go backwards when the board is rewound, which wraps around like any other difference
+        record.clear();
+        appendCount(statistics.generation - lastGeneration);
+        appendCount(statistics.population);
+        appendCount(statistics.births);
+        appendCount(statistics.deaths);
+        appendCount(bounds.left);
+        appendCount(bounds.top);
+        appendCount(bounds.width);
+        appendCount(bounds.height);
+        file.write(record.data(), record.size());
+    }
+    else
+    {
+        file << statistics.generation << ',' << statistics.population << ',' << statistics.births << ',' << statistics.deaths << ','
+             << bounds.left << ',' << bounds.top << ',' << bounds.width << ',' << bounds.height << '\n';
+    }
+    lastGeneration = statistics.generation;
+}
+
+void StatsLog::close()
+{
+    if (file.is_open())
+        file.close();
+    file.clear();
+}
+
+void StatsLog::appendCount(std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        record.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    record.push_back(static_cast<char>(value));
+}
@@ -0,0 +1,41 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef STATSLOG_H
+#define STATSLOG_H
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include "automaton.h"
+
+/*
+This class writes the statistics of each generation to a file as they are simulated (see Automaton::setStatistics).
+Files ending in ".bin" are written in a compact binary format, and anything else is written as CSV,
+    with the columns: generation, population, births, deaths, left, top, width, height.
+The binary format starts with "STAT" and a 32-bit little-endian version, followed by a record for each generation.
+Each record is the same 8 values as the CSV columns, as unsigned numbers stored 7 bits at a time (lowest bits first,
+    with the high bit set on every byte but the last), and the generation is stored as how much it went up since the last record.
+*/
+class StatsLog
+{
+    public:
+        StatsLog();
+        bool open(const std::string& filename); // Starts a new file, returns false if it couldn't be created
+        bool isOpen() const;
+        void add(const Automaton::Statistics& statistics); // Writes a record for a generation
+        void close();
+
+    private:
+        static const std::uint32_t version;
+
+        void appendCount(std::uint64_t value);
+
+        std::ofstream file;
+        bool binary;
+        std::uint64_t lastGeneration; // Generations are stored as differences in the binary format
+        std::vector<char> record;
+};
+
+#endif
@@ -0,0 +1,201 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef BITPACKING_H
+#define BITPACKING_H
+
+#include <cstdint>
+#include <cstring>
+
+/*
+This class packs cells into a stream of bits and back, where cell i starts at bit i * bitsPerCell (lowest bit first).
+With 1 bit per cell, 8 cells are handled at once with 64-bit multiplies instead of a shift and mask per cell,
+    so loading and saving big boards isn't held back by the bit twiddling.
+The functions only touch the cells and bytes they are given, so separate ranges can be done on separate threads.
+*/
+class BitPacking
+{
+    public:
+        // Packs the cells into 1 bit each, where any non-zero cell is a 1
+        static void pack(const char* cells, std::uint64_t count, unsigned char* bits)
+        {
+            std::uint64_t i = 0;
+            for (; i + 8 <= count; i += 8)
+                bits[i / 8] = packWord(cells + i);
+            packTail(cells + i, count - i, bits + i / 8);
+        }
+
+        // Packs the next 8 cells into a byte, with a 1 for each cell that isn't 0
+        static unsigned char packWord(const char* cells)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, cells, 8);
+            return gather(nonZeroBytes(toLittleEndian(word)));
+        }
+
+        template <class Type>
+        static void pack(const Type* cells, std::uint64_t count, unsigned char* bits)
+        {
+            std::uint64_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                unsigned char byte = 0;
+                for (unsigned j = 0; j < 8; ++j)
+                    byte |= (cells[i + j] != 0) << j;
+                bits[i / 8] = byte;
+            }
+            packTail(cells + i, count - i, bits + i / 8);
+        }
+
+        // Unpacks cells from 1 bit each, starting at any bit of the stream
+        template <class Type>
+        static void unpack(const unsigned char* bits, std::uint64_t firstBit, std::uint64_t count, Type* cells)
+        {
+            // Go one cell at a time until the next byte boundary
+            std::uint64_t i = 0;
+            for (; i < count && (firstBit + i) % 8 != 0; ++i)
+                cells[i] = (bits[(firstBit + i) / 8] >> ((firstBit + i) % 8)) & 0x1;
+            const unsigned char* source = bits + (firstBit + i) / 8;
+            for (; i + 8 <= count; i += 8, ++source)
+                copyBytes(spread(*source), cells + i);
+            for (unsigned j = 0; i < count; ++i, ++j)
+                cells[i] = (*source >> j) & 0x1;
+        }
+
+        // Packs cells with any number of bits from 1 to 8 (the bits must start out cleared)
+        static void packStates(const char* cells, std::uint64_t count, unsigned bitsPerCell, unsigned char* bits)
+        {
+            if (bitsPerCell == 1)
+                pack(cells, count, bits);
+            else if (bitsPerCell == 8)
+                std::memcpy(bits, cells, count);
+            else
+            {
+                for (std::uint64_t i = 0; i < count; ++i)
+                {
+                    std::uint64_t position = i * bitsPerCell;
+                    unsigned shifted = static_cast<unsigned>(static_cast<unsigned char>(cells[i])) << (position % 8);
+                    bits[position / 8] |= shifted & 0xFF;
+                    if ((position % 8) + bitsPerCell > 8)
+                        bits[position / 8 + 1] |= shifted >> 8;
+                }
+            }
+        }
+
+        static void unpackStates(const unsigned char* bits, std::uint64_t count, unsigned bitsPerCell, char* cells)
+        {
+            if (bitsPerCell == 1)
+                unpack(bits, 0, count, cells);
+            else if (bitsPerCell == 8)
+                std::memcpy(cells, bits, count);
+            else
+            {
+                unsigned mask = (1u << bitsPerCell) - 1;
+                for (std::uint64_t i = 0; i < count; ++i)
+                {
+                    std::uint64_t position = i * bitsPerCell;
+                    unsigned value = bits[position / 8] >> (position % 8);
+                    if ((position % 8) + bitsPerCell > 8)
+                        value |= bits[position / 8 + 1] << (8 - position % 8);
+                    cells[i] = static_cast<char>(value & mask);
+                }
+            }
+        }
+
+        // Returns the number of bits that are set
+        static unsigned countBits(std::uint64_t word)
+        {
+#if defined(__GNUC__)
+            return __builtin_popcountll(word);
+#else
+            word -= (word >> 1) & 0x5555555555555555ULL;
+            word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+            word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            return static_cast<unsigned>((word * 0x0101010101010101ULL) >> 56);
+#endif
+        }
+
+        // Returns the position of the lowest bit that is set (the word can't be 0)
+        static unsigned lowestBit(std::uint64_t word)
+        {
+#if defined(__GNUC__)
+            return __builtin_ctzll(word);
+#else
+            return countBits((word & (~word + 1)) - 1);
+#endif
+        }
+
+        // Returns the position of the highest bit that is set (the word can't be 0)
+        static unsigned highestBit(std::uint64_t word)
+        {
+#if defined(__GNUC__)
+            return 63 - __builtin_clzll(word);
+#else
+            // Fill in every bit below the highest one
+            word |= word >> 1;
+            word |= word >> 2;
+            word |= word >> 4;
+            word |= word >> 8;
+            word |= word >> 16;
+            word |= word >> 32;
+            return countBits(word) - 1;
+#endif
+        }
+
+    private:
+        // Moves the low bit of each byte into a single byte
+        static unsigned char gather(std::uint64_t word)
+        {
+            return static_cast<unsigned char>((word * 0x0102040810204080ULL) >> 56);
+        }
+
+        // Moves each bit into the low bit of its own byte (the top bit is done separately so the products don't overlap)
+        static std::uint64_t spread(unsigned char byte)
+        {
+            return (((byte & 0x7FULL) * 0x0002040810204081ULL) & 0x0101010101010101ULL) | (static_cast<std::uint64_t>(byte & 0x80) << 49);
+        }
+
+        // Sets each byte to 1 if it was non-zero
+        static std::uint64_t nonZeroBytes(std::uint64_t word)
+        {
+            const std::uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+            return ((((word & low7) + low7) | word) >> 7) & 0x0101010101010101ULL;
+        }
+
+        // The first cell is in the lowest byte of a word
+        static std::uint64_t toLittleEndian(std::uint64_t word)
+        {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return __builtin_bswap64(word);
+#else
+            return word;
+#endif
+        }
+
+        static void copyBytes(std::uint64_t word, char* cells)
+        {
+            word = toLittleEndian(word);
+            std::memcpy(cells, &word, 8);
+        }
+
+        template <class Type>
+        static void copyBytes(std::uint64_t word, Type* cells)
+        {
+            for (unsigned j = 0; j < 8; ++j)
+                cells[j] = (word >> (j * 8)) & 0x1;
+        }
+
+        template <class Type>
+        static void packTail(const Type* cells, std::uint64_t count, unsigned char* bits)
+        {
+            if (count > 0)
+            {
+                unsigned char byte = 0;
+                for (unsigned j = 0; j < count; ++j)
+                    byte |= (cells[j] != 0) << j;
+                *bits = byte;
+            }
+        }
+};
+
+#endif
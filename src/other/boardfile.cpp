@@ -0,0 +1,371 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "boardfile.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include "bitpacking.h"
+#include "mappedfile.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace
+{
+    const char magic[4] = {'C', 'E', 'L', 'L'};
+    const unsigned headerSize = 32;
+    const unsigned version1HeaderSize = 20; // Version 1 didn't have the bits per cell
+    const unsigned version2HeaderSize = 24; // Version 2 didn't have the generation
+    const unsigned indexEntrySize = 12;
+
+    void appendUint32(std::vector<char>& data, std::uint32_t value)
+    {
+        for (unsigned i = 0; i < 4; ++i)
+            data.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+
+    void appendUint64(std::vector<char>& data, std::uint64_t value)
+    {
+        for (unsigned i = 0; i < 8; ++i)
+            data.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+
+    std::uint32_t readUint32(const char* data)
+    {
+        std::uint32_t value = 0;
+        for (unsigned i = 0; i < 4; ++i)
+            value |= static_cast<std::uint32_t>(static_cast<unsigned char>(data[i])) << (i * 8);
+        return value;
+    }
+
+    std::uint64_t readUint64(const char* data)
+    {
+        std::uint64_t value = 0;
+        for (unsigned i = 0; i < 8; ++i)
+            value |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i])) << (i * 8);
+        return value;
+    }
+
+    // PackBits: a header byte of 0 to 127 is followed by that many plus 1 literal bytes,
+    // and -1 to -127 is followed by a single byte that is repeated 1 minus that many times
+    void packBits(const std::vector<unsigned char>& input, std::vector<char>& output)
+    {
+        unsigned size = input.size();
+        unsigned i = 0;
+        while (i < size)
+        {
+            unsigned run = 1;
+            while (i + run < size && run < 128 && input[i + run] == input[i])
+                ++run;
+            if (run >= 2)
+            {
+                output.push_back(static_cast<char>(1 - static_cast<int>(run)));
+                output.push_back(static_cast<char>(input[i]));
+                i += run;
+            }
+            else
+            {
+                // Take literal bytes until the next run starts
+                unsigned end = i + 1;
+                while (end < size && end - i < 128 && !(end + 1 < size && input[end] == input[end + 1]))
+                    ++end;
+                output.push_back(static_cast<char>(end - i - 1));
+                output.insert(output.end(), input.begin() + i, input.begin() + end);
+                i = end;
+            }
+        }
+    }
+
+    bool unpackBits(const char* input, unsigned inputSize, std::vector<unsigned char>& output)
+    {
+        unsigned outputSize = output.size();
+        unsigned in = 0;
+        unsigned out = 0;
+        while (in < inputSize && out < outputSize)
+        {
+            int header = static_cast<signed char>(input[in++]);
+            if (header >= 0)
+            {
+                unsigned count = header + 1;
+                if (in + count > inputSize || out + count > outputSize)
+                    return false;
+                std::memcpy(&output[out], input + in, count);
+                in += count;
+                out += count;
+            }
+            else if (header != -128)
+            {
+                unsigned count = 1 - header;
+                if (in >= inputSize || out + count > outputSize)
+                    return false;
+                std::memset(&output[out], static_cast<unsigned char>(input[in++]), count);
+                out += count;
+            }
+        }
+        return (out == outputSize);
+    }
+
+    sf::Rect<unsigned> getTileRect(unsigned index, unsigned tilesX, unsigned tileSize, unsigned width, unsigned height)
+    {
+        unsigned left = (index % tilesX) * tileSize;
+        unsigned top = (index / tilesX) * tileSize;
+        return sf::Rect<unsigned>(left, top, std::min(tileSize, width - left), std::min(tileSize, height - top));
+    }
+}
+
+bool BoardFile::save(const std::string& filename, const Matrix<char>& cells, std::uint64_t generation, unsigned tileSize)
+{
+    TRACE_SCOPE("BoardFile::save");
+    if (filename.empty() || tileSize == 0)
+        return false;
+    unsigned width = cells.width();
+    unsigned height = cells.height();
+    unsigned tilesX = (width + tileSize - 1) / tileSize;
+    unsigned tilesY = (height + tileSize - 1) / tileSize;
+    unsigned tileCount = tilesX * tilesY;
+
+    // Only use as many bits as the highest state needs, so multi-state boards are saved exactly
+    unsigned char maxState = 1;
+    for (unsigned i = 0; i < cells.size(); ++i)
+        maxState = std::max(maxState, static_cast<unsigned char>(cells.data()[i]));
+    unsigned bitsPerCell = 1;
+    while ((maxState >> bitsPerCell) != 0)
+        ++bitsPerCell;
+
+    // Compress the tiles in parallel
+    std::vector<std::vector<char>> tiles(tileCount);
+    Parallel::forEach(tileCount, [&](unsigned i)
+    {
+        tiles[i] = encodeTile(cells, getTileRect(i, tilesX, tileSize, width, height), bitsPerCell);
+    });
+
+    // Build the header and index, now that the sizes of the tiles are known
+    std::vector<char> header(magic, magic + 4);
+    appendUint32(header, version);
+    appendUint32(header, width);
+    appendUint32(header, height);
+    appendUint32(header, tileSize);
+    appendUint32(header, bitsPerCell);
+    appendUint64(header, generation);
+    std::uint64_t offset = headerSize + static_cast<std::uint64_t>(tileCount) * indexEntrySize;
+    for (const auto& tile: tiles)
+    {
+        appendUint64(header, tile.empty() ? 0 : offset);
+        appendUint32(header, tile.size());
+        offset += tile.size();
+    }
+
+    std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    file.write(header.data(), header.size());
+    for (const auto& tile: tiles)
+        file.write(tile.data(), tile.size());
+    return file.good();
+}
+
+bool BoardFile::load(const std::string& filename, Matrix<char>& cells, std::uint64_t* generation)
+{
+    // The region gets cut down to the size of the board
+    return loadRegion(filename, sf::Rect<unsigned>(0, 0, std::numeric_limits<unsigned>::max(), std::numeric_limits<unsigned>::max()), cells, generation);
+}
+
+bool BoardFile::loadRegion(const std::string& filename, const sf::Rect<unsigned>& rect, Matrix<char>& cells, std::uint64_t* generation)
+{
+    TRACE_SCOPE("BoardFile::loadRegion");
+    // The tiles are decompressed straight out of the mapped file, so it's never copied as a whole
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+    Header header;
+    if (!readHeader(file, header))
+        return false;
+    if (generation)
+        *generation = header.generation;
+
+    // Only keep the part of the rectangle that is on the board
+    sf::Rect<unsigned> region;
+    region.left = std::min(rect.left, header.width);
+    region.top = std::min(rect.top, header.height);
+    region.width = std::min(rect.width, header.width - region.left);
+    region.height = std::min(rect.height, header.height - region.top);
+    cells.resize(region.width, region.height, false);
+    if (header.version == 0)
+        return loadOldRegion(file, header, region, cells);
+    std::fill(cells.data(), cells.data() + cells.size(), 0);
+    if (cells.size() == 0)
+        return true;
+
+    // Find the tiles that overlap the region
+    unsigned firstX = region.left / header.tileSize;
+    unsigned firstY = region.top / header.tileSize;
+    unsigned lastX = (region.left + region.width - 1) / header.tileSize;
+    unsigned lastY = (region.top + region.height - 1) / header.tileSize;
+    std::vector<unsigned> indexes;
+    for (unsigned y = firstY; y <= lastY; ++y)
+    {
+        for (unsigned x = firstX; x <= lastX; ++x)
+        {
+            unsigned index = y * header.tilesX + x;
+            if (header.sizes[index] == 0)
+                continue; // Empty tiles aren't stored
+            if (header.offsets[index] + header.sizes[index] > header.fileSize)
+            {
+                std::cerr << "Error: \"" << filename << "\" is truncated.\n";
+                return false;
+            }
+            indexes.push_back(index);
+        }
+    }
+
+    // Then decompress them in parallel, each into its own part of the region
+    std::atomic<bool> status(true);
+    Parallel::forEach(indexes.size(), [&](unsigned i)
+    {
+        unsigned index = indexes[i];
+        auto tileRect = getTileRect(index, header.tilesX, header.tileSize, header.width, header.height);
+        if (!decodeTile(file.data() + header.offsets[index], header.sizes[index], tileRect, header.bitsPerCell, region, cells))
+            status = false;
+    });
+    if (!status)
+        std::cerr << "Error: \"" << filename << "\" has a corrupted tile.\n";
+    return status;
+}
+
+bool BoardFile::readSize(const std::string& filename, sf::Vector2u& size)
+{
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+    Header header;
+    if (!readHeader(file, header))
+        return false;
+    size.x = header.width;
+    size.y = header.height;
+    return true;
+}
+
+bool BoardFile::readHeader(const MappedFile& file, Header& header)
+{
+    const char* data = file.data();
+    header.fileSize = file.size();
+    if (header.fileSize < version1HeaderSize || std::memcmp(data, magic, 4) != 0)
+    {
+        // The old format starts with the width and height, and has no tiles
+        if (header.fileSize < 8)
+            return false;
+        header.version = 0;
+        header.bitsPerCell = 1;
+        header.generation = 0;
+        header.width = readUint32(data);
+        header.height = readUint32(data + 4);
+        return true;
+    }
+    header.version = readUint32(data + 4);
+    header.width = readUint32(data + 8);
+    header.height = readUint32(data + 12);
+    header.tileSize = readUint32(data + 16);
+    header.bitsPerCell = 1;
+    header.generation = 0;
+    if (header.version >= 2)
+    {
+        if (header.fileSize < version2HeaderSize)
+            return false;
+        header.bitsPerCell = readUint32(data + 20);
+    }
+    if (header.version >= 3)
+    {
+        if (header.fileSize < headerSize)
+            return false;
+        header.generation = readUint64(data + 24);
+    }
+    if (header.version > version || header.tileSize == 0 || header.bitsPerCell == 0 || header.bitsPerCell > 8)
+    {
+        std::cerr << "Error: Unsupported board file (version " << header.version << ").\n";
+        return false;
+    }
+    header.tilesX = (header.width + header.tileSize - 1) / header.tileSize;
+    header.tilesY = (header.height + header.tileSize - 1) / header.tileSize;
+    std::uint64_t tileCount = static_cast<std::uint64_t>(header.tilesX) * header.tilesY;
+    std::uint64_t indexOffset = (header.version >= 3 ? headerSize : (header.version == 2 ? version2HeaderSize : version1HeaderSize));
+    if (indexOffset + tileCount * indexEntrySize > header.fileSize)
+    {
+        std::cerr << "Error: The board file's index is truncated.\n";
+        return false;
+    }
+
+    const char* index = data + indexOffset;
+    header.offsets.resize(tileCount);
+    header.sizes.resize(tileCount);
+    for (unsigned i = 0; i < tileCount; ++i)
+    {
+        header.offsets[i] = readUint64(index + i * indexEntrySize);
+        header.sizes[i] = readUint32(index + i * indexEntrySize + 8);
+    }
+    return true;
+}
+
+bool BoardFile::loadOldRegion(const MappedFile& file, const Header& header, const sf::Rect<unsigned>& region, Matrix<char>& cells)
+{
+    // The old format is one long stream of bits, so each row of the region can be unpacked on its own
+    const unsigned char* bits = reinterpret_cast<const unsigned char*>(file.data() + 8);
+    std::uint64_t bitCount = (header.fileSize - 8) * 8;
+    unsigned rowsPerBand = std::max(1u, (1u << 20) / std::max(cells.width(), 1u));
+    unsigned bandCount = (cells.height() + rowsPerBand - 1) / rowsPerBand;
+    Parallel::forEach(bandCount, [&](unsigned band)
+    {
+        unsigned lastRow = std::min(cells.height(), (band + 1) * rowsPerBand);
+        for (unsigned y = band * rowsPerBand; y < lastRow; ++y)
+        {
+            char* row = &cells(0, y);
+            std::uint64_t first = static_cast<std::uint64_t>(region.top + y) * header.width + region.left;
+            std::uint64_t count = std::min<std::uint64_t>(cells.width(), bitCount > first ? bitCount - first : 0);
+            BitPacking::unpack(bits, first, count, row);
+            std::fill(row + count, row + cells.width(), 0); // In case the file was cut short
+        }
+    });
+    return true;
+}
+
+std::vector<char> BoardFile::encodeTile(const Matrix<char>& cells, const sf::Rect<unsigned>& tile, unsigned bitsPerCell)
+{
+    // Gather the rows of the tile into one stream of cells, then pack it starting with the lowest bit
+    std::vector<char> tileCells(tile.width * tile.height);
+    bool empty = true;
+    for (unsigned y = 0; y < tile.height; ++y)
+    {
+        const char* row = &cells(tile.left, tile.top + y);
+        std::memcpy(&tileCells[y * tile.width], row, tile.width);
+        if (empty)
+            empty = std::all_of(row, row + tile.width, [](char cell){ return cell == 0; });
+    }
+    std::vector<char> data;
+    if (!empty)
+    {
+        std::vector<unsigned char> bits((tileCells.size() * bitsPerCell + 7) / 8, 0);
+        BitPacking::packStates(tileCells.data(), tileCells.size(), bitsPerCell, bits.data());
+        packBits(bits, data);
+    }
+    return data;
+}
+
+bool BoardFile::decodeTile(const char* data, unsigned size, const sf::Rect<unsigned>& tile, unsigned bitsPerCell, const sf::Rect<unsigned>& region, Matrix<char>& cells)
+{
+    std::vector<unsigned char> bits((tile.width * tile.height * bitsPerCell + 7) / 8);
+    if (!unpackBits(data, size, bits))
+        return false;
+    std::vector<char> tileCells(tile.width * tile.height);
+    BitPacking::unpackStates(bits.data(), tileCells.size(), bitsPerCell, tileCells.data());
+
+    // Only copy the part of the tile that is in the region
+    unsigned left = std::max(tile.left, region.left);
+    unsigned top = std::max(tile.top, region.top);
+    unsigned right = std::min(tile.left + tile.width, region.left + region.width);
+    unsigned bottom = std::min(tile.top + tile.height, region.top + region.height);
+    for (unsigned y = top; y < bottom; ++y)
+        std::memcpy(&cells(left - region.left, y - region.top), &tileCells[(y - tile.top) * tile.width + (left - tile.left)], right - left);
+    return true;
+}
@@ -0,0 +1,64 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef BOARDFILE_H
+#define BOARDFILE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <SFML/Graphics/Rect.hpp>
+#include "matrix.h"
+
+class MappedFile;
+
+/*
+This class saves and loads boards in a tiled format, so big boards that are mostly empty stay small.
+The board is split into square tiles, which are compressed separately, and an index says where each tile is.
+Empty tiles aren't stored at all, and the other tiles are packed to as many bits per cell as the highest state needs,
+    then run-length encoded (PackBits). So the ages and states of multi-state rules are saved exactly.
+Since the tiles don't depend on each other, they are compressed and decompressed on multiple threads,
+    and a region of the board can be loaded by only reading the tiles it touches.
+Files are memory-mapped when loading, so the tiles are decompressed straight from the file without copying it first.
+The older format (see Matrix::saveToFile) can still be loaded.
+
+Layout (all numbers are little-endian):
+    Header: "CELL", version (uint32), width (uint32), height (uint32), tile size (uint32), bits per cell (uint32, 1 to 8), generation (uint64)
+    Index: For each tile, row by row: offset from the start of the file (uint64), size in bytes (uint32, 0 if empty)
+    Data: The compressed tiles
+Version 1 files don't have the bits per cell, and always use 1 bit. Version 1 and 2 files don't have the generation, which loads as 0.
+*/
+class BoardFile
+{
+    public:
+        static const unsigned version = 3;
+        static const unsigned defaultTileSize = 256;
+
+        static bool save(const std::string& filename, const Matrix<char>& cells, std::uint64_t generation = 0, unsigned tileSize = defaultTileSize);
+        static bool load(const std::string& filename, Matrix<char>& cells, std::uint64_t* generation = nullptr); // Resizes the matrix to the size of the board in the file
+        static bool loadRegion(const std::string& filename, const sf::Rect<unsigned>& rect, Matrix<char>& cells, std::uint64_t* generation = nullptr); // Resizes the matrix to the part of the rectangle that is on the board
+        static bool readSize(const std::string& filename, sf::Vector2u& size);
+
+    private:
+        struct Header
+        {
+            unsigned version; // 0 for the old format
+            std::uint64_t fileSize;
+            unsigned width;
+            unsigned height;
+            unsigned tileSize;
+            unsigned bitsPerCell;
+            std::uint64_t generation;
+            unsigned tilesX;
+            unsigned tilesY;
+            std::vector<std::uint64_t> offsets;
+            std::vector<std::uint32_t> sizes;
+        };
+
+        static bool readHeader(const MappedFile& file, Header& header); // Returns false if the file is broken (only the width and height are read from the old format)
+        static bool loadOldRegion(const MappedFile& file, const Header& header, const sf::Rect<unsigned>& region, Matrix<char>& cells);
+        static std::vector<char> encodeTile(const Matrix<char>& cells, const sf::Rect<unsigned>& tile, unsigned bitsPerCell);
+        static bool decodeTile(const char* data, unsigned size, const sf::Rect<unsigned>& tile, unsigned bitsPerCell, const sf::Rect<unsigned>& region, Matrix<char>& cells);
+};
+
+#endif
@@ -0,0 +1,132 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef DELTACODER_H
+#define DELTACODER_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+This class compresses cells that are mostly 0, like the XOR of two generations of a board.
+The data is pairs of counts: a run of 0s, then a run of other bytes that follow the counts.
+Counts are stored 7 bits at a time, so short runs only take a single byte.
+Changes can be applied straight from the compressed data, so the cost only depends on how much changed.
+*/
+class DeltaCoder
+{
+    public:
+        // Compresses size bytes
+        static void encode(const char* cells, std::size_t size, std::vector<char>& data)
+        {
+            encodeXor(cells, nullptr, size, data);
+        }
+
+        // Compresses the XOR of two arrays of size bytes (second can be null to compress the first by itself)
+        static void encodeXor(const char* first, const char* second, std::size_t size, std::vector<char>& data)
+        {
+            data.clear();
+            std::size_t i = 0;
+            while (i < size)
+            {
+                std::size_t zeros = skipZeros(first, second, i, size);
+                // Single 0s are kept in the literals, since a new pair would take more space
+                std::size_t literals = zeros;
+                while (literals < size && !(at(first, second, literals) == 0 && (literals + 1 >= size || at(first, second, literals + 1) == 0)))
+                    ++literals;
+                appendCount(data, zeros - i);
+                appendCount(data, literals - zeros);
+                for (std::size_t j = zeros; j < literals; ++j)
+                    data.push_back(at(first, second, j));
+                i = literals;
+            }
+        }
+
+        // Decompresses all of the bytes
+        static void decode(const std::vector<char>& data, std::vector<char>& cells)
+        {
+            cells.clear();
+            std::size_t pos = 0;
+            while (pos < data.size())
+            {
+                std::size_t zeros = readCount(data, pos);
+                std::size_t literals = readCount(data, pos);
+                cells.insert(cells.end(), zeros, 0);
+                literals = std::min(literals, data.size() - pos);
+                cells.insert(cells.end(), data.begin() + pos, data.begin() + pos + literals);
+                pos += literals;
+            }
+        }
+
+        // Calls function(index, value) for each byte that isn't 0, skipping over the runs of 0s
+        template <class Function>
+        static void forEach(const std::vector<char>& data, Function function)
+        {
+            std::size_t index = 0;
+            std::size_t pos = 0;
+            while (pos < data.size())
+            {
+                index += readCount(data, pos);
+                std::size_t literals = readCount(data, pos);
+                literals = std::min(literals, data.size() - pos);
+                for (std::size_t end = pos + literals; pos < end; ++pos, ++index)
+                {
+                    if (data[pos] != 0)
+                        function(index, data[pos]);
+                }
+            }
+        }
+
+    private:
+        static std::size_t skipZeros(const char* first, const char* second, std::size_t i, std::size_t size)
+        {
+            // Most of a delta is unchanged cells, so compare 8 bytes at a time until something differs
+            std::uint64_t firstWord = 0;
+            std::uint64_t secondWord = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                std::memcpy(&firstWord, first + i, 8);
+                if (second)
+                    std::memcpy(&secondWord, second + i, 8);
+                if (firstWord != secondWord)
+                    break;
+            }
+            while (i < size && at(first, second, i) == 0)
+                ++i;
+            return i;
+        }
+
+        static char at(const char* first, const char* second, std::size_t index)
+        {
+            return (second ? first[index] ^ second[index] : first[index]);
+        }
+
+        static void appendCount(std::vector<char>& data, std::size_t count)
+        {
+            // 7 bits at a time, the high bit means there are more
+            while (count >= 0x80)
+            {
+                data.push_back(static_cast<char>((count & 0x7F) | 0x80));
+                count >>= 7;
+            }
+            data.push_back(static_cast<char>(count));
+        }
+
+        static std::size_t readCount(const std::vector<char>& data, std::size_t& pos)
+        {
+            std::size_t count = 0;
+            for (unsigned shift = 0; pos < data.size(); shift += 7)
+            {
+                unsigned char byte = static_cast<unsigned char>(data[pos++]);
+                count |= static_cast<std::size_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    break;
+            }
+            return count;
+        }
+};
+
+#endif
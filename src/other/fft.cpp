@@ -0,0 +1,314 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "fft.h"
+#include <cmath>
+
+namespace
+{
+    const double pi = 3.14159265358979323846;
+
+    // Plain complex multiply, std::complex's operator* has slow checks for infinities and NaNs
+    inline FFT::Complex multiply(const FFT::Complex& a, const FFT::Complex& b)
+    {
+        return FFT::Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+    }
+}
+
+FFT::FFT():
+    length(0),
+    useBluestein(false)
+{
+}
+
+FFT::FFT(unsigned size):
+    FFT()
+{
+    setSize(size);
+}
+
+void FFT::setSize(unsigned size)
+{
+    length = size;
+    factors.clear();
+    twiddles.clear();
+    useBluestein = false;
+    inner.reset();
+    chirp.clear();
+    chirpSpectrum.clear();
+
+    // Twiddle factors for the forward transform
+    twiddles.resize(length);
+    for (unsigned i = 0; i < length; ++i)
+    {
+        double angle = -2.0 * pi * i / length;
+        twiddles[i] = Complex(std::cos(angle), std::sin(angle));
+    }
+
+    // Factor the length into small radixes, preferring 4 since it has the cheapest butterfly
+    unsigned remaining = length;
+    while (remaining > 1 && !useBluestein)
+    {
+        unsigned radix = 0;
+        if (remaining % 4 == 0)
+            radix = 4;
+        else
+        {
+            for (unsigned p = 2; p <= maxRadix && radix == 0; ++p)
+                if (remaining % p == 0)
+                    radix = p;
+        }
+        if (radix == 0)
+            useBluestein = true; // A large prime factor is left over
+        else
+        {
+            remaining /= radix;
+            factors.push_back(radix);
+            factors.push_back(remaining);
+        }
+    }
+
+    if (useBluestein)
+    {
+        // Turn the transform into a circular convolution with a chirp, done with a power of two length
+        unsigned convolutionSize = 1;
+        while (convolutionSize < length * 2 - 1)
+            convolutionSize *= 2;
+        inner = std::make_shared<FFT>(convolutionSize);
+
+        chirp.resize(length);
+        std::vector<Complex> filter(convolutionSize);
+        for (unsigned i = 0; i < length; ++i)
+        {
+            // Reduce i^2 modulo 2 * length to keep the angle precise for long transforms
+            unsigned long long square = (static_cast<unsigned long long>(i) * i) % (2ULL * length);
+            double angle = -pi * square / length;
+            chirp[i] = Complex(std::cos(angle), std::sin(angle));
+            filter[i] = std::conj(chirp[i]);
+            if (i > 0)
+                filter[convolutionSize - i] = filter[i];
+        }
+        inner->transform(filter.data());
+
+        // Fold the normalization of the inner inverse transform into the filter
+        chirpSpectrum.resize(convolutionSize);
+        for (unsigned i = 0; i < convolutionSize; ++i)
+            chirpSpectrum[i] = filter[i] / static_cast<float>(convolutionSize);
+    }
+}
+
+unsigned FFT::size() const
+{
+    return length;
+}
+
+void FFT::transform(Complex* data, bool inverse) const
+{
+    if (length > 1)
+    {
+        // The inverse transform is the conjugate of the forward transform of the conjugate
+        if (inverse)
+            for (unsigned i = 0; i < length; ++i)
+                data[i] = std::conj(data[i]);
+        forward(data);
+        if (inverse)
+            for (unsigned i = 0; i < length; ++i)
+                data[i] = std::conj(data[i]);
+    }
+}
+
+void FFT::forward(Complex* data) const
+{
+    if (useBluestein)
+        bluestein(data);
+    else
+    {
+        std::vector<Complex> input(data, data + length);
+        work(data, input.data(), 1, 0);
+    }
+}
+
+void FFT::work(Complex* out, const Complex* in, unsigned stride, unsigned factor) const
+{
+    unsigned radix = factors[factor];
+    unsigned count = factors[factor + 1];
+    Complex* outEnd = out + radix * count;
+
+    // Decimation in time: transform each of the interleaved sub-sequences first
+    if (count == 1)
+    {
+        for (Complex* o = out; o != outEnd; ++o, in += stride)
+            *o = *in;
+    }
+    else
+    {
+        for (Complex* o = out; o != outEnd; o += count, in += stride)
+            work(o, in, stride * radix, factor + 2);
+    }
+
+    // Then combine them
+    if (radix == 2)
+        butterfly2(out, stride, count);
+    else if (radix == 4)
+        butterfly4(out, stride, count);
+    else
+        butterflyGeneric(out, stride, radix, count);
+}
+
+void FFT::butterfly2(Complex* out, unsigned stride, unsigned count) const
+{
+    Complex* out2 = out + count;
+    for (unsigned k = 0; k < count; ++k)
+    {
+        Complex t = multiply(out2[k], twiddles[k * stride]);
+        out2[k] = out[k] - t;
+        out[k] += t;
+    }
+}
+
+void FFT::butterfly4(Complex* out, unsigned stride, unsigned count) const
+{
+    for (unsigned k = 0; k < count; ++k)
+    {
+        Complex s0 = multiply(out[k + count], twiddles[k * stride]);
+        Complex s1 = multiply(out[k + count * 2], twiddles[k * stride * 2]);
+        Complex s2 = multiply(out[k + count * 3], twiddles[k * stride * 3]);
+        Complex s5 = out[k] - s1;
+        out[k] += s1;
+        Complex s3 = s0 + s2;
+        Complex s4 = s0 - s2;
+        out[k + count * 2] = out[k] - s3;
+        out[k] += s3;
+        out[k + count] = Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+        out[k + count * 3] = Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+    }
+}
+
+void FFT::butterflyGeneric(Complex* out, unsigned stride, unsigned radix, unsigned count) const
+{
+    Complex temp[maxRadix];
+    for (unsigned u = 0; u < count; ++u)
+    {
+        for (unsigned q = 0; q < radix; ++q)
+            temp[q] = out[u + q * count];
+        for (unsigned q = 0; q < radix; ++q)
+        {
+            unsigned k = u + q * count;
+            unsigned twiddleIndex = 0;
+            out[k] = temp[0];
+            for (unsigned p = 1; p < radix; ++p)
+            {
+                twiddleIndex += stride * k;
+                if (twiddleIndex >= length)
+                    twiddleIndex -= length;
+                out[k] += multiply(temp[p], twiddles[twiddleIndex]);
+            }
+        }
+    }
+}
+
+void FFT::bluestein(Complex* data) const
+{
+    unsigned convolutionSize = inner->size();
+    std::vector<Complex> buffer(convolutionSize);
+    for (unsigned i = 0; i < length; ++i)
+        buffer[i] = multiply(data[i], chirp[i]);
+    inner->transform(buffer.data());
+    for (unsigned i = 0; i < convolutionSize; ++i)
+        buffer[i] = multiply(buffer[i], chirpSpectrum[i]);
+    inner->transform(buffer.data(), true);
+    for (unsigned i = 0; i < length; ++i)
+        data[i] = multiply(buffer[i], chirp[i]);
+}
+
+RealFFT2D::RealFFT2D():
+    width(0),
+    height(0)
+{
+}
+
+void RealFFT2D::setSize(unsigned width, unsigned height)
+{
+    this->width = width;
+    this->height = height;
+    rowFFT.setSize(width);
+    columnFFT.setSize(height);
+}
+
+unsigned RealFFT2D::spectrumWidth() const
+{
+    return width / 2 + 1;
+}
+
+void RealFFT2D::forward(const float* in, Complex* out) const
+{
+    unsigned half = spectrumWidth();
+    std::vector<Complex> row(width);
+    for (unsigned y = 0; y < height; y += 2)
+    {
+        // Pack two real rows into the real and imaginary parts of one complex row
+        const float* row0 = in + y * width;
+        const float* row1 = (y + 1 < height ? row0 + width : nullptr);
+        for (unsigned x = 0; x < width; ++x)
+            row[x] = Complex(row0[x], row1 ? row1[x] : 0.0f);
+        rowFFT.transform(row.data());
+
+        // Then separate the two spectra using their conjugate symmetry
+        for (unsigned k = 0; k < half; ++k)
+        {
+            Complex z = row[k];
+            Complex mirrored = std::conj(row[(width - k) % width]);
+            out[y * half + k] = (z + mirrored) * 0.5f;
+            Complex difference = z - mirrored;
+            if (row1)
+                out[(y + 1) * half + k] = Complex(difference.imag() * 0.5f, difference.real() * -0.5f);
+        }
+    }
+    columns(out, false);
+}
+
+void RealFFT2D::inverse(const Complex* in, float* out) const
+{
+    unsigned half = spectrumWidth();
+    std::vector<Complex> spectrum(in, in + height * half);
+    columns(spectrum.data(), true);
+
+    std::vector<Complex> row(width);
+    float scale = 1.0f / (static_cast<float>(width) * height);
+    for (unsigned y = 0; y < height; y += 2)
+    {
+        // Rebuild both full row spectra, and transform them together as a + ib
+        const Complex* spectrum0 = spectrum.data() + y * half;
+        const Complex* spectrum1 = (y + 1 < height ? spectrum0 + half : nullptr);
+        for (unsigned k = 0; k < width; ++k)
+        {
+            Complex a = (k < half ? spectrum0[k] : std::conj(spectrum0[width - k]));
+            Complex b;
+            if (spectrum1)
+                b = (k < half ? spectrum1[k] : std::conj(spectrum1[width - k]));
+            row[k] = a + Complex(-b.imag(), b.real());
+        }
+        rowFFT.transform(row.data(), true);
+
+        float* row0 = out + y * width;
+        for (unsigned x = 0; x < width; ++x)
+            row0[x] = row[x].real() * scale;
+        if (spectrum1)
+            for (unsigned x = 0; x < width; ++x)
+                row0[width + x] = row[x].imag() * scale;
+    }
+}
+
+void RealFFT2D::columns(Complex* data, bool inverse) const
+{
+    unsigned half = spectrumWidth();
+    std::vector<Complex> column(height);
+    for (unsigned x = 0; x < half; ++x)
+    {
+        for (unsigned y = 0; y < height; ++y)
+            column[y] = data[y * half + x];
+        columnFFT.transform(column.data(), inverse);
+        for (unsigned y = 0; y < height; ++y)
+            data[y * half + x] = column[y];
+    }
+}
@@ -0,0 +1,76 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <vector>
+#include <complex>
+#include <memory>
+
+/*
+A small fast Fourier transform for complex data of any length.
+Lengths made of small prime factors use a mixed radix Cooley-Tukey transform,
+other lengths fall back to Bluestein's algorithm on a power of two length.
+The transforms are not normalized, so an inverse after a forward transform
+scales everything by the length.
+*/
+class FFT
+{
+    public:
+        using Complex = std::complex<float>;
+
+        FFT();
+        FFT(unsigned size);
+        void setSize(unsigned size);
+        unsigned size() const;
+        void transform(Complex* data, bool inverse = false) const; // In-place transform of size() elements
+
+    private:
+        void forward(Complex* data) const;
+        void work(Complex* out, const Complex* in, unsigned stride, unsigned factor) const;
+        void butterfly2(Complex* out, unsigned stride, unsigned count) const;
+        void butterfly4(Complex* out, unsigned stride, unsigned count) const;
+        void butterflyGeneric(Complex* out, unsigned stride, unsigned radix, unsigned count) const;
+        void bluestein(Complex* data) const;
+
+        unsigned length;
+        std::vector<unsigned> factors; // Pairs of (radix, remaining length)
+        std::vector<Complex> twiddles;
+
+        // Only used by Bluestein's algorithm
+        bool useBluestein;
+        std::shared_ptr<const FFT> inner;
+        std::vector<Complex> chirp;
+        std::vector<Complex> chirpSpectrum;
+
+        static const unsigned maxRadix = 7;
+};
+
+/*
+Two dimensional FFT of a real valued row-major array.
+The spectrum is stored row by row, with (width / 2 + 1) columns per row,
+since the rest of a real signal's spectrum is redundant.
+Two rows are packed into each complex row transform to halve the work.
+*/
+class RealFFT2D
+{
+    public:
+        using Complex = FFT::Complex;
+
+        RealFFT2D();
+        void setSize(unsigned width, unsigned height);
+        unsigned spectrumWidth() const; // Number of complex columns in the spectrum
+        void forward(const float* in, Complex* out) const; // width * height floats to height * spectrumWidth() values
+        void inverse(const Complex* in, float* out) const; // Normalized, so forward then inverse is the identity
+
+    private:
+        void columns(Complex* data, bool inverse) const;
+
+        unsigned width;
+        unsigned height;
+        FFT rowFFT;
+        FFT columnFFT;
+};
+
+#endif
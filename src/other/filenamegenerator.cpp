@@ -11,6 +11,7 @@ FilenameGenerator::FilenameGenerator():
 void FilenameGenerator::setFormat(const std::string& str)
 {
     format = str;
+    currentNum = 0;
 }
 
 std::string FilenameGenerator::getNextFilename() const
@@ -21,20 +22,52 @@ std::string FilenameGenerator::getNextFilename() const
 
 std::string FilenameGenerator::getFilename() const
 {
-    std::string filename(format);
-    if (filename.find("%n") == std::string::npos)
-        filename += " %n.png";
-    strlib::replaceAll(filename, "%n", std::to_string(currentNum));
-    return filename;
+    return getFilename(currentNum);
 }
 
 void FilenameGenerator::findNext() const
 {
-    bool status = true;
-    while (status)
+    if (currentNum == 0)
     {
+        // Double the number until it's unused, then binary search for the first unused number after a used one,
+        // so a folder with thousands of files only takes a few dozen checks
+        int used = 0;
+        int unused = 1;
+        while (exists(unused))
+        {
+            used = unused;
+            unused *= 2;
+        }
+        while (unused - used > 1)
+        {
+            int middle = used + (unused - used) / 2;
+            if (exists(middle))
+                used = middle;
+            else
+                unused = middle;
+        }
+        currentNum = unused;
+    }
+    else
+    {
+        // There can be gaps in the numbers, so skip over any files that came after one
         ++currentNum;
-        std::ifstream file(getFilename().c_str());
-        status = file.good();
+        while (exists(currentNum))
+            ++currentNum;
     }
 }
+
+std::string FilenameGenerator::getFilename(int num) const
+{
+    std::string filename(format);
+    if (filename.find("%n") == std::string::npos)
+        filename += " %n.png";
+    strlib::replaceAll(filename, "%n", std::to_string(num));
+    return filename;
+}
+
+bool FilenameGenerator::exists(int num) const
+{
+    std::ifstream file(getFilename(num).c_str());
+    return file.good();
+}
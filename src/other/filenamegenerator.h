@@ -10,11 +10,14 @@ class FilenameGenerator
         void setFormat(const std::string& str); // %n is replaced with the number
         std::string getNextFilename() const; // Finds the next filename, and returns it
         std::string getFilename() const; // Returns generated filename
-        void findNext() const; // Finds the next unused filename
+        void findNext() const; // Finds the next unused filename (the first one is searched for, then it counts up past any used ones)
 
     private:
+        std::string getFilename(int num) const;
+        bool exists(int num) const;
+
         std::string format;
-        mutable int currentNum;
+        mutable int currentNum; // 0 until the first unused filename was found
 };
 
 #endif
@@ -0,0 +1,164 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "mappedfile.h"
+#include <fstream>
+#include <iterator>
+#include <limits>
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+MappedFile::MappedFile():
+    fileData(nullptr),
+    fileSize(0),
+    mapped(false),
+    opened(false)
+#ifdef _WIN32
+    ,
+    fileHandle(nullptr),
+    mappingHandle(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+    if (filename.empty())
+        return false;
+    if (map(filename))
+    {
+        opened = true;
+        return true;
+    }
+
+    // Fall back to reading the whole file
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        return false;
+    buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    fileData = buffer.data();
+    fileSize = buffer.size();
+    opened = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    unmap();
+    buffer.clear();
+    buffer.shrink_to_fit();
+    fileData = nullptr;
+    fileSize = 0;
+    opened = false;
+}
+
+bool MappedFile::isOpen() const
+{
+    return opened;
+}
+
+const char* MappedFile::data() const
+{
+    return fileData;
+}
+
+std::uint64_t MappedFile::size() const
+{
+    return fileSize;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::map(const std::string& filename)
+{
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || static_cast<std::uint64_t>(size.QuadPart) > std::numeric_limits<size_t>::max())
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = (mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr);
+    if (!view)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    fileData = static_cast<const char*>(view);
+    fileSize = size.QuadPart;
+    mapped = true;
+    return true;
+}
+
+void MappedFile::unmap()
+{
+    if (mapped)
+    {
+        UnmapViewOfFile(fileData);
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+        mapped = false;
+    }
+}
+
+#else
+
+bool MappedFile::map(const std::string& filename)
+{
+    int file = ::open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat status;
+    if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size == 0 ||
+        static_cast<std::uint64_t>(status.st_size) > std::numeric_limits<size_t>::max())
+    {
+        ::close(file);
+        return false;
+    }
+    void* view = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file); // The mapping keeps the file open
+    if (view == MAP_FAILED)
+        return false;
+    fileData = static_cast<const char*>(view);
+    fileSize = status.st_size;
+    mapped = true;
+    return true;
+}
+
+void MappedFile::unmap()
+{
+    if (mapped)
+    {
+        munmap(const_cast<char*>(fileData), fileSize);
+        mapped = false;
+    }
+}
+
+#endif
@@ -0,0 +1,45 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+This class maps a whole file into memory for reading, so it can be used like a big array without copying it first.
+Only the pages that are actually touched get read from the disk, and the operating system can read them ahead.
+If the file can't be mapped (like a pipe), it is read into a buffer instead, so it works the same either way.
+*/
+class MappedFile
+{
+    public:
+        MappedFile();
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& filename);
+        void close();
+        bool isOpen() const;
+        const char* data() const;
+        std::uint64_t size() const;
+
+    private:
+        bool map(const std::string& filename); // Returns false if the file couldn't be mapped
+        void unmap();
+
+        const char* fileData;
+        std::uint64_t fileSize;
+        bool mapped;
+        bool opened;
+        std::vector<char> buffer; // Only used if the file couldn't be mapped
+#ifdef _WIN32
+        void* fileHandle;
+        void* mappingHandle;
+#endif
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <fstream>
 #include <iostream>
 #include <SFML/System/Vector2.hpp>
+#include "bitpacking.h"
 
 /*
 This class is a wrapper around a single dimensional array so that it can be used like a 2D array.
@@ -25,11 +26,13 @@ class Matrix
 
         Matrix(unsigned width, unsigned height)
         {
+            clear();
             resize(width, height);
         }
 
         Matrix(const sf::Vector2u& newSize)
         {
+            clear();
             resize(newSize.x, newSize.y);
         }
 
@@ -84,6 +87,27 @@ class Matrix
             return elements[(pos.y * matrixWidth) + pos.x];
         }
 
+        const Type& operator()(unsigned x, unsigned y) const
+        {
+            return elements[(y * matrixWidth) + x];
+        }
+
+        const Type& operator()(const sf::Vector2u& pos) const
+        {
+            return elements[(pos.y * matrixWidth) + pos.x];
+        }
+
+        // Direct access to the elements, which are stored row by row
+        Type* data()
+        {
+            return elements.data();
+        }
+
+        const Type* data() const
+        {
+            return elements.data();
+        }
+
         unsigned width() const
         {
             return matrixWidth;
@@ -108,16 +132,15 @@ class Matrix
             if (!filename.empty())
             {
                 // Create a buffer for the file
-                unsigned fileSize = (matrixSize / 8) + 8; // 8 extra bytes for width and height
+                unsigned fileSize = ((matrixSize + 7) / 8) + 8; // 8 extra bytes for width and height
                 std::vector<char> fileData(fileSize, 0);
 
                 // Store the width and height in the buffer
                 writeUintToString(fileData.data(), matrixWidth);
                 writeUintToString(fileData.data() + 4, matrixHeight);
 
-                // Pack the bits into the buffer
-                for (unsigned i = 0; i < matrixSize; ++i)
-                    fileData[(i / 8) + 8] |= (((elements[i] != 0) & 0x1) << (i % 8));
+                // Pack the bits into the buffer, 8 cells at a time
+                BitPacking::pack(elements.data(), matrixSize, reinterpret_cast<unsigned char*>(fileData.data() + 8));
 
                 // Write the buffer to the file
                 std::ofstream outFile(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
@@ -165,10 +188,9 @@ class Matrix
 
                         // std::cout << "loadFromFile(): newWidth = " << newWidth << ", newHeight = " << newHeight << "\n";
 
-                        // Unpack the bits into the matrix
+                        // Unpack the bits into the matrix, 8 cells at a time
                         unsigned minSize = std::min(((fileSize - 8) * 8), matrixSize); // In case the file is larger or smaller
-                        for (unsigned i = 0; i < minSize; ++i)
-                            elements[i] = ((fileData[(i / 8) + 8] >> (i % 8)) & 0x1);
+                        BitPacking::unpack(reinterpret_cast<const unsigned char*>(fileData.data() + 8), 0, minSize, elements.data());
 
                         // Fill the remaining part of the matrix if the file was not large enough
                         if (minSize < matrixSize)
@@ -0,0 +1,44 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+/*
+This class spreads loops across all of the cores, for work that splits into pieces that don't depend on each other.
+The pieces are handed out one at a time, so a few slow ones don't hold up the rest.
+*/
+class Parallel
+{
+    public:
+        // Returns how many threads are used for a loop of count pieces
+        static unsigned getThreadCount(unsigned count)
+        {
+            return std::min(std::max(std::thread::hardware_concurrency(), 1u), count);
+        }
+
+        // Runs the function for every index from 0 to count - 1, spread across all of the cores
+        static void forEach(unsigned count, const std::function<void(unsigned)>& function)
+        {
+            std::atomic<unsigned> next(0);
+            auto worker = [&]()
+            {
+                for (unsigned i = next++; i < count; i = next++)
+                    function(i);
+            };
+            std::vector<std::thread> threads;
+            for (unsigned i = 1; i < getThreadCount(count); ++i)
+                threads.emplace_back(worker);
+            worker();
+            for (auto& thread: threads)
+                thread.join();
+        }
+};
+
+#endif
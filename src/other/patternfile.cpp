@@ -0,0 +1,742 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "patternfile.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include "bitpacking.h"
+#include "trace.h"
+
+namespace
+{
+    const int endOfFile = -1;
+    const unsigned maxLineLength = 70; // RLE lines are kept this short, like other programs do
+    const unsigned maxLevel = 62; // Bigger macrocell trees wouldn't fit in the coordinates
+
+    // Reads a file one character at a time through a buffer, so big files don't need to fit in memory
+    class Reader
+    {
+        public:
+            Reader(std::ifstream& file):
+                file(file),
+                position(0),
+                size(0)
+            {
+            }
+
+            int peek()
+            {
+                if (position == size && !fill())
+                    return endOfFile;
+                return static_cast<unsigned char>(buffer[position]);
+            }
+
+            int get()
+            {
+                int c = peek();
+                if (c != endOfFile)
+                    ++position;
+                return c;
+            }
+
+            void skipSpaces()
+            {
+                while (peek() == ' ' || peek() == '\t' || peek() == '\r')
+                    get();
+            }
+
+            void skipLine()
+            {
+                for (int c = get(); c != endOfFile && c != '\n'; c = get());
+            }
+
+            std::string readLine() // Only used for short lines, like headers and comments
+            {
+                std::string line;
+                for (int c = get(); c != endOfFile && c != '\n'; c = get())
+                    if (c != '\r')
+                        line += static_cast<char>(c);
+                return line;
+            }
+
+            bool readInt(std::int64_t& value)
+            {
+                skipSpaces();
+                bool negative = (peek() == '-');
+                if (negative || peek() == '+')
+                    get();
+                if (peek() < '0' || peek() > '9')
+                    return false;
+                value = 0;
+                while (peek() >= '0' && peek() <= '9')
+                    value = value * 10 + (get() - '0');
+                if (negative)
+                    value = -value;
+                return true;
+            }
+
+        private:
+            bool fill()
+            {
+                file.read(buffer, sizeof(buffer));
+                size = file.gcount();
+                position = 0;
+                return (size > 0);
+            }
+
+            std::ifstream& file;
+            char buffer[1 << 16];
+            std::size_t position;
+            std::size_t size;
+    };
+
+    // Draws cells into the board, where (0, 0) is the middle of the board, and anything off of the board is cut off
+    class Canvas
+    {
+        public:
+            Canvas(Matrix<char>& cells):
+                cells(cells),
+                originX(cells.width() / 2),
+                originY(cells.height() / 2)
+            {
+            }
+
+            void set(std::int64_t x, std::int64_t y, unsigned state)
+            {
+                x += originX;
+                y += originY;
+                if (x >= 0 && y >= 0 && x < cells.width() && y < cells.height())
+                    cells(x, y) = static_cast<char>(std::min(state, 127u));
+            }
+
+            void setRun(std::int64_t x, std::int64_t y, std::int64_t count, unsigned state)
+            {
+                x += originX;
+                y += originY;
+                if (y < 0 || y >= cells.height())
+                    return;
+                std::int64_t start = std::max<std::int64_t>(x, 0);
+                std::int64_t end = std::min<std::int64_t>(x + count, cells.width());
+                char value = static_cast<char>(std::min(state, 127u));
+                for (std::int64_t i = start; i < end; ++i)
+                    cells(i, y) = value;
+            }
+
+            bool overlaps(std::int64_t x, std::int64_t y, std::int64_t size) const
+            {
+                x += originX;
+                y += originY;
+                return (x < cells.width() && y < cells.height() && x + size > 0 && y + size > 0);
+            }
+
+        private:
+            Matrix<char>& cells;
+            std::int64_t originX;
+            std::int64_t originY;
+    };
+
+    std::string trim(const std::string& str)
+    {
+        auto start = str.find_first_not_of(" \t");
+        if (start == std::string::npos)
+            return "";
+        return str.substr(start, str.find_last_not_of(" \t") - start + 1);
+    }
+
+    bool loadRLE(Reader& reader, Canvas& canvas, std::string& rules)
+    {
+        // Comments, which can have the position of the pattern
+        std::int64_t left = 0;
+        std::int64_t top = 0;
+        bool positioned = false;
+        while (reader.peek() == '#')
+        {
+            std::string comment = reader.readLine();
+            auto pos = comment.find("Pos=");
+            if (comment.compare(0, 7, "#CXRLE ") == 0 && pos != std::string::npos)
+            {
+                left = std::atoll(comment.c_str() + pos + 4);
+                auto comma = comment.find(',', pos);
+                top = (comma != std::string::npos ? std::atoll(comment.c_str() + comma + 1) : 0);
+                positioned = true;
+            }
+        }
+
+        // The header, like "x = 3, y = 3, rule = B3/S23"
+        reader.skipSpaces();
+        if (reader.peek() != 'x')
+        {
+            std::cerr << "Error: RLE files need a header with the size.\n";
+            return false;
+        }
+        std::int64_t width = 0;
+        std::int64_t height = 0;
+        std::string header = reader.readLine();
+        std::size_t start = 0;
+        while (start < header.size())
+        {
+            auto end = std::min(header.find(',', start), header.size());
+            auto equals = header.find('=', start);
+            if (equals < end)
+            {
+                std::string key = trim(header.substr(start, equals - start));
+                std::string value = trim(header.substr(equals + 1, end - equals - 1));
+                if (key == "x")
+                    width = std::atoll(value.c_str());
+                else if (key == "y")
+                    height = std::atoll(value.c_str());
+                else if (key == "rule")
+                    rules = value;
+            }
+            start = end + 1;
+        }
+        if (!positioned)
+        {
+            left = -width / 2;
+            top = -height / 2;
+        }
+
+        // The cells, where each tag can have a count in front of it
+        std::int64_t x = 0;
+        std::int64_t y = 0;
+        std::int64_t count = 0;
+        unsigned prefix = 0;
+        for (int c = reader.get(); c != endOfFile && c != '!'; c = reader.get())
+        {
+            if (c >= '0' && c <= '9')
+                count = count * 10 + (c - '0');
+            else if (c >= 'p' && c <= 'y')
+                prefix = c - 'p' + 1; // The count goes with the letter after it
+            else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+                continue;
+            else
+            {
+                std::int64_t runLength = (count > 0 ? count : 1);
+                count = 0;
+                if (c == 'b' || c == '.')
+                    x += runLength;
+                else if (c == 'o')
+                {
+                    canvas.setRun(left + x, top + y, runLength, 1);
+                    x += runLength;
+                }
+                else if (c >= 'A' && c <= 'X')
+                {
+                    canvas.setRun(left + x, top + y, runLength, prefix * 24 + (c - 'A') + 1);
+                    x += runLength;
+                }
+                else if (c == '$')
+                {
+                    y += runLength;
+                    x = 0;
+                }
+                prefix = 0;
+            }
+        }
+        return true;
+    }
+
+    bool loadPlaintext(Reader& reader, Canvas& canvas)
+    {
+        std::int64_t x = 0;
+        std::int64_t y = 0;
+        while (reader.peek() != endOfFile)
+        {
+            // Lines starting with "!" are comments
+            if (reader.peek() == '!')
+            {
+                reader.skipLine();
+                continue;
+            }
+            for (int c = reader.get(); c != endOfFile && c != '\n'; c = reader.get())
+            {
+                if (c == 'O' || c == '*')
+                    canvas.set(x, y, 1);
+                if (c != '\r')
+                    ++x;
+            }
+            x = 0;
+            ++y;
+        }
+        return true;
+    }
+
+    bool loadLife106(Reader& reader, Canvas& canvas)
+    {
+        while (reader.peek() != endOfFile)
+        {
+            reader.skipSpaces();
+            if (reader.peek() == '#')
+            {
+                if (reader.readLine().compare(0, 10, "#Life 1.05") == 0)
+                {
+                    std::cerr << "Error: Life 1.05 files aren't supported, only Life 1.06.\n";
+                    return false;
+                }
+                continue;
+            }
+            std::int64_t x = 0;
+            std::int64_t y = 0;
+            if (reader.readInt(x) && reader.readInt(y))
+                canvas.set(x, y, 1);
+            reader.skipLine();
+        }
+        return true;
+    }
+
+    // Either a leaf with 8x8 cells (in the first two children), a level 1 node of four states, or four child nodes
+    struct MacrocellNode
+    {
+        std::uint32_t children[4];
+        std::uint8_t level;
+        bool leaf;
+    };
+
+    void drawMacrocellNode(const std::vector<MacrocellNode>& nodes, std::uint32_t id, std::int64_t x, std::int64_t y, Canvas& canvas)
+    {
+        const MacrocellNode& node = nodes[id];
+        if (id == 0 || !canvas.overlaps(x, y, std::int64_t(1) << node.level))
+            return;
+        if (node.leaf)
+        {
+            std::uint64_t bits = node.children[0] | (static_cast<std::uint64_t>(node.children[1]) << 32);
+            for (; bits; bits &= bits - 1)
+            {
+                unsigned bit = BitPacking::lowestBit(bits);
+                canvas.set(x + bit % 8, y + bit / 8, 1);
+            }
+        }
+        else if (node.level == 1)
+        {
+            for (unsigned i = 0; i < 4; ++i)
+                if (node.children[i])
+                    canvas.set(x + i % 2, y + i / 2, node.children[i]);
+        }
+        else
+        {
+            std::int64_t half = std::int64_t(1) << (node.level - 1);
+            for (unsigned i = 0; i < 4; ++i)
+                drawMacrocellNode(nodes, node.children[i], x + (i % 2) * half, y + (i / 2) * half, canvas);
+        }
+    }
+
+    bool loadMacrocell(Reader& reader, Canvas& canvas, std::string& rules)
+    {
+        if (reader.readLine().compare(0, 4, "[M2]") != 0)
+        {
+            std::cerr << "Error: Macrocell files need to start with \"[M2]\".\n";
+            return false;
+        }
+
+        // Each line is a node, which can only use the nodes before it (node 0 is empty)
+        std::vector<MacrocellNode> nodes(1, MacrocellNode{{0, 0, 0, 0}, 0, false});
+        for (int c = reader.peek(); c != endOfFile; c = reader.peek())
+        {
+            if (c == '#')
+            {
+                std::string comment = reader.readLine();
+                if (comment.compare(0, 2, "#R") == 0)
+                    rules = trim(comment.substr(2));
+            }
+            else if (c == '.' || c == '*' || c == '$')
+            {
+                // A leaf with 8x8 cells, where each row ends with "$"
+                std::uint64_t bits = 0;
+                unsigned x = 0;
+                unsigned y = 0;
+                for (c = reader.get(); c != endOfFile && c != '\n'; c = reader.get())
+                {
+                    if (c == '$')
+                    {
+                        x = 0;
+                        ++y;
+                    }
+                    else if (x < 8 && y < 8)
+                    {
+                        if (c == '*')
+                            bits |= std::uint64_t(1) << (y * 8 + x);
+                        ++x;
+                    }
+                }
+                nodes.push_back(MacrocellNode{{static_cast<std::uint32_t>(bits), static_cast<std::uint32_t>(bits >> 32), 0, 0}, 3, true});
+            }
+            else if (c >= '0' && c <= '9')
+            {
+                std::int64_t values[5] = {0, 0, 0, 0, 0};
+                for (auto& value: values)
+                    reader.readInt(value);
+                reader.skipLine();
+                MacrocellNode node{{0, 0, 0, 0}, static_cast<std::uint8_t>(values[0]), false};
+                if (values[0] < 1 || values[0] > maxLevel)
+                {
+                    std::cerr << "Error: Macrocell node " << nodes.size() << " has an unsupported level.\n";
+                    return false;
+                }
+                for (unsigned i = 0; i < 4; ++i)
+                {
+                    // Level 1 nodes have states instead of children
+                    if (values[i + 1] < 0 || (node.level > 1 && values[i + 1] >= static_cast<std::int64_t>(nodes.size())))
+                    {
+                        std::cerr << "Error: Macrocell node " << nodes.size() << " refers to a node that doesn't exist.\n";
+                        return false;
+                    }
+                    node.children[i] = values[i + 1];
+
+                    // Each child has to be half the size, or the drawing could go on forever
+                    if (node.level > 1 && node.children[i] != 0 && nodes[node.children[i]].level != node.level - 1)
+                    {
+                        std::cerr << "Error: Macrocell node " << nodes.size() << " has a child with the wrong level.\n";
+                        return false;
+                    }
+                }
+                nodes.push_back(node);
+            }
+            else
+                reader.skipLine();
+        }
+
+        // The last node is the root, which is centered on the origin
+        if (nodes.size() > 1)
+        {
+            std::int64_t half = (std::int64_t(1) << nodes.back().level) / 2;
+            drawMacrocellNode(nodes, nodes.size() - 1, -half, -half, canvas);
+        }
+        return true;
+    }
+
+    // The bounding box of the cells that aren't dead, and the highest state
+    struct Bounds
+    {
+        unsigned left;
+        unsigned top;
+        unsigned right; // One past the last column
+        unsigned bottom; // One past the last row
+        unsigned maxState;
+    };
+
+    Bounds findBounds(const Matrix<char>& cells)
+    {
+        Bounds bounds{cells.width(), cells.height(), 0, 0, 0};
+        for (unsigned y = 0; y < cells.height(); ++y)
+        {
+            for (unsigned x = 0; x < cells.width(); ++x)
+            {
+                unsigned state = static_cast<unsigned char>(cells(x, y));
+                if (state)
+                {
+                    bounds.left = std::min(bounds.left, x);
+                    bounds.top = std::min(bounds.top, y);
+                    bounds.right = std::max(bounds.right, x + 1);
+                    bounds.bottom = std::max(bounds.bottom, y + 1);
+                    bounds.maxState = std::max(bounds.maxState, state);
+                }
+            }
+        }
+        if (bounds.right == 0)
+            bounds.left = bounds.top = 0;
+        return bounds;
+    }
+
+    // Writes RLE tags, and starts a new line before they get too long
+    class RLEWriter
+    {
+        public:
+            RLEWriter(std::ofstream& file, bool multiState):
+                file(file),
+                multiState(multiState),
+                lineLength(0)
+            {
+            }
+
+            void add(std::uint64_t count, unsigned state)
+            {
+                char tag[3] = {0, 0, 0};
+                if (!multiState)
+                    tag[0] = (state ? 'o' : 'b');
+                else if (state == 0)
+                    tag[0] = '.';
+                else if (state <= 24)
+                    tag[0] = 'A' + (state - 1);
+                else
+                {
+                    tag[0] = 'p' + ((state - 1) / 24 - 1);
+                    tag[1] = 'A' + (state - 1) % 24;
+                }
+                addTag(count, tag);
+            }
+
+            void addTag(std::uint64_t count, const char* tag)
+            {
+                std::string token = (count > 1 ? std::to_string(count) : "") + tag;
+                if (lineLength + token.size() > maxLineLength)
+                {
+                    file << '\n';
+                    lineLength = 0;
+                }
+                file << token;
+                lineLength += token.size();
+            }
+
+        private:
+            std::ofstream& file;
+            bool multiState;
+            unsigned lineLength;
+    };
+
+    void saveRLE(std::ofstream& file, const Matrix<char>& cells, const std::string& rules, const Bounds& bounds)
+    {
+        std::int64_t originX = cells.width() / 2;
+        std::int64_t originY = cells.height() / 2;
+        file << "#CXRLE Pos=" << (bounds.left - originX) << ',' << (bounds.top - originY) << '\n';
+        file << "x = " << (bounds.right - bounds.left) << ", y = " << (bounds.bottom - bounds.top) << ", rule = " << rules << '\n';
+
+        RLEWriter writer(file, bounds.maxState > 1);
+        std::uint64_t rowEnds = 0;
+        for (unsigned y = bounds.top; y < bounds.bottom; ++y)
+        {
+            unsigned x = bounds.left;
+            while (x < bounds.right)
+            {
+                unsigned state = static_cast<unsigned char>(cells(x, y));
+                unsigned end = x + 1;
+                while (end < bounds.right && static_cast<unsigned char>(cells(end, y)) == state)
+                    ++end;
+                // Dead cells at the end of a row are left out
+                if (state || end < bounds.right)
+                {
+                    if (rowEnds)
+                        writer.addTag(rowEnds, "$");
+                    rowEnds = 0;
+                    writer.add(end - x, state);
+                }
+                x = end;
+            }
+            ++rowEnds;
+        }
+        writer.addTag(1, "!");
+        file << '\n';
+    }
+
+    void savePlaintext(std::ofstream& file, const Matrix<char>& cells, const std::string& filename, const Bounds& bounds)
+    {
+        file << "!Name: " << filename << '\n';
+        for (unsigned y = bounds.top; y < bounds.bottom; ++y)
+        {
+            unsigned end = bounds.right;
+            while (end > bounds.left && !cells(end - 1, y))
+                --end;
+            for (unsigned x = bounds.left; x < end; ++x)
+                file << (cells(x, y) ? 'O' : '.');
+            file << '\n';
+        }
+    }
+
+    void saveLife106(std::ofstream& file, const Matrix<char>& cells, const Bounds& bounds)
+    {
+        std::int64_t originX = cells.width() / 2;
+        std::int64_t originY = cells.height() / 2;
+        file << "#Life 1.06\n";
+        for (unsigned y = bounds.top; y < bounds.bottom; ++y)
+            for (unsigned x = bounds.left; x < bounds.right; ++x)
+                if (cells(x, y))
+                    file << (x - originX) << ' ' << (y - originY) << '\n';
+    }
+
+    // Writes the quadtree from the bottom up, and only writes each distinct node once
+    class MacrocellWriter
+    {
+        public:
+            MacrocellWriter(std::ofstream& file, const Matrix<char>& cells, const Bounds& bounds):
+                file(file),
+                cells(cells),
+                bounds(bounds),
+                leafLevel(bounds.maxState > 1 ? 1 : 3),
+                nodeCount(0)
+            {
+            }
+
+            // Writes the node with its top left corner at a position on the board, returns its number (0 if it's empty)
+            std::uint32_t write(unsigned level, std::int64_t x, std::int64_t y)
+            {
+                std::int64_t size = std::int64_t(1) << level;
+                if (x >= bounds.right || y >= bounds.bottom || x + size <= bounds.left || y + size <= bounds.top)
+                    return 0;
+                if (level == 3 && leafLevel == 3)
+                    return writeLeaf(x, y);
+
+                NodeKey key{{level, 0, 0, 0, 0}};
+                if (level == 1)
+                {
+                    for (unsigned i = 0; i < 4; ++i)
+                        key[i + 1] = getState(x + i % 2, y + i / 2);
+                }
+                else
+                {
+                    std::int64_t half = size / 2;
+                    for (unsigned i = 0; i < 4; ++i)
+                        key[i + 1] = write(level - 1, x + (i % 2) * half, y + (i / 2) * half);
+                }
+                if (!key[1] && !key[2] && !key[3] && !key[4])
+                    return 0;
+                auto found = nodes.find(key);
+                if (found != nodes.end())
+                    return found->second;
+                file << level << ' ' << key[1] << ' ' << key[2] << ' ' << key[3] << ' ' << key[4] << '\n';
+                return (nodes[key] = ++nodeCount);
+            }
+
+        private:
+            using NodeKey = std::array<std::uint32_t, 5>;
+
+            struct NodeHash
+            {
+                std::size_t operator()(const NodeKey& key) const
+                {
+                    std::uint64_t hash = 14695981039346656037ull;
+                    for (auto value: key)
+                        hash = (hash ^ value) * 1099511628211ull;
+                    return hash;
+                }
+            };
+
+            unsigned getState(std::int64_t x, std::int64_t y) const
+            {
+                if (x < 0 || y < 0 || x >= cells.width() || y >= cells.height())
+                    return 0;
+                return static_cast<unsigned char>(cells(x, y));
+            }
+
+            std::uint32_t writeLeaf(std::int64_t x, std::int64_t y)
+            {
+                std::uint64_t bits = 0;
+                for (unsigned i = 0; i < 64; ++i)
+                    if (getState(x + i % 8, y + i / 8))
+                        bits |= std::uint64_t(1) << i;
+                if (!bits)
+                    return 0;
+                auto found = leaves.find(bits);
+                if (found != leaves.end())
+                    return found->second;
+
+                // Each row ends with "$", and dead cells at the ends of rows (and empty rows at the end) are left out
+                unsigned rows = 8;
+                while (!((bits >> ((rows - 1) * 8)) & 0xFF))
+                    --rows;
+                for (unsigned row = 0; row < rows; ++row)
+                {
+                    unsigned rowBits = (bits >> (row * 8)) & 0xFF;
+                    for (unsigned column = 0; rowBits >> column; ++column)
+                        file << ((rowBits >> column) & 1 ? '*' : '.');
+                    file << '$';
+                }
+                file << '\n';
+                return (leaves[bits] = ++nodeCount);
+            }
+
+            std::ofstream& file;
+            const Matrix<char>& cells;
+            const Bounds& bounds;
+            unsigned leafLevel;
+            std::uint32_t nodeCount;
+            std::unordered_map<std::uint64_t, std::uint32_t> leaves;
+            std::unordered_map<NodeKey, std::uint32_t, NodeHash> nodes;
+    };
+
+    void saveMacrocell(std::ofstream& file, const Matrix<char>& cells, const std::string& rules, const Bounds& bounds)
+    {
+        file << "[M2] (Cells)\n";
+        file << "#R " << rules << '\n';
+        if (bounds.right == 0)
+            return;
+
+        // The root is centered on the origin, so it has to be big enough to reach every cell from there
+        std::int64_t originX = cells.width() / 2;
+        std::int64_t originY = cells.height() / 2;
+        std::int64_t reach = std::max({originX - bounds.left, bounds.right - originX, originY - bounds.top, bounds.bottom - originY});
+        unsigned level = 3;
+        while ((std::int64_t(1) << (level - 1)) < reach)
+            ++level;
+        std::int64_t half = std::int64_t(1) << (level - 1);
+        if (!MacrocellWriter(file, cells, bounds).write(level, originX - half, originY - half))
+            file << "$\n"; // Can't happen since the bounds aren't empty, but the file needs a node
+    }
+}
+
+PatternFile::Format PatternFile::getFormat(const std::string& filename)
+{
+    auto dot = filename.rfind('.');
+    if (dot == std::string::npos)
+        return Format::None;
+    std::string extension = filename.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == "rle")
+        return Format::RLE;
+    if (extension == "cells")
+        return Format::Plaintext;
+    if (extension == "lif" || extension == "life")
+        return Format::Life106;
+    if (extension == "mc")
+        return Format::Macrocell;
+    return Format::None;
+}
+
+bool PatternFile::load(const std::string& filename, Matrix<char>& cells, std::string& rules)
+{
+    TRACE_SCOPE("PatternFile::load");
+    Format format = getFormat(filename);
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (format == Format::None || !file.is_open())
+        return false;
+    rules.clear();
+    std::fill(cells.data(), cells.data() + cells.size(), 0);
+
+    Reader reader(file);
+    Canvas canvas(cells);
+    switch (format)
+    {
+        case Format::RLE:
+            return loadRLE(reader, canvas, rules);
+        case Format::Plaintext:
+            return loadPlaintext(reader, canvas);
+        case Format::Life106:
+            return loadLife106(reader, canvas);
+        case Format::Macrocell:
+            return loadMacrocell(reader, canvas, rules);
+        default:
+            return false;
+    }
+}
+
+bool PatternFile::save(const std::string& filename, const Matrix<char>& cells, const std::string& rules)
+{
+    TRACE_SCOPE("PatternFile::save");
+    Format format = getFormat(filename);
+    std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (format == Format::None || !file.is_open())
+        return false;
+
+    Bounds bounds = findBounds(cells);
+    switch (format)
+    {
+        case Format::RLE:
+            saveRLE(file, cells, rules, bounds);
+            break;
+        case Format::Plaintext:
+            savePlaintext(file, cells, filename, bounds);
+            break;
+        case Format::Life106:
+            saveLife106(file, cells, bounds);
+            break;
+        case Format::Macrocell:
+            saveMacrocell(file, cells, rules, bounds);
+            break;
+        default:
+            break;
+    }
+    return file.good();
+}
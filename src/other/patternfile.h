@@ -0,0 +1,40 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef PATTERNFILE_H
+#define PATTERNFILE_H
+
+#include <string>
+#include "matrix.h"
+
+/*
+This class reads and writes patterns in the formats that other Life programs use, picked from the extension:
+    .rle: Run length encoded, with the multi-state letters (A to X, with p to y prefixes) for more than 2 states
+    .cells: Plaintext, where "." is dead and "O" is live (only live or dead)
+    .lif, .life: Life 1.06, with a line of coordinates for each live cell (only live or dead)
+    .mc: Golly's macrocell format, a quadtree where identical nodes are only stored once
+Patterns don't have a board size, so they're loaded into the middle of the board (which keeps its size),
+    and anything that doesn't fit is cut off. Like Golly, the middle of the board is the origin:
+    RLE patterns are centered on it, plaintext patterns have their top left corner on it,
+    Life 1.06 coordinates are relative to it, and macrocell trees are centered on it.
+Files are read in a single pass through a small buffer, and cells are drawn straight into the board,
+    so the memory used doesn't grow with the size of the file (besides the nodes of macrocell trees).
+*/
+class PatternFile
+{
+    public:
+        enum class Format
+        {
+            None, // Not a pattern file
+            RLE,
+            Plaintext,
+            Life106,
+            Macrocell
+        };
+
+        static Format getFormat(const std::string& filename); // Picks the format from the extension
+        static bool load(const std::string& filename, Matrix<char>& cells, std::string& rules); // Clears the cells, then draws the pattern (rules is empty if the file doesn't have any)
+        static bool save(const std::string& filename, const Matrix<char>& cells, const std::string& rules);
+};
+
+#endif
@@ -0,0 +1,70 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <array>
+#include <cstdint>
+
+/*
+A counter-based random number generator (Philox4x32-10, from "Parallel Random Numbers: As Easy as 1, 2, 3").
+Instead of keeping a state that changes every time a number is generated,
+    each counter is scrambled with a key into 4 random 32-bit numbers.
+So the numbers for something like (generation, x, y) are always the same,
+    no matter which order (or which thread) they are generated in.
+There are no branches or tables, so loops that use it can be vectorized by the compiler.
+*/
+class Philox
+{
+    public:
+        using Counter = std::array<std::uint32_t, 4>;
+        using Key = std::array<std::uint32_t, 2>;
+
+        Philox(std::uint32_t seed = 0, std::uint32_t stream = 0):
+            key{{seed, stream}}
+        {
+        }
+
+        // Returns the random numbers for a counter
+        Counter operator()(const Counter& counter) const
+        {
+            return generate(counter, key);
+        }
+
+        // Returns the random numbers for a cell in a generation
+        Counter operator()(std::uint64_t generation, std::uint32_t x, std::uint32_t y) const
+        {
+            return generate({{static_cast<std::uint32_t>(generation), static_cast<std::uint32_t>(generation >> 32), x, y}}, key);
+        }
+
+        // Returns true with a probability from 0 to 1, using one of the random numbers
+        static bool chance(std::uint32_t random, float probability)
+        {
+            return random < static_cast<std::uint64_t>(static_cast<double>(probability) * 4294967296.0);
+        }
+
+        static Counter generate(Counter counter, Key key)
+        {
+            for (unsigned i = 0; i < 10; ++i)
+            {
+                if (i > 0)
+                {
+                    key[0] += 0x9E3779B9;
+                    key[1] += 0xBB67AE85;
+                }
+                std::uint64_t product0 = static_cast<std::uint64_t>(0xD2511F53) * counter[0];
+                std::uint64_t product1 = static_cast<std::uint64_t>(0xCD9E8D57) * counter[2];
+                counter = {{static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                            static_cast<std::uint32_t>(product1),
+                            static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                            static_cast<std::uint32_t>(product0)}};
+            }
+            return counter;
+        }
+
+    private:
+        Key key;
+};
+
+#endif
@@ -0,0 +1,107 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include "trace.h"
+#include <fstream>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Everything is in here, so the file gets finished when the program exits
+    struct TraceState
+    {
+        ~TraceState()
+        {
+            if (file.is_open())
+                file << "\n]\n";
+        }
+
+        std::atomic<bool> enabled{false};
+        std::mutex mutex; // Protects everything below
+        std::ofstream file;
+        bool firstEvent = true;
+        Clock::time_point startTime;
+        std::atomic<unsigned> threadCount{0};
+    };
+
+    TraceState& getState()
+    {
+        static TraceState state;
+        return state;
+    }
+
+    // Gives each thread a small number, which the viewers show as separate rows
+    unsigned getThreadId()
+    {
+        static thread_local unsigned id = getState().threadCount++;
+        return id;
+    }
+}
+
+bool Trace::start(const std::string& filename)
+{
+    stop();
+    TraceState& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.file.open(filename, std::ios::out | std::ios::trunc);
+    if (!state.file.is_open())
+        return false;
+    state.file << "[";
+    state.firstEvent = true;
+    state.startTime = Clock::now();
+    state.enabled = true;
+    return true;
+}
+
+void Trace::stop()
+{
+    TraceState& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.enabled = false;
+    if (state.file.is_open())
+    {
+        state.file << "\n]\n";
+        state.file.close();
+    }
+}
+
+bool Trace::isEnabled()
+{
+    return getState().enabled;
+}
+
+Trace::Scope::Scope(const char* name):
+    name(name),
+    startTime(isEnabled() ? now() : -1)
+{
+}
+
+Trace::Scope::~Scope()
+{
+    if (startTime >= 0 && isEnabled())
+        write(name, startTime, now() - startTime);
+}
+
+std::int64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - getState().startTime).count();
+}
+
+void Trace::write(const char* name, std::int64_t startTime, std::int64_t duration)
+{
+    unsigned threadId = getThreadId();
+    TraceState& state = getState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.file.is_open())
+    {
+        // Complete events have the start time and duration together, so only one event is needed for each scope
+        state.file << (state.firstEvent ? "\n" : ",\n")
+                   << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"ts\":" << startTime
+                   << ",\"dur\":" << duration << ",\"pid\":1,\"tid\":" << threadId << "}";
+        state.firstEvent = false;
+    }
+}
@@ -0,0 +1,51 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <cstdint>
+
+/*
+This class writes timed scopes to a file in Chrome's trace event format,
+    which can be opened in chrome://tracing or the Perfetto UI to see where the time goes.
+Use the TRACE_SCOPE macro at the start of a function or block to time it.
+The macro is only compiled in when CELLS_TRACE is defined (see the CELLS_TRACE option in CMake),
+    otherwise it does nothing at all. When it is compiled in, scopes only check a flag until tracing is started.
+Events are streamed to the file as they finish, so long sessions don't use more memory over time.
+The closing bracket is written when tracing is stopped, but the viewers can still open a file without it.
+*/
+class Trace
+{
+    public:
+        static bool start(const std::string& filename); // Starts writing events to a file, returns false if it couldn't be opened
+        static void stop(); // Finishes the file
+        static bool isEnabled();
+
+        // Writes an event with the time between the constructor and the destructor
+        class Scope
+        {
+            public:
+                Scope(const char* name);
+                ~Scope();
+
+            private:
+                const char* name;
+                std::int64_t startTime; // In microseconds, negative when not tracing
+        };
+
+    private:
+        static std::int64_t now(); // Microseconds since tracing started
+        static void write(const char* name, std::int64_t startTime, std::int64_t duration);
+};
+
+#ifdef CELLS_TRACE
+    #define TRACE_CONCAT_IMPL(a, b) a##b
+    #define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+    #define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+    #define TRACE_SCOPE(name)
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/*
+This class passes the newest value from one thread to another without locking.
+There are three buffers: the writer fills the back buffer, and the reader uses the front buffer.
+Publishing swaps the back buffer with the middle one, and updating swaps the front buffer with the middle one,
+    so neither thread ever waits for the other, and the reader always gets the newest published value.
+Values that are published before the reader gets to them are skipped.
+Only one thread can write, and only one thread can read.
+*/
+template <class Type>
+class TripleBuffer
+{
+    public:
+        TripleBuffer():
+            front(0),
+            middle(1),
+            back(2)
+        {
+        }
+
+        // Writer: fill this buffer, then publish it
+        Type& getBack()
+        {
+            return buffers[back];
+        }
+
+        // Writer: makes the back buffer available to the reader, and gets a new back buffer
+        void publish()
+        {
+            back = middle.exchange(back | freshBit) & indexMask;
+        }
+
+        // Writer: returns true if the reader has picked up the last published buffer
+        bool wasRead() const
+        {
+            return !(middle.load() & freshBit);
+        }
+
+        // Reader: swaps in the newest published buffer, returns false if nothing new was published
+        bool update()
+        {
+            if (!(middle.load() & freshBit))
+                return false;
+            front = middle.exchange(front) & indexMask;
+            return true;
+        }
+
+        // Reader: the buffer from the last update
+        Type& getFront()
+        {
+            return buffers[front];
+        }
+
+    private:
+        static const unsigned indexMask = 3;
+        static const unsigned freshBit = 4; // Set when the middle buffer was published but not read yet
+
+        Type buffers[3];
+        unsigned front; // Only used by the reader
+        std::atomic<unsigned> middle; // Index of the middle buffer, and the fresh bit
+        unsigned back; // Only used by the writer
+};
+
+#endif
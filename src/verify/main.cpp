@@ -0,0 +1,563 @@
+// See the file COPYRIGHT.txt for authors and copyright information.
+// See the file LICENSE.txt for copying conditions.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include "automaton.h"
+#include "census.h"
+
+/*
+A differential checker for the simulation code, which compares the engines against each other.
+Random soups are run through every engine and topology (toroidal and bounded, full and partial),
+    and each generation is compared by hashing the cells against a simple reference implementation.
+Birth/survival rules are also checked against the same rules as a rule table ("@Life"),
+    a one-dimensional rule table is checked with its reflections ("@Spread"), block rules are run
+    forwards and then backwards to the start, and one-dimensional rules are checked row by row.
+Then a small corpus of known patterns is run, and the populations are checked at fixed generations.
+The census is checked with a few known objects, with the cells aging (more than one live state) and without.
+When something doesn't match, the first generation and cell that differ are printed.
+The return code is the number of failed checks, so it can be used in scripts.
+*/
+
+namespace
+{
+    struct Settings
+    {
+        unsigned soups = 4; // Number of random soups for each case
+        unsigned generations = 100;
+        unsigned seed = 0;
+        float density = 0.375f;
+        bool verbose = false;
+    };
+
+    // A pattern with its populations at some generations, on an infinite plane
+    // The boards are big enough that nothing reaches the edges by the last generation
+    struct Pattern
+    {
+        const char* name;
+        const char* rle;
+        unsigned width;
+        unsigned height;
+        unsigned x; // Position of the top left corner of the pattern
+        unsigned y;
+        std::vector<std::pair<unsigned, unsigned>> populations; // Generation, population
+    };
+
+    const std::vector<Pattern> corpus = {
+        {"Glider", "bo$2bo$3o!", 32, 32, 1, 1, {{4, 5}, {100, 5}}},
+        {"R-pentomino", "b2o$2o$bo!", 192, 192, 80, 90, {{50, 64}, {100, 121}, {200, 120}, {300, 168}}},
+        {"Diehard", "6bob$2o6b$bo3b3o!", 64, 64, 24, 20, {{50, 24}, {129, 2}, {130, 0}}},
+        {"Acorn", "bo5b$3bo3b$2o2b3o!", 128, 128, 80, 40, {{100, 76}, {200, 169}, {300, 178}}},
+        {"Gosper glider gun", "24bo11b$22bobo11b$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o14b$"
+            "2o8bo3bob2o4bobo11b$10bo5bo7bo11b$11bo3bo20b$12b2o22b!", 128, 128, 8, 8, {{30, 41}, {120, 56}, {300, 86}}},
+        {"Puffer train", "3bo$4bo$o3bo$b4o4$o$b2o$2bo$2bo$bo3$3bo$4bo$o3bo$b4o!", 192, 96, 24, 36, {{20, 64}, {100, 170}, {300, 483}}}
+    };
+
+    const std::vector<std::string> soupRules = {"B3/S23", "B36/S23", "B2/S", "B3678/S34678", "B3/S23:B0.9,S0.95,A0.5"};
+    const std::vector<std::string> blockRules = {"MS,D0;8;4;3;2;5;9;7;1;6;10;11;12;13;14;15", "MS,D15;14;13;3;11;5;6;1;7;9;10;2;12;4;8;0"};
+    const std::vector<std::string> lineRules = {"W30", "W90", "W110", "T20/R2", "T1234567/R4"};
+
+    unsigned failures = 0;
+
+    void printUsage(const char* name)
+    {
+        std::cout << "Usage: " << name << " [options]\n"
+                  << "Options:\n"
+                  << "  -n, --soups <n>                Number of random soups for each case (default is 4)\n"
+                  << "  -g, --generations <n>          Number of generations to run each soup for (default is 100)\n"
+                  << "  -d, --density <density>        Chance of each cell in the soups starting out live (default is 0.375)\n"
+                  << "      --seed <n>                 Seed of the first soup\n"
+                  << "  -v, --verbose                  Prints every check, instead of only the failed ones\n"
+                  << "  -h, --help                     Shows this message\n";
+    }
+
+    std::string describe(const std::string& rules, const Matrix<char>& cells, bool toroidal, bool partial, unsigned seed)
+    {
+        std::ostringstream out;
+        out << rules << ", " << cells.width() << "x" << cells.height() << ", "
+            << (toroidal ? "toroidal" : "bounded") << (partial ? ", partial" : "") << ", seed " << seed;
+        return out.str();
+    }
+
+    void report(const Settings& settings, const std::string& name, const std::string& error)
+    {
+        if (!error.empty())
+        {
+            ++failures;
+            std::cout << "FAIL " << name << ": " << error << "\n";
+        }
+        else if (settings.verbose)
+            std::cout << "OK   " << name << "\n";
+    }
+
+    // FNV-1a of which cells are live
+    std::uint64_t hashCells(const Matrix<char>& cells)
+    {
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (unsigned i = 0; i < cells.size(); ++i)
+            hash = (hash ^ static_cast<unsigned char>(cells.data()[i] != 0)) * 1099511628211ULL;
+        return hash;
+    }
+
+    // Compares the hashes, and only looks for the cell that differs when they don't match
+    std::string compare(const Matrix<char>& expected, const Matrix<char>& actual, std::uint64_t generation)
+    {
+        std::ostringstream error;
+        if (expected.width() != actual.width() || expected.height() != actual.height())
+            error << "the board size changed in generation " << generation;
+        else if (hashCells(expected) != hashCells(actual))
+        {
+            for (unsigned y = 0; y < expected.height() && error.tellp() == 0; ++y)
+                for (unsigned x = 0; x < expected.width() && error.tellp() == 0; ++x)
+                    if ((expected(x, y) != 0) != (actual(x, y) != 0))
+                        error << "generation " << generation << " differs first at cell (" << x << ", " << y
+                              << "), expected " << (expected(x, y) != 0) << " but got " << (actual(x, y) != 0);
+        }
+        return error.str();
+    }
+
+    unsigned countLiveCells(const Matrix<char>& cells)
+    {
+        unsigned count = 0;
+        for (unsigned i = 0; i < cells.size(); ++i)
+            count += (cells.data()[i] != 0);
+        return count;
+    }
+
+    // The straightforward way of running birth/survival rules, which every other engine is compared against
+    // This uses the same random numbers as the Automaton class, so stochastic rules can be compared too
+    void referenceStep(const Matrix<char>& in, Matrix<char>& out, const RuleSet& rules, const Philox& random,
+                       std::uint64_t generation, const sf::Rect<unsigned>& rect, bool toroidal)
+    {
+        out = in;
+        int left = rect.left;
+        int top = rect.top;
+        int right = rect.left + rect.width;
+        int bottom = rect.top + rect.height;
+        for (int y = top; y < bottom; ++y)
+        {
+            for (int x = left; x < right; ++x)
+            {
+                unsigned count = 0;
+                for (int dy = -1; dy <= 1; ++dy)
+                {
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        int nx = x + dx;
+                        int ny = y + dy;
+                        if (dx == 0 && dy == 0)
+                            continue;
+                        if (toroidal)
+                        {
+                            // Wraps around the edges of the simulated area
+                            nx = (nx < left ? right - 1 : (nx >= right ? left : nx));
+                            ny = (ny < top ? bottom - 1 : (ny >= bottom ? top : ny));
+                        }
+                        else if (nx < 0 || ny < 0 || nx >= static_cast<int>(in.width()) || ny >= static_cast<int>(in.height()))
+                            continue;
+                        count += (in(nx, ny) != 0);
+                    }
+                }
+                bool currentState = (in(x, y) != 0);
+                bool newState = rules.getRule(currentState, count);
+                if (rules.isStochastic())
+                {
+                    auto numbers = random(generation, x, y);
+                    if (!Philox::chance(numbers[0], rules.getUpdateChance()))
+                        newState = currentState;
+                    else if (newState && !Philox::chance(numbers[1], rules.getChance(currentState ? RuleSet::Survival : RuleSet::Birth)))
+                        newState = false;
+                }
+                out(x, y) = newState;
+            }
+        }
+    }
+
+    // Objects that the census should find, with their apgcodes
+    const std::vector<Pattern> censusObjects = {
+        {"Block", "2o$2o!", 2, 2, 4, 4, {}},
+        {"Blinker", "3o!", 3, 1, 20, 4, {}},
+        {"Glider", "bo$2bo$3o!", 3, 3, 4, 20, {}}
+    };
+    const std::vector<std::string> censusCodes = {"xp2_7", "xq4_153", "xs4_33"}; // Sorted
+
+    // Makes an automaton with random cells, returns false if the rules couldn't be loaded
+    bool setupSoup(Automaton& automaton, const std::string& rules, unsigned width, unsigned height, unsigned seed, float density)
+    {
+        automaton.setMaxState(1);
+        if (!automaton.setRules(rules))
+            return false;
+        automaton.resize(width, height, false);
+        automaton.setSeed(seed);
+        automaton.addRandom(density);
+        return true;
+    }
+
+    sf::Rect<unsigned> getRect(unsigned width, unsigned height, bool partial)
+    {
+        // Partial simulations leave an uneven margin, so the edges of the area don't line up with the board
+        if (partial)
+            return sf::Rect<unsigned>(3, 2, width - 7, height - 5);
+        return sf::Rect<unsigned>(0, 0, width, height);
+    }
+
+    // Runs the birth/survival engine and the reference together, and compares every generation
+    void checkSoup(const Settings& settings, const std::string& rules, unsigned width, unsigned height, bool toroidal, bool partial, unsigned seed)
+    {
+        Automaton automaton;
+        setupSoup(automaton, rules, width, height, seed, settings.density);
+        std::string name = describe(automaton.getRules(), automaton.getCells(), toroidal, partial, seed);
+        RuleSet reference;
+        reference.setFromString(rules);
+        Philox random(seed);
+        Matrix<char> expected[2];
+        expected[0] = automaton.getCells();
+        auto rect = getRect(width, height, partial);
+        std::string error;
+        for (unsigned g = 0; g < settings.generations && error.empty(); ++g)
+        {
+            referenceStep(expected[g % 2], expected[(g + 1) % 2], reference, random, automaton.getGeneration(), rect, toroidal);
+            automaton.simulate(rect, toroidal, partial);
+            error = compare(expected[(g + 1) % 2], automaton.getCells(), automaton.getGeneration());
+        }
+        report(settings, name, error);
+    }
+
+    // Runs the same soup as birth/survival rules and as a rule table, and compares every generation
+    void checkTable(const Settings& settings, const std::string& rules, const std::string& table, unsigned width, unsigned height, bool toroidal, bool partial, unsigned seed)
+    {
+        Automaton automaton;
+        Automaton tableAutomaton;
+        setupSoup(automaton, rules, width, height, seed, settings.density);
+        if (!setupSoup(tableAutomaton, table, width, height, seed, settings.density))
+        {
+            report(settings, table, "could not load the rule table");
+            return;
+        }
+        std::string name = describe(table + " against " + automaton.getRules(), automaton.getCells(), toroidal, partial, seed);
+        auto rect = getRect(width, height, partial);
+        std::string error = compare(automaton.getCells(), tableAutomaton.getCells(), 0);
+        for (unsigned g = 0; g < settings.generations && error.empty(); ++g)
+        {
+            automaton.simulate(rect, toroidal, partial);
+            tableAutomaton.simulate(rect, toroidal, partial);
+            error = compare(automaton.getCells(), tableAutomaton.getCells(), automaton.getGeneration());
+        }
+        report(settings, name, error);
+    }
+
+    // Runs a one-dimensional rule table that relies on "reflect" (see data/rules/Spread.rule), and checks each generation against a simple version
+    void checkReflectedTable(const Settings& settings, unsigned width, unsigned height, bool toroidal, unsigned seed)
+    {
+        Automaton automaton;
+        if (!setupSoup(automaton, "@Spread", width, height, seed, settings.density))
+        {
+            report(settings, "@Spread", "could not load the rule table");
+            return;
+        }
+        std::string name = describe(automaton.getRules() + " reflected", automaton.getCells(), toroidal, false, seed);
+        Matrix<char> expected;
+        std::string error;
+        for (unsigned g = 0; g < settings.generations && error.empty(); ++g)
+        {
+            // Each row is separate, and dead cells with a single live neighbor on either side are born
+            const Matrix<char>& cells = automaton.getCells();
+            expected = cells;
+            for (unsigned y = 0; y < height; ++y)
+            {
+                for (unsigned x = 0; x < width; ++x)
+                {
+                    bool west = (x > 0 ? cells(x - 1, y) != 0 : toroidal && cells(width - 1, y) != 0);
+                    bool east = (x + 1 < width ? cells(x + 1, y) != 0 : toroidal && cells(0, y) != 0);
+                    if (cells(x, y) == 0 && west != east)
+                        expected(x, y) = 1;
+                }
+            }
+            automaton.simulate(toroidal);
+            error = compare(expected, automaton.getCells(), automaton.getGeneration());
+        }
+        report(settings, name, error);
+    }
+
+    // Runs reversible block rules forwards, then backwards, and checks that each generation matches on the way back
+    void checkReversible(const Settings& settings, const std::string& rules, unsigned width, unsigned height, bool toroidal, unsigned seed)
+    {
+        Automaton automaton;
+        setupSoup(automaton, rules, width, height, seed, settings.density);
+        std::string name = describe(automaton.getRules() + " backwards", automaton.getCells(), toroidal, false, seed);
+        std::vector<Matrix<char>> history;
+        history.push_back(automaton.getCells());
+        for (unsigned g = 0; g < settings.generations; ++g)
+        {
+            automaton.simulate(toroidal);
+            history.push_back(automaton.getCells());
+        }
+        std::string error;
+        for (unsigned g = settings.generations; g > 0 && error.empty(); --g)
+        {
+            if (!automaton.stepBack(toroidal))
+                error = "the rules are not reversible";
+            else
+                error = compare(history[g - 1], automaton.getCells(), g - 1);
+        }
+        report(settings, name, error);
+    }
+
+    // Runs one-dimensional rules on a random top row, and checks each row against a simple version
+    void checkLine(const Settings& settings, const std::string& rules, unsigned width, unsigned height, bool toroidal, unsigned rowsPerStep, unsigned seed)
+    {
+        Automaton automaton;
+        automaton.setMaxState(1);
+        automaton.setRules(rules);
+        automaton.resize(width, height, false);
+        automaton.setRowsPerStep(rowsPerStep);
+        Philox random(seed, 1);
+        for (unsigned x = 0; x < width; ++x)
+            automaton.setCell(sf::Vector2u(x, 0), Philox::chance(random(0, x, 0)[0], settings.density));
+        std::ostringstream nameStream;
+        nameStream << describe(automaton.getRules(), automaton.getCells(), toroidal, false, seed) << ", " << rowsPerStep << " rows per step";
+
+        // Read the rule number and radius back from the rule string
+        const std::string& ruleString = automaton.getRules();
+        bool totalistic = (ruleString[0] == 'T');
+        std::uint64_t code = std::strtoull(ruleString.c_str() + 1, nullptr, 10);
+        std::size_t radiusPos = ruleString.find('R');
+        int radius = (radiusPos != std::string::npos ? std::atoi(ruleString.c_str() + radiusPos + 1) : 1);
+
+        // Every generation of the reference is kept, since the board shows the newest ones
+        std::vector<std::vector<char>> rows(1, std::vector<char>(width));
+        for (unsigned x = 0; x < width; ++x)
+            rows[0][x] = automaton(x, 0);
+        Matrix<char> expected;
+        expected.resize(width, height);
+        std::string error;
+        for (unsigned step = 0; step < settings.generations && error.empty(); ++step)
+        {
+            automaton.simulate(toroidal);
+            while (rows.size() <= automaton.getGeneration())
+            {
+                const std::vector<char>& current = rows.back();
+                std::vector<char> next(width);
+                for (int x = 0; x < static_cast<int>(width); ++x)
+                {
+                    unsigned sum = 0;
+                    unsigned pattern = 0;
+                    for (int dx = -radius; dx <= radius; ++dx)
+                    {
+                        int nx = x + dx;
+                        if (toroidal)
+                            nx = ((nx % static_cast<int>(width)) + width) % width;
+                        bool live = (nx >= 0 && nx < static_cast<int>(width) && current[nx]);
+                        sum += live;
+                        pattern = (pattern << 1) | live;
+                    }
+                    next[x] = (code >> (totalistic ? sum : pattern)) & 1;
+                }
+                rows.push_back(next);
+            }
+
+            // The top row has the first generation, until the board is full and scrolls up
+            std::uint64_t generation = automaton.getGeneration();
+            std::uint64_t first = (generation >= height ? generation - height + 1 : 0);
+            for (unsigned y = 0; y < height; ++y)
+                for (unsigned x = 0; x < width; ++x)
+                    expected(x, y) = (first + y <= generation ? rows[first + y][x] : 0);
+            error = compare(expected, automaton.getCells(), generation);
+        }
+        report(settings, nameStream.str(), error);
+    }
+
+    // Places a pattern in RLE format on an empty board
+    void placePattern(Automaton& automaton, const Pattern& pattern)
+    {
+        unsigned x = pattern.x;
+        unsigned y = pattern.y;
+        unsigned count = 0;
+        for (const char* c = pattern.rle; *c && *c != '!'; ++c)
+        {
+            if (*c >= '0' && *c <= '9')
+            {
+                count = count * 10 + (*c - '0');
+                continue;
+            }
+            unsigned length = std::max(count, 1u);
+            if (*c == 'o')
+                for (unsigned i = 0; i < length; ++i)
+                    automaton.setCell(sf::Vector2u(x + i, y), 1);
+            if (*c == '$')
+            {
+                x = pattern.x;
+                y += length;
+            }
+            else
+                x += length;
+            count = 0;
+        }
+    }
+
+    // Runs a known pattern, and checks the populations along the way
+    void checkPattern(const Settings& settings, const Pattern& pattern, const std::string& rules, bool toroidal, bool partial)
+    {
+        Automaton automaton;
+        automaton.setMaxState(1);
+        if (!automaton.setRules(rules))
+        {
+            report(settings, rules, "could not load the rules");
+            return;
+        }
+        automaton.resize(pattern.width, pattern.height, false);
+        placePattern(automaton, pattern);
+        std::ostringstream name;
+        name << pattern.name << ", " << describe(automaton.getRules(), automaton.getCells(), toroidal, partial, 0);
+        auto rect = getRect(pattern.width, pattern.height, false);
+        std::ostringstream error;
+        for (const auto& check: pattern.populations)
+        {
+            while (automaton.getGeneration() < check.first)
+                automaton.simulate(rect, toroidal, partial);
+            unsigned population = countLiveCells(automaton.getCells());
+            if (population != check.second)
+            {
+                error << "population in generation " << check.first << " is " << population << ", expected " << check.second;
+                break;
+            }
+        }
+        report(settings, name.str(), error.str());
+    }
+
+    // Runs a census of some known objects, after running them long enough for the cells to have different ages
+    void checkCensus(const Settings& settings, unsigned maxState)
+    {
+        Automaton automaton;
+        automaton.setMaxState(maxState);
+        automaton.setRules("B3/S23");
+        automaton.resize(48, 48, false);
+        for (const auto& object: censusObjects)
+            placePattern(automaton, object);
+        for (unsigned g = 0; g < 12; ++g)
+            automaton.simulate(true);
+        std::ostringstream name;
+        name << "Census, " << automaton.getRules() << ", max state " << maxState;
+        std::vector<Census::Entry> entries;
+        std::ostringstream error;
+        if (!Census::take(automaton, true, Census::defaultMaxPeriod, entries))
+            error << "the rules are not supported";
+        else
+        {
+            std::vector<std::string> codes;
+            for (const auto& entry: entries)
+                for (std::uint64_t i = 0; i < entry.count; ++i)
+                    codes.push_back(entry.code);
+            std::sort(codes.begin(), codes.end());
+            if (codes != censusCodes)
+            {
+                error << "found";
+                for (const auto& code: codes)
+                    error << " " << code;
+            }
+        }
+        report(settings, name.str(), error.str());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Settings settings;
+
+    // Read the arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if ((arg == "-n" || arg == "--soups") && hasValue)
+            settings.soups = std::strtoul(argv[++i], nullptr, 10);
+        else if ((arg == "-g" || arg == "--generations") && hasValue)
+            settings.generations = std::strtoul(argv[++i], nullptr, 10);
+        else if ((arg == "-d" || arg == "--density") && hasValue)
+            settings.density = std::atof(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            settings.seed = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "-v" || arg == "--verbose")
+            settings.verbose = true;
+        else if (arg == "-h" || arg == "--help")
+        {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Odd sizes make sure the edges don't line up with anything
+    const std::vector<sf::Vector2u> sizes = {{64, 64}, {37, 23}};
+    unsigned checks = 0;
+    for (unsigned seed = settings.seed; seed < settings.seed + settings.soups; ++seed)
+    {
+        for (const auto& size: sizes)
+        {
+            for (bool toroidal: {true, false})
+            {
+                for (bool partial: {false, true})
+                {
+                    for (const auto& rules: soupRules)
+                    {
+                        checkSoup(settings, rules, size.x, size.y, toroidal, partial, seed);
+                        ++checks;
+                    }
+                    checkTable(settings, "B3/S23", "@Life", size.x, size.y, toroidal, partial, seed);
+                    ++checks;
+                }
+                checkReflectedTable(settings, size.x, size.y, toroidal, seed);
+                ++checks;
+                for (const auto& rules: lineRules)
+                {
+                    for (unsigned rowsPerStep: {1u, 7u})
+                    {
+                        checkLine(settings, rules, size.x * 2 + 1, size.y, toroidal, rowsPerStep, seed);
+                        ++checks;
+                    }
+                }
+            }
+        }
+        for (const auto& rules: blockRules)
+        {
+            for (bool toroidal: {true, false})
+            {
+                checkReversible(settings, rules, 64, 48, toroidal, seed);
+                ++checks;
+            }
+        }
+    }
+    for (const auto& pattern: corpus)
+    {
+        for (const char* rules: {"B3/S23", "@Life"})
+        {
+            for (bool toroidal: {true, false})
+            {
+                for (bool partial: {false, true})
+                {
+                    checkPattern(settings, pattern, rules, toroidal, partial);
+                    ++checks;
+                }
+            }
+        }
+    }
+
+    for (unsigned maxState: {1u, 9u})
+    {
+        checkCensus(settings, maxState);
+        ++checks;
+    }
+
+    std::cout << (checks - failures) << " of " << checks << " checks passed.\n";
+    return static_cast<int>(std::min(failures, 255u));
+}